@@ -5,6 +5,7 @@
 #include "maths.hpp"
 #include "image.hpp"
 #include "mesh.hpp"
+#include "meshcache.hpp"
 #include "buffer.hpp"
 #include "darray.hpp"
 #include "rasterizer.hpp"
@@ -17,5 +18,11 @@
 #include "material.hpp"
 #include "entity.hpp"
 #include "envmap.hpp"
+#include "present.hpp"
+#include "bvh.hpp"
+#include "occlusion.hpp"
+#include "lod.hpp"
+#include "streaming.hpp"
+#include "arena.hpp"
 
 #endif
\ No newline at end of file
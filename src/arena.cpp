@@ -0,0 +1,163 @@
+#include <atomic>
+#include "arena.hpp"
+
+using namespace Lurdr;
+
+// arena frames begun, a binding or thread arena of an earlier frame is stale
+static std::atomic<UINT64>              s_arena_frame(0);
+// arena bound to the running thread and the frame it was bound in
+static thread_local FrameArena          *t_arena = nullptr;
+static thread_local UINT64              t_arena_frame = 0;
+// arena of a thread not bound in this frame
+static thread_local FrameArena          t_fallback_arena;
+static thread_local UINT64              t_fallback_frame = 0;
+
+struct Lurdr::ArenaBlock
+{
+    ArenaBlock  *next;
+    size_t      size;
+    byte_t      *data;      // ARENA_ALIGNMENT aligned, right after the header
+};
+
+static ArenaBlock * allocateBlock(size_t size)
+{
+    byte_t *memory = new byte_t[sizeof(ArenaBlock) + size + ARENA_ALIGNMENT];
+    ArenaBlock *block = (ArenaBlock*)memory;
+    block->next = nullptr;
+    block->size = size;
+    block->data = (byte_t*)(((size_t)(memory + sizeof(ArenaBlock)) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1));
+    return block;
+}
+
+static void freeBlocks(ArenaBlock * block)
+{
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        delete[] (byte_t*)block;
+        block = next;
+    }
+}
+
+// offset into block of the first address past offset aligned to alignment,
+// or SIZE_MAX if size bytes do not fit there
+static inline size_t fitBlock(const ArenaBlock * block, size_t offset, size_t size, size_t alignment)
+{
+    const size_t address = (size_t)block->data + offset;
+    const size_t start = ((address + alignment - 1) & ~(alignment - 1)) - (size_t)block->data;
+    return start + size <= block->size ? start : SIZE_MAX;
+}
+
+FrameArena::FrameArena():
+    m_first(nullptr),
+    m_current(nullptr),
+    m_offset(0)
+{
+    m_statistics.used = 0;
+    m_statistics.peak = 0;
+    m_statistics.capacity = 0;
+    m_statistics.block_allocations = 0;
+}
+
+FrameArena::~FrameArena()
+{
+    freeBlocks(m_first);
+}
+
+void * FrameArena::allocate(size_t size, size_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    const size_t start = m_current ? fitBlock(m_current, m_offset, size, alignment) : SIZE_MAX;
+    if (start == SIZE_MAX)
+    {
+        return allocateSlow(size, alignment);
+    }
+    m_statistics.used += start + size - m_offset;
+    m_statistics.peak = max(m_statistics.peak, m_statistics.used);
+    m_offset = start + size;
+    return m_current->data + start;
+}
+
+void * FrameArena::allocateSlow(size_t size, size_t alignment)
+{
+    // blocks past the current one are left from before a rewind, the
+    // unused end of the current block is not counted
+    ArenaBlock *last = m_current;
+    for (ArenaBlock *block = m_current ? m_current->next : m_first; block; block = block->next)
+    {
+        last = block;
+        if (fitBlock(block, 0, size, alignment) != SIZE_MAX)
+        {
+            m_current = block;
+            m_offset = 0;
+            return allocate(size, alignment);
+        }
+    }
+
+    const size_t block_size = max(max((size_t)ARENA_BLOCK_SIZE, m_statistics.capacity), size + alignment);
+    ArenaBlock *block = allocateBlock(block_size);
+    if (last) last->next = block;
+    else      m_first = block;
+    m_statistics.capacity += block_size;
+    m_statistics.block_allocations++;
+
+    m_current = block;
+    m_offset = 0;
+    return allocate(size, alignment);
+}
+
+FrameArenaMarker FrameArena::mark() const
+{
+    FrameArenaMarker marker = { m_current, m_offset, m_statistics.used };
+    return marker;
+}
+
+void FrameArena::rewind(const FrameArenaMarker & marker)
+{
+    assert(marker.used <= m_statistics.used);
+    m_current = marker.block;
+    m_offset = marker.offset;
+    m_statistics.used = marker.used;
+}
+
+void FrameArena::reset()
+{
+    m_statistics.used = 0;
+    m_statistics.block_allocations = 0;
+    if (m_first && m_first->next)
+    {
+        // one block large enough for the largest frame so far
+        freeBlocks(m_first);
+        m_first = allocateBlock(m_statistics.capacity);
+        m_statistics.block_allocations = 1;
+    }
+    m_current = m_first;
+    m_offset = 0;
+}
+
+FrameArena & Lurdr::getThreadArena()
+{
+    const UINT64 frame = s_arena_frame;
+    if (t_arena != nullptr && t_arena_frame == frame)
+    {
+        return *t_arena;
+    }
+    // the bound arenas of this frame belong to other threads
+    if (t_fallback_frame != frame)
+    {
+        t_fallback_arena.reset();
+        t_fallback_frame = frame;
+    }
+    return t_fallback_arena;
+}
+
+void Lurdr::bindThreadArena(FrameArena * arena)
+{
+    t_arena = arena;
+    t_arena_frame = s_arena_frame;
+}
+
+void Lurdr::beginArenaFrame()
+{
+    s_arena_frame++;
+}
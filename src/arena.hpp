@@ -0,0 +1,112 @@
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "global.hpp"
+
+namespace Lurdr
+{
+
+// bytes of the first block of an arena, later blocks double the capacity
+#define ARENA_BLOCK_SIZE (1 << 20)
+// alignment of allocate() without one, covers every type of the pipeline
+#define ARENA_ALIGNMENT 32
+
+struct ArenaBlock;
+
+/**
+ * counters of a frame arena, used and block_allocations restart at every
+ * reset(), peak and capacity are kept over the life of the arena
+ */
+struct FrameArenaStatistics
+{
+    size_t  used;               // bytes handed out since the last reset, padding included
+    size_t  peak;               // most bytes in use at once
+    size_t  capacity;           // bytes of the blocks held
+    long    block_allocations;  // blocks taken from the heap since the last reset
+};
+
+// position of an arena to rewind to, everything allocated after it is released at once
+struct FrameArenaMarker
+{
+    ArenaBlock  *block;
+    size_t      offset;
+    size_t      used;
+};
+
+/**
+ * Linear allocator for data that lives no longer than a frame. Allocation
+ * bumps an offset in the current block, nothing is freed one by one, reset()
+ * releases everything at once. A block that runs out chains a new one twice
+ * the capacity, the next reset() merges all blocks into a single one, so
+ * once the arena has seen the largest frame no frame touches the heap.
+ * Destructors are never run, only trivially destructible data belongs here.
+ * An arena is used by one thread at a time.
+ */
+class FrameArena
+{
+private:
+    ArenaBlock  *m_first;
+    ArenaBlock  *m_current;
+    size_t      m_offset;       // into m_current
+    FrameArenaStatistics m_statistics;
+
+    void * allocateSlow(size_t size, size_t alignment);
+
+public:
+    FrameArena();
+    ~FrameArena();
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena& operator= (const FrameArena &) = delete;
+
+    void * allocate(size_t size, size_t alignment = ARENA_ALIGNMENT);
+
+    // count default constructed elements
+    template<typename T>
+    T * create(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena data is never destroyed");
+        T *array = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; i++)
+        {
+            new (array + i) T();
+        }
+        return array;
+    }
+    // one element constructed from args
+    template<typename T, typename... Args>
+    T * make(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena data is never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    FrameArenaMarker mark() const;
+    void rewind(const FrameArenaMarker & marker);
+    // release everything allocated, merge the blocks if the last frame needed more than one
+    void reset();
+
+    const FrameArenaStatistics & getStatistics() const { return m_statistics; }
+};
+
+/**
+ * Arena of the running thread for transient data such as shader out
+ * buffers. A thread bound in the current arena frame gets the arena it was
+ * bound to, any other thread gets an arena of its own, reset on its first
+ * use in a frame. beginArenaFrame() makes every binding stale, the owner of
+ * the bound arenas calls it right before resetting them.
+ */
+FrameArena & getThreadArena();
+void bindThreadArena(FrameArena * arena);
+void beginArenaFrame();
+
+}
+
+#endif
@@ -1,24 +1,53 @@
+#include "simd.hpp"
 #include "buffer.hpp"
 
 using namespace Lurdr;
 
+// returns the first FRAME_BUFFER_ALIGNMENT aligned address inside storage
+static byte_t* alignBuffer(byte_t *storage)
+{
+    return (byte_t*)(((size_t)storage + FRAME_BUFFER_ALIGNMENT - 1) & ~(size_t)(FRAME_BUFFER_ALIGNMENT - 1));
+}
+
 FrameBuffer::FrameBuffer(): m_width(0), m_height(0), m_size(0)
 {
+    m_color_format = COLOR_FORMAT_RGB8;
+    m_pixel_size = 3;
     m_color_buffer = nullptr;
     m_depth_buffer = nullptr;
+    m_color_storage = nullptr;
+    m_depth_storage = nullptr;
+    m_depth_tile_count_x = 0;
+    m_depth_tile_count_y = 0;
+    m_depth_tile_min = nullptr;
+    m_depth_tile_max = nullptr;
+    m_gbuffer = nullptr;
 }
-FrameBuffer::FrameBuffer(long width, long height): m_width(width), m_height(height)
+FrameBuffer::FrameBuffer(long width, long height, COLOR_FORMAT color_format):
+    m_width(width), m_height(height), m_color_format(color_format)
 {
     m_size = m_width * m_height;
+    m_pixel_size = m_color_format == COLOR_FORMAT_RGB8 ? 3 : 4;
     long buffer_size = m_width * m_height;
-    m_color_buffer = new byte_t[buffer_size * 3];
-    m_depth_buffer = new float[buffer_size];
+    m_color_storage = new byte_t[buffer_size * m_pixel_size + FRAME_BUFFER_ALIGNMENT];
+    m_depth_storage = new byte_t[buffer_size * sizeof(float) + FRAME_BUFFER_ALIGNMENT];
+    m_color_buffer = alignBuffer(m_color_storage);
+    m_depth_buffer = (float*)alignBuffer(m_depth_storage);
+
+    m_depth_tile_count_x = (m_width + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+    m_depth_tile_count_y = (m_height + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+    m_depth_tile_min = new float[m_depth_tile_count_x * m_depth_tile_count_y];
+    m_depth_tile_max = new float[m_depth_tile_count_x * m_depth_tile_count_y];
+    m_gbuffer = nullptr;
 }
 
 FrameBuffer::~FrameBuffer()
 {
-    delete[] m_color_buffer;
-    delete[] m_depth_buffer;
+    delete[] m_color_storage;
+    delete[] m_depth_storage;
+    delete[] m_depth_tile_min;
+    delete[] m_depth_tile_max;
+    delete m_gbuffer;
 }
 
 long FrameBuffer::getHeight() const
@@ -48,35 +77,142 @@ float* FrameBuffer::depthBuffer() const
 
 void FrameBuffer::clearColorBuffer(const rgb & color) const
 {
-    size_t temp_buffer_size = 3 * sizeof(byte_t);
-    byte_t temp_buffer[3] = { 
-        (byte_t)FTOD(color.r * 255), 
+    fillColorBuffer(
+        (byte_t)FTOD(color.r * 255),
         (byte_t)FTOD(color.g * 255),
-        (byte_t)FTOD(color.b * 255) };
-    byte_t *color_buffer_ptr = m_color_buffer;
-    for (long i = 0; i < m_size; i++)
+        (byte_t)FTOD(color.b * 255) );
+}
+
+GBuffer* FrameBuffer::getGBuffer() const
+{
+    if (m_gbuffer == nullptr)
     {
-        memcpy(color_buffer_ptr, temp_buffer, temp_buffer_size);
-        color_buffer_ptr += 3;
+        m_gbuffer = new GBuffer(m_width, m_height);
     }
+    return m_gbuffer;
 }
 
 void FrameBuffer::clearColorBuffer(const RGBCOLOR & color) const
 {
-    size_t temp_buffer_size = 3 * sizeof(byte_t);
-    byte_t temp_buffer[3] = { color.R, color.G, color.B };
-    byte_t *color_buffer_ptr = m_color_buffer;
-    for (long i = 0; i < m_size; i++)
+    fillColorBuffer(color.R, color.G, color.B);
+}
+
+void FrameBuffer::fillColorBuffer(byte_t r, byte_t g, byte_t b) const
+{
+    if (m_size == 0)
+    {
+        return;
+    }
+    if (m_color_format != COLOR_FORMAT_RGB8)
+    {
+        simdFill32(m_color_buffer, packColor(r, g, b), m_size);
+        return;
+    }
+    // 3 byte pixels do not fit a vector register, fill the first one and keep
+    // doubling the filled range with memcpy, which does the wide stores for us
+    m_color_buffer[0] = r;
+    m_color_buffer[1] = g;
+    m_color_buffer[2] = b;
+    const size_t total = m_size * 3;
+    size_t filled = 3;
+    while (filled < total)
+    {
+        size_t count = min(filled, total - filled);
+        memcpy(m_color_buffer + filled, m_color_buffer, count);
+        filled += count;
+    }
+}
+
+void FrameBuffer::exportColorBufferRGB(byte_t * dst, bool bottom_up) const
+{
+    for (long row = 0; row < m_height; row++)
     {
-        memcpy(color_buffer_ptr, temp_buffer, temp_buffer_size);
-        color_buffer_ptr += 3;
+        const long src_row = bottom_up ? m_height - 1 - row : row;
+        byte_t *dst_row = dst + row * m_width * 3;
+        if (m_color_format == COLOR_FORMAT_RGB8)
+        {
+            memcpy(dst_row, m_color_buffer + src_row * m_width * 3, m_width * 3);
+            continue;
+        }
+        const byte_t *src_pixel = m_color_buffer + src_row * m_width * 4;
+        const long r = m_color_format == COLOR_FORMAT_BGRA8 ? 2 : 0;
+        for (long x = 0; x < m_width; x++)
+        {
+            dst_row[0] = src_pixel[r];
+            dst_row[1] = src_pixel[1];
+            dst_row[2] = src_pixel[2 - r];
+            dst_row += 3;
+            src_pixel += 4;
+        }
     }
 }
 
 void FrameBuffer::clearDepthBuffer(const float & depth) const
+{
+    UINT32 depth_bits;
+    memcpy(&depth_bits, &depth, sizeof(UINT32));
+    simdFill32(m_depth_buffer, depth_bits, m_size);
+    simdFill32(m_depth_tile_min, depth_bits, m_depth_tile_count_x * m_depth_tile_count_y);
+    simdFill32(m_depth_tile_max, depth_bits, m_depth_tile_count_x * m_depth_tile_count_y);
+}
+
+/**
+ * recompute the min/max depth of one tile from the depth buffer,
+ * call after writing depth values inside the tile
+ */
+void FrameBuffer::updateDepthTile(long tile_x, long tile_y) const
+{
+    const long x_start = tile_x * DEPTH_TILE_SIZE;
+    const long y_start = tile_y * DEPTH_TILE_SIZE;
+    const long x_end = min(x_start + DEPTH_TILE_SIZE, m_width);
+    const long y_end = min(y_start + DEPTH_TILE_SIZE, m_height);
+
+    float tile_min = m_depth_buffer[m_size - m_width * (y_start + 1) + x_start];
+    float tile_max = tile_min;
+    for (long y = y_start; y < y_end; y++)
+    {
+        const float *depth_row = m_depth_buffer + m_size - m_width * (y + 1);
+        for (long x = x_start; x < x_end; x++)
+        {
+            tile_min = min(tile_min, depth_row[x]);
+            tile_max = max(tile_max, depth_row[x]);
+        }
+    }
+
+    m_depth_tile_min[tile_y * m_depth_tile_count_x + tile_x] = tile_min;
+    m_depth_tile_max[tile_y * m_depth_tile_count_x + tile_x] = tile_max;
+}
+
+GBuffer::GBuffer(long width, long height): m_width(width), m_height(height)
+{
+    m_size = m_width * m_height;
+    m_frag_pos = new float[m_size * 3];
+    m_normal = new float[m_size * 3];
+    m_t_normal = new float[m_size * 3];
+    m_texcoord = new float[m_size * 2];
+    m_entity = new const Entity*[m_size];
+    clear();
+}
+
+GBuffer::~GBuffer()
+{
+    delete[] m_frag_pos;
+    delete[] m_normal;
+    delete[] m_t_normal;
+    delete[] m_texcoord;
+    delete[] m_entity;
+}
+
+size_t GBuffer::getMemoryFootprint() const
+{
+    return m_size * (11 * sizeof(float) + sizeof(const Entity*));
+}
+
+// only the entity plane needs clearing, attributes of uncovered pixels are never read
+void GBuffer::clear() const
 {
     for (long i = 0; i < m_size; i++)
     {
-        m_depth_buffer[i] = depth;
+        m_entity[i] = nullptr;
     }
 }
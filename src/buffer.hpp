@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 #include "maths.hpp"
 #include "global.hpp"
 #include "darray.hpp"
@@ -11,6 +12,19 @@
 namespace Lurdr
 {
 
+// side length in pixels of a tile of the coarse (hierarchical) depth buffer
+#define DEPTH_TILE_SIZE 8
+
+// pixel layout of the color buffer. RGB8 is the 24-bit layout the platform windows
+// and the BMP writer consume, the packed 32-bit formats write a pixel with one store
+typedef enum {COLOR_FORMAT_RGB8, COLOR_FORMAT_RGBA8, COLOR_FORMAT_BGRA8} COLOR_FORMAT;
+
+// alignment in bytes of the color and depth buffers, wide enough for AVX2 stores
+#define FRAME_BUFFER_ALIGNMENT 32
+
+class Entity;
+class GBuffer;
+
 // a discussion over size_t & long
 // http://cplusplus.com/forum/beginner/87153/
 class FrameBuffer
@@ -19,22 +33,122 @@ private:
     long   m_width;
     long   m_height;
     long   m_size;
+    COLOR_FORMAT m_color_format;
+    long   m_pixel_size;     // bytes per pixel of the color buffer
     byte_t *m_color_buffer;
     float  *m_depth_buffer;
+    byte_t *m_color_storage; // unaligned allocations behind the two buffers above
+    byte_t *m_depth_storage;
+    // min/max depth of every DEPTH_TILE_SIZE x DEPTH_TILE_SIZE tile, tiles are indexed
+    // in screen coordinates (y up) like the pipeline, not in depth buffer memory order
+    long   m_depth_tile_count_x;
+    long   m_depth_tile_count_y;
+    float  *m_depth_tile_min;
+    float  *m_depth_tile_max;
+    // allocated on first use by deferred shading
+    mutable GBuffer *m_gbuffer;
 public:
     FrameBuffer();
-    FrameBuffer(long width, long height);
+    FrameBuffer(long width, long height, COLOR_FORMAT color_format = COLOR_FORMAT_RGB8);
     ~FrameBuffer();
 
+    FrameBuffer(const FrameBuffer &) = delete;
+    FrameBuffer& operator= (const FrameBuffer &) = delete;
+
     long getHeight() const;
     long getWidth() const;
     long getSize() const;
+    COLOR_FORMAT getColorFormat() const { return m_color_format; }
+    long getPixelSize() const { return m_pixel_size; }
     byte_t* colorBuffer() const;
     float* depthBuffer() const;
 
+    // index of pixel (x, y) in the color and depth buffers, y goes up
+    long getPixelPos(long x, long y) const { return m_size - m_width * (y + 1) + x; }
+
+    UINT32 packColor(byte_t r, byte_t g, byte_t b) const
+    {
+        const byte_t pixel[4] = {
+            m_color_format == COLOR_FORMAT_BGRA8 ? b : r, g,
+            m_color_format == COLOR_FORMAT_BGRA8 ? r : b, 255 };
+        UINT32 packed;
+        memcpy(&packed, pixel, sizeof(UINT32));
+        return packed;
+    }
+
+    // every color write of the pipeline and the rasterizer goes through here
+    void setPixel(long pos, byte_t r, byte_t g, byte_t b) const
+    {
+        if (m_color_format == COLOR_FORMAT_RGB8)
+        {
+            byte_t *pixel = m_color_buffer + pos * 3;
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
+        }
+        else
+        {
+            ((UINT32*)m_color_buffer)[pos] = packColor(r, g, b);
+        }
+    }
+
+    /**
+     * copy the color buffer into dst as tightly packed 24-bit RGB, rows go top to
+     * bottom like colorBuffer(), or bottom to top like BMPImage if bottom_up is set
+     */
+    void exportColorBufferRGB(byte_t * dst, bool bottom_up = false) const;
+
+    long getDepthTileCountX() const { return m_depth_tile_count_x; }
+    long getDepthTileCountY() const { return m_depth_tile_count_y; }
+    float* depthTileMin() const { return m_depth_tile_min; }
+    float* depthTileMax() const { return m_depth_tile_max; }
+    void updateDepthTile(long tile_x, long tile_y) const;
+
+    GBuffer* getGBuffer() const;
+
     void clearColorBuffer(const RGBCOLOR & color) const;
     void clearColorBuffer(const rgb & color) const;
     void clearDepthBuffer(const float & depth) const;
+private:
+    void fillColorBuffer(byte_t r, byte_t g, byte_t b) const;
+};
+
+/**
+ * G-buffer of the deferred shading mode, stores the interpolated attributes
+ * of the visible fragment of every pixel in the memory order of FrameBuffer,
+ * depth stays in the depth buffer of FrameBuffer.
+ * Attributes are kept at full float precision so deferred shading gives the
+ * same result as forward shading.
+ */
+class GBuffer
+{
+private:
+    long   m_width;
+    long   m_height;
+    long   m_size;
+    float  *m_frag_pos;     // xyz per pixel
+    float  *m_normal;       // xyz per pixel
+    float  *m_t_normal;     // xyz per pixel
+    float  *m_texcoord;     // uv per pixel
+    const Entity **m_entity; // entity id of the fragment, nullptr if not covered
+public:
+    GBuffer(long width, long height);
+    ~GBuffer();
+
+    GBuffer(const GBuffer &) = delete;
+    GBuffer& operator= (const GBuffer &) = delete;
+
+    long getWidth() const { return m_width; }
+    long getHeight() const { return m_height; }
+    float* fragPosBuffer() const { return m_frag_pos; }
+    float* normalBuffer() const { return m_normal; }
+    float* triangleNormalBuffer() const { return m_t_normal; }
+    float* texcoordBuffer() const { return m_texcoord; }
+    const Entity** entityBuffer() const { return m_entity; }
+
+    // bytes held by the G-buffer planes
+    size_t getMemoryFootprint() const;
+    void clear() const;
 };
 
 class ArrayBuffer
@@ -65,12 +179,14 @@ public:
         const size_t & batch_step, 
         const size_t & offset )
     {
-        m_data_pointers[index] = DynamicArray<float*>();
-        m_batch_sizes[index] = batch_size;
         if (index >= m_data_count)
         {
             m_data_count = index + 1;
+            m_data_pointers.resize(m_data_count);
+            m_batch_sizes.resize(m_data_count);
         }
+        m_data_pointers[index].clear();
+        m_batch_sizes[index] = batch_size;
         size_t pos = offset;
         while (pos < m_buffer_size)
         {
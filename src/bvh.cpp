@@ -0,0 +1,582 @@
+#include "bvh.hpp"
+
+using namespace Lurdr;
+
+/**
+ * build
+ */
+
+// primitive bounds are 6 floats, min xyz then max xyz
+struct BVHBuildContext
+{
+    const float *bounds;
+    UINT32      *indices;
+    BVHNode     *nodes;
+    size_t      node_count;
+    size_t      max_leaf_size;
+};
+
+struct BVHBin
+{
+    float   min[3];
+    float   max[3];
+    size_t  count;
+};
+
+static inline void resetBounds(float * min_bound, float * max_bound)
+{
+    for (int a = 0; a < 3; a++)
+    {
+        min_bound[a] =  FLT_MAX;
+        max_bound[a] = -FLT_MAX;
+    }
+}
+
+static inline void growBounds(float * min_bound, float * max_bound, const float * other_min, const float * other_max)
+{
+    for (int a = 0; a < 3; a++)
+    {
+        min_bound[a] = min(min_bound[a], other_min[a]);
+        max_bound[a] = max(max_bound[a], other_max[a]);
+    }
+}
+
+static inline float halfSurfaceArea(const float * min_bound, const float * max_bound)
+{
+    const float dx = max_bound[0] - min_bound[0];
+    const float dy = max_bound[1] - min_bound[1];
+    const float dz = max_bound[2] - min_bound[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static inline float centroid(const float * bounds, int axis)
+{
+    return 0.5f * (bounds[axis] + bounds[axis + 3]);
+}
+
+static void subdivide(BVHBuildContext & ctx, size_t node_index, UINT32 first, UINT32 count, size_t depth)
+{
+    BVHNode & node = ctx.nodes[node_index];
+    float centroid_min[3], centroid_max[3];
+    resetBounds(node.min, node.max);
+    resetBounds(centroid_min, centroid_max);
+    for (UINT32 i = first; i < first + count; i++)
+    {
+        const float *bounds = ctx.bounds + ctx.indices[i] * 6;
+        growBounds(node.min, node.max, bounds, bounds + 3);
+        for (int a = 0; a < 3; a++)
+        {
+            centroid_min[a] = min(centroid_min[a], centroid(bounds, a));
+            centroid_max[a] = max(centroid_max[a], centroid(bounds, a));
+        }
+    }
+    node.offset = first;
+    node.count = count;
+
+    if (count == 1 || depth + 1 >= BVH_MAX_DEPTH)
+    {
+        return;
+    }
+
+    // binned SAH, reference : Wald, On fast Construction of SAH-based Bounding Volume Hierarchies
+    int best_axis = -1;
+    int best_split = 0;
+    float best_cost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float extent = centroid_max[axis] - centroid_min[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+        const float scale = BVH_BIN_COUNT / extent;
+
+        BVHBin bins[BVH_BIN_COUNT];
+        for (int b = 0; b < BVH_BIN_COUNT; b++)
+        {
+            resetBounds(bins[b].min, bins[b].max);
+            bins[b].count = 0;
+        }
+        for (UINT32 i = first; i < first + count; i++)
+        {
+            const float *bounds = ctx.bounds + ctx.indices[i] * 6;
+            const int b = min((int)((centroid(bounds, axis) - centroid_min[axis]) * scale), BVH_BIN_COUNT - 1);
+            growBounds(bins[b].min, bins[b].max, bounds, bounds + 3);
+            bins[b].count++;
+        }
+
+        // sweep from the right, then evaluate the split planes from the left
+        float right_area[BVH_BIN_COUNT - 1];
+        size_t right_count[BVH_BIN_COUNT - 1];
+        float sweep_min[3], sweep_max[3];
+        size_t sweep_count = 0;
+        resetBounds(sweep_min, sweep_max);
+        for (int b = BVH_BIN_COUNT - 1; b > 0; b--)
+        {
+            growBounds(sweep_min, sweep_max, bins[b].min, bins[b].max);
+            sweep_count += bins[b].count;
+            right_area[b - 1] = sweep_count ? halfSurfaceArea(sweep_min, sweep_max) : 0.0f;
+            right_count[b - 1] = sweep_count;
+        }
+        sweep_count = 0;
+        resetBounds(sweep_min, sweep_max);
+        for (int b = 0; b < BVH_BIN_COUNT - 1; b++)
+        {
+            growBounds(sweep_min, sweep_max, bins[b].min, bins[b].max);
+            sweep_count += bins[b].count;
+            if (sweep_count == 0 || right_count[b] == 0)
+            {
+                continue;
+            }
+            const float cost = sweep_count * halfSurfaceArea(sweep_min, sweep_max) + right_count[b] * right_area[b];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // all centroids coincide, or splitting costs more than intersecting everything
+    if (best_axis < 0)
+    {
+        return;
+    }
+    const float node_area = halfSurfaceArea(node.min, node.max);
+    if (count <= ctx.max_leaf_size && best_cost + BVH_TRAVERSAL_COST * node_area >= count * node_area)
+    {
+        return;
+    }
+
+    const float scale = BVH_BIN_COUNT / (centroid_max[best_axis] - centroid_min[best_axis]);
+    long i = first;
+    long j = first + count - 1;
+    while (i <= j)
+    {
+        const float *bounds = ctx.bounds + ctx.indices[i] * 6;
+        const int b = min((int)((centroid(bounds, best_axis) - centroid_min[best_axis]) * scale), BVH_BIN_COUNT - 1);
+        if (b <= best_split)
+        {
+            i++;
+        }
+        else
+        {
+            std::swap(ctx.indices[i], ctx.indices[j]);
+            j--;
+        }
+    }
+    const UINT32 left_count = (UINT32)(i - first);
+    assert(left_count > 0 && left_count < count);
+
+    // depth first layout, the first child follows its parent
+    node.count = 0;
+    const size_t left_index = ctx.node_count++;
+    subdivide(ctx, left_index, first, left_count, depth + 1);
+    const size_t right_index = ctx.node_count++;
+    ctx.nodes[node_index].offset = right_index;
+    subdivide(ctx, right_index, first + left_count, count - left_count, depth + 1);
+}
+
+// returns the node count, nodes must hold 2 * count - 1 nodes
+static size_t buildNodes(const float * bounds, UINT32 * indices, UINT32 count, size_t max_leaf_size, BVHNode * nodes)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    for (UINT32 i = 0; i < count; i++)
+    {
+        indices[i] = i;
+    }
+    BVHBuildContext ctx = { bounds, indices, nodes, 1, max_leaf_size };
+    subdivide(ctx, 0, 0, count, 0);
+    return ctx.node_count;
+}
+
+// parents come before their children, so a backward pass sees children first
+static void refitNodes(BVHNode * nodes, size_t node_count, const float * bounds, const UINT32 * indices)
+{
+    for (size_t n = node_count; n-- > 0; )
+    {
+        BVHNode & node = nodes[n];
+        resetBounds(node.min, node.max);
+        if (node.count)
+        {
+            for (UINT32 i = node.offset; i < node.offset + node.count; i++)
+            {
+                const float *prim = bounds + indices[i] * 6;
+                growBounds(node.min, node.max, prim, prim + 3);
+            }
+        }
+        else
+        {
+            growBounds(node.min, node.max, nodes[n + 1].min, nodes[n + 1].max);
+            growBounds(node.min, node.max, nodes[node.offset].min, nodes[node.offset].max);
+        }
+    }
+}
+
+static float * computeTriangleBounds(const TriangleMesh * mesh)
+{
+    const vec3 *vertices = mesh->getVertices();
+    const vec3i *faces = mesh->getFaces();
+    float *bounds = new float[mesh->faceCount() * 6];
+    for (size_t f = 0; f < mesh->faceCount(); f++)
+    {
+        float *b = bounds + f * 6;
+        resetBounds(b, b + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            const vec3 & p = vertices[faces[f][k]];
+            const float point[3] = { p.x, p.y, p.z };
+            growBounds(b, b + 3, point, point);
+        }
+    }
+    return bounds;
+}
+
+/**
+ * traversal
+ */
+
+struct BVHRay
+{
+    float origin[3];
+    float inv_direction[3];
+};
+
+static inline BVHRay prepareRay(const vec3 & origin, const vec3 & direction)
+{
+    BVHRay ray = {
+        { origin.x, origin.y, origin.z },
+        { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z }
+    };
+    return ray;
+}
+
+// slab test, t_entry is the distance to the box if it is hit before t_max
+static inline bool intersectBounds(const BVHNode & node, const BVHRay & ray, float t_max, float & t_entry)
+{
+    float t_min = 0.0f;
+    for (int a = 0; a < 3; a++)
+    {
+        const float t0 = (node.min[a] - ray.origin[a]) * ray.inv_direction[a];
+        const float t1 = (node.max[a] - ray.origin[a]) * ray.inv_direction[a];
+        t_min = max(t_min, min(t0, t1));
+        t_max = min(t_max, max(t0, t1));
+    }
+    t_entry = t_min;
+    return t_min <= t_max;
+}
+
+/**
+ * closest first traversal, leaf(first, count, t_max) intersects the primitives
+ * of a leaf, shrinks t_max on a hit and returns whether it hit anything
+ */
+template<typename LEAF>
+static bool traverse(const BVHNode * nodes, size_t node_count, const BVHRay & ray, float t_max, LEAF & leaf)
+{
+    float t_entry;
+    if (node_count == 0 || !intersectBounds(nodes[0], ray, t_max, t_entry))
+    {
+        return false;
+    }
+
+    UINT32 stack[BVH_MAX_DEPTH];
+    float stack_entry[BVH_MAX_DEPTH];
+    size_t stack_size = 0;
+    UINT32 node_index = 0;
+    bool found = false;
+    while (true)
+    {
+        const BVHNode & node = nodes[node_index];
+        if (node.count)
+        {
+            found |= leaf(node.offset, node.count, t_max);
+        }
+        else
+        {
+            UINT32 near_index = node_index + 1;
+            UINT32 far_index = node.offset;
+            float t_near, t_far;
+            bool hit_near = intersectBounds(nodes[near_index], ray, t_max, t_near);
+            bool hit_far = intersectBounds(nodes[far_index], ray, t_max, t_far);
+            if (hit_near && hit_far)
+            {
+                if (t_far < t_near)
+                {
+                    std::swap(near_index, far_index);
+                    std::swap(t_near, t_far);
+                }
+                assert(stack_size < BVH_MAX_DEPTH);
+                stack[stack_size] = far_index;
+                stack_entry[stack_size] = t_far;
+                stack_size++;
+                node_index = near_index;
+                continue;
+            }
+            if (hit_near || hit_far)
+            {
+                node_index = hit_near ? near_index : far_index;
+                continue;
+            }
+        }
+
+        // pop the next subtree that may still hold a closer hit
+        do
+        {
+            if (stack_size == 0)
+            {
+                return found;
+            }
+            stack_size--;
+        } while (stack_entry[stack_size] > t_max);
+        node_index = stack[stack_size];
+    }
+}
+
+/**
+ * MeshBVH
+ */
+
+MeshBVH::MeshBVH(const TriangleMesh * mesh):
+    m_nodes(nullptr),
+    m_node_count(0),
+    m_face_indices(nullptr),
+    m_triangles(nullptr),
+    m_face_count(mesh->faceCount())
+{
+    if (m_face_count == 0)
+    {
+        return;
+    }
+
+    float *bounds = computeTriangleBounds(mesh);
+    m_face_indices = new UINT32[m_face_count];
+    m_nodes = new BVHNode[2 * m_face_count - 1];
+    m_node_count = buildNodes(bounds, m_face_indices, m_face_count, BVH_MAX_LEAF_SIZE, m_nodes);
+    delete[] bounds;
+
+    m_triangles = new vec3[m_face_count * 3];
+    loadTriangles(mesh);
+}
+
+MeshBVH::~MeshBVH()
+{
+    delete[] m_nodes;
+    delete[] m_face_indices;
+    delete[] m_triangles;
+}
+
+void MeshBVH::loadTriangles(const TriangleMesh * mesh)
+{
+    const vec3 *vertices = mesh->getVertices();
+    const vec3i *faces = mesh->getFaces();
+    for (size_t i = 0; i < m_face_count; i++)
+    {
+        const vec3i & face = faces[m_face_indices[i]];
+        m_triangles[i * 3 + 0] = vertices[face[0]];
+        m_triangles[i * 3 + 1] = vertices[face[1]];
+        m_triangles[i * 3 + 2] = vertices[face[2]];
+    }
+}
+
+BoundingBox MeshBVH::getBoundingBox() const
+{
+    if (m_node_count == 0)
+    {
+        return BoundingBox();
+    }
+    return BoundingBox(
+        m_nodes[0].min[0], m_nodes[0].min[1], m_nodes[0].min[2],
+        m_nodes[0].max[0], m_nodes[0].max[1], m_nodes[0].max[2]
+    );
+}
+
+void MeshBVH::refit(const TriangleMesh * mesh)
+{
+    assert(mesh->faceCount() == m_face_count);
+    if (m_face_count == 0)
+    {
+        return;
+    }
+    float *bounds = computeTriangleBounds(mesh);
+    refitNodes(m_nodes, m_node_count, bounds, m_face_indices);
+    delete[] bounds;
+    loadTriangles(mesh);
+}
+
+bool MeshBVH::intersect(const Ray & ray, float t_max, RayHit & hit) const
+{
+    const vec3 *triangles = m_triangles;
+    const UINT32 *face_indices = m_face_indices;
+    auto leaf = [&](UINT32 first, UINT32 count, float & t_closest) {
+        bool found = false;
+        for (UINT32 i = first; i < first + count; i++)
+        {
+            float t, u, v;
+            if (ray.intersectWithTriangle(triangles[i * 3], triangles[i * 3 + 1], triangles[i * 3 + 2], &t, &u, &v) &&
+                t < t_closest)
+            {
+                t_closest = t;
+                hit.t = t;
+                hit.u = u;
+                hit.v = v;
+                hit.face_idx = face_indices[i];
+                found = true;
+            }
+        }
+        return found;
+    };
+    return traverse(m_nodes, m_node_count, prepareRay(ray.origin(), ray.direction()), t_max, leaf);
+}
+
+/**
+ * SceneBVH
+ */
+
+SceneBVH::SceneBVH(const Scene & scene):
+    m_scene(&scene),
+    m_nodes(nullptr),
+    m_node_count(0),
+    m_instance_indices(nullptr),
+    m_instance_count(0)
+{
+    const DynamicArray<Entity*> & entities = *scene.getEntities();
+    m_entity_bvhs = new MeshBVH*[max(entities.size(), (size_t)1)];
+    m_inv_transforms = new mat4[max(entities.size(), (size_t)1)];
+    for (size_t e = 0; e < entities.size(); e++)
+    {
+        // one hierarchy per distinct mesh
+        const TriangleMesh *mesh = entities[e]->getTriangleMesh();
+        m_entity_bvhs[e] = nullptr;
+        if (mesh == nullptr || mesh->faceCount() == 0)
+        {
+            continue;
+        }
+        for (size_t p = 0; p < e && m_entity_bvhs[e] == nullptr; p++)
+        {
+            if (m_entity_bvhs[p] && entities[p]->getTriangleMesh() == mesh)
+            {
+                m_entity_bvhs[e] = m_entity_bvhs[p];
+            }
+        }
+        if (m_entity_bvhs[e] == nullptr)
+        {
+            m_entity_bvhs[e] = new MeshBVH(mesh);
+            m_mesh_bvhs.push_back(m_entity_bvhs[e]);
+        }
+        m_instance_count++;
+    }
+
+    if (m_instance_count == 0)
+    {
+        return;
+    }
+    m_instance_indices = new UINT32[m_instance_count];
+    m_nodes = new BVHNode[2 * m_instance_count - 1];
+
+    // bounds are per entity, only entities with triangles take part in the build
+    float *bounds = new float[entities.size() * 6];
+    computeInstanceBounds(bounds);
+    float *instance_bounds = new float[m_instance_count * 6];
+    UINT32 *instance_entities = new UINT32[m_instance_count];
+    for (size_t e = 0, i = 0; e < entities.size(); e++)
+    {
+        if (m_entity_bvhs[e])
+        {
+            memcpy(instance_bounds + i * 6, bounds + e * 6, sizeof(float) * 6);
+            instance_entities[i++] = e;
+        }
+    }
+    m_node_count = buildNodes(instance_bounds, m_instance_indices, m_instance_count, 1, m_nodes);
+    for (size_t i = 0; i < m_instance_count; i++)
+    {
+        m_instance_indices[i] = instance_entities[m_instance_indices[i]];
+    }
+
+    delete[] instance_entities;
+    delete[] instance_bounds;
+    delete[] bounds;
+}
+
+SceneBVH::~SceneBVH()
+{
+    for (size_t i = 0; i < m_mesh_bvhs.size(); i++)
+    {
+        delete m_mesh_bvhs[i];
+    }
+    delete[] m_entity_bvhs;
+    delete[] m_inv_transforms;
+    delete[] m_instance_indices;
+    delete[] m_nodes;
+}
+
+// world bounds of every entity from the 8 corners of its model space bounds,
+// also caches the inverse transforms
+void SceneBVH::computeInstanceBounds(float * bounds) const
+{
+    const DynamicArray<Entity*> & entities = *m_scene->getEntities();
+    for (size_t e = 0; e < entities.size(); e++)
+    {
+        float *b = bounds + e * 6;
+        resetBounds(b, b + 3);
+        if (m_entity_bvhs[e] == nullptr)
+        {
+            continue;
+        }
+
+        const mat4 transform = entities[e]->getTransform();
+        m_inv_transforms[e] = transform.inversed();
+        const BVHNode & root = m_entity_bvhs[e]->getNodes()[0];
+        for (int c = 0; c < 8; c++)
+        {
+            const vec4 p = transform * vec4(
+                root.min[0] + ((c & 1) ? root.max[0] - root.min[0] : 0.0f),
+                root.min[1] + ((c & 2) ? root.max[1] - root.min[1] : 0.0f),
+                root.min[2] + ((c & 4) ? root.max[2] - root.min[2] : 0.0f),
+                1.0f);
+            const float point[3] = { p.x, p.y, p.z };
+            growBounds(b, b + 3, point, point);
+        }
+    }
+}
+
+void SceneBVH::refit()
+{
+    assert(m_scene->getEntities()->size() >= m_instance_count);
+    if (m_instance_count == 0)
+    {
+        return;
+    }
+    float *bounds = new float[m_scene->getEntities()->size() * 6];
+    computeInstanceBounds(bounds);
+    // leaves index the entities directly
+    refitNodes(m_nodes, m_node_count, bounds, m_instance_indices);
+    delete[] bounds;
+}
+
+bool SceneBVH::intersect(const Ray & ray, float t_max, RayHit & hit) const
+{
+    auto leaf = [&](UINT32 first, UINT32 count, float & t_closest) {
+        bool found = false;
+        for (UINT32 i = first; i < first + count; i++)
+        {
+            const size_t e = m_instance_indices[i];
+            // direction is not normalized, t stays the world space ray parameter
+            const mat4 & inv = m_inv_transforms[e];
+            const Ray model_ray(
+                vec3(inv * vec4(ray.origin().x, ray.origin().y, ray.origin().z, 1.0f)),
+                vec3(inv * vec4(ray.direction().x, ray.direction().y, ray.direction().z, 0.0f)));
+            if (m_entity_bvhs[e]->intersect(model_ray, t_closest, hit))
+            {
+                t_closest = hit.t;
+                hit.entity_idx = e;
+                found = true;
+            }
+        }
+        return found;
+    };
+    return traverse(m_nodes, m_node_count, prepareRay(ray.origin(), ray.direction()), t_max, leaf);
+}
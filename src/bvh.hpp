@@ -0,0 +1,127 @@
+#ifndef __BVH_HPP__
+#define __BVH_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <float.h>
+#include "global.hpp"
+#include "maths.hpp"
+#include "mesh.hpp"
+#include "entity.hpp"
+#include "scene.hpp"
+#include "ray.hpp"
+
+namespace Lurdr
+{
+
+// centroid bins per axis of the binned SAH build
+#define BVH_BIN_COUNT 16
+// leaves hold at most this many triangles, fewer if the SAH says splitting pays
+#define BVH_MAX_LEAF_SIZE 4
+// SAH cost of visiting a node relative to one triangle test
+#define BVH_TRAVERSAL_COST 1.0f
+// also the traversal stack size, deeper nodes become leaves
+#define BVH_MAX_DEPTH 64
+
+/**
+ * 32 bytes, two nodes per cache line. Nodes are stored depth first, the first
+ * child of an interior node directly follows it, so a parent always comes
+ * before its children.
+ */
+struct BVHNode
+{
+    float   min[3];
+    UINT32  offset;     // interior: index of the second child, leaf: first primitive
+    float   max[3];
+    UINT32  count;      // primitives of a leaf, 0 for interior nodes
+};
+
+struct RayHit
+{
+    float   t;          // ray parameter, origin + direction * t
+    float   u;          // barycentric coordinates of the hit in its triangle
+    float   v;
+    size_t  face_idx;
+    size_t  entity_idx; // index into Scene::getEntities(), SceneBVH only
+};
+
+/**
+ * Bounding volume hierarchy over the triangles of a TriangleMesh in model
+ * space, built with binned SAH. Triangle vertices are copied in leaf order so
+ * leaves read contiguous memory.
+ */
+class MeshBVH
+{
+private:
+    BVHNode *m_nodes;
+    size_t  m_node_count;
+    UINT32  *m_face_indices;    // leaf order to mesh face
+    vec3    *m_triangles;       // three vertices per face in leaf order
+    size_t  m_face_count;
+
+    void loadTriangles(const TriangleMesh * mesh);
+public:
+    MeshBVH() = delete;
+    MeshBVH(const TriangleMesh * mesh);
+    ~MeshBVH();
+
+    MeshBVH(const MeshBVH &) = delete;
+    MeshBVH& operator= (const MeshBVH &) = delete;
+
+    size_t getNodeCount() const { return m_node_count; }
+    const BVHNode * getNodes() const { return m_nodes; }
+    BoundingBox getBoundingBox() const;
+
+    /**
+     * update the bounds after the vertices of mesh moved, the faces must be
+     * the ones the hierarchy was built from
+     */
+    void refit(const TriangleMesh * mesh);
+
+    /**
+     * closest hit with t in (0, t_max), hit is only written on a hit
+     */
+    bool intersect(const Ray & ray, float t_max, RayHit & hit) const;
+};
+
+/**
+ * Two level hierarchy of a scene, one MeshBVH per distinct mesh (shared by
+ * entities using the same mesh) and a top level SAH hierarchy over the world
+ * bounds of the entities. Rays are moved into model space per entity.
+ */
+class SceneBVH
+{
+private:
+    const Scene             *m_scene;
+    BVHNode                 *m_nodes;
+    size_t                  m_node_count;
+    DynamicArray<MeshBVH*>  m_mesh_bvhs;
+    MeshBVH                 **m_entity_bvhs;        // per entity, nullptr without triangles
+    mat4                    *m_inv_transforms;      // per entity, world to model space
+    UINT32                  *m_instance_indices;    // leaf order to entity
+    size_t                  m_instance_count;
+
+    void computeInstanceBounds(float * bounds) const;
+public:
+    SceneBVH() = delete;
+    SceneBVH(const Scene & scene);
+    ~SceneBVH();
+
+    SceneBVH(const SceneBVH &) = delete;
+    SceneBVH& operator= (const SceneBVH &) = delete;
+
+    size_t getNodeCount() const { return m_node_count; }
+
+    /**
+     * update the top level after entity transforms changed, entities must not
+     * have been added or removed since the build
+     */
+    void refit();
+
+    bool intersect(const Ray & ray, float t_max, RayHit & hit) const;
+};
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <string.h>
 #include <utility>
+#include <type_traits>
 #include "global.hpp"
 
 namespace Lurdr
@@ -16,7 +17,7 @@ template <typename T, size_t S>
 class Array
 {
 private:
-    T m_data[S]; 
+    T m_data[S];
 public:
     size_t size() const { return S; }
 
@@ -29,7 +30,124 @@ public:
 
 typedef Array<long,3> vec3i;
 
-// DynamicArray implement basic functionalities as STL std::vector
+// ranges shorter than this are left to insertion sort
+#define SORT_INSERTION_THRESHOLD 16
+
+template<typename T, typename Compare>
+void insertionSort(T * first, T * last, Compare cmp)
+{
+    for (T *i = first + 1; i < last; i++)
+    {
+        T value = std::move(*i);
+        T *j = i;
+        while (j > first && cmp(value, j[-1]))
+        {
+            *j = std::move(j[-1]);
+            j--;
+        }
+        *j = std::move(value);
+    }
+}
+
+template<typename T, typename Compare>
+void siftDown(T * array, size_t root, size_t count, Compare cmp)
+{
+    T value = std::move(array[root]);
+    size_t child;
+    while ((child = root * 2 + 1) < count)
+    {
+        if (child + 1 < count && cmp(array[child], array[child + 1])) child++;
+        if (!cmp(value, array[child])) break;
+        array[root] = std::move(array[child]);
+        root = child;
+    }
+    array[root] = std::move(value);
+}
+
+template<typename T, typename Compare>
+void heapSort(T * first, T * last, Compare cmp)
+{
+    const size_t count = last - first;
+    for (size_t i = count / 2; i-- > 0;)
+    {
+        siftDown(first, i, count, cmp);
+    }
+    for (size_t i = count; i-- > 1;)
+    {
+        std::swap(first[0], first[i]);
+        siftDown(first, 0, i, cmp);
+    }
+}
+
+template<typename T, typename Compare>
+void introSortLoop(T * first, T * last, size_t depth, Compare cmp)
+{
+    while (last - first > SORT_INSERTION_THRESHOLD)
+    {
+        if (depth == 0)
+        {
+            heapSort(first, last, cmp);
+            return;
+        }
+        depth--;
+
+        // median of three to the front as the pivot
+        T *middle = first + (last - first) / 2;
+        T *back = last - 1;
+        if (cmp(*middle, *first)) std::swap(*middle, *first);
+        if (cmp(*back, *middle))
+        {
+            std::swap(*back, *middle);
+            if (cmp(*middle, *first)) std::swap(*middle, *first);
+        }
+        std::swap(*first, *middle);
+
+        T *i = first + 1;
+        T *j = last - 1;
+        while (true)
+        {
+            while (i <= j && cmp(*i, *first)) i++;
+            while (i <= j && cmp(*first, *j)) j--;
+            if (i >= j) break;
+            std::swap(*i++, *j--);
+        }
+        std::swap(*first, *j);
+
+        // recurse into the smaller side so the stack stays within log2(n)
+        if (j - first < last - (j + 1))
+        {
+            introSortLoop(first, j, depth, cmp);
+            first = j + 1;
+        }
+        else
+        {
+            introSortLoop(j + 1, last, depth, cmp);
+            last = j;
+        }
+    }
+}
+
+/**
+ * Introsort : quick sort with a median of three pivot, switching to heap
+ * sort past 2 * log2(n) levels so the worst case stays O(n log n), and to
+ * insertion sort on short ranges. Not stable, cmp is a strict weak ordering.
+ */
+template<typename T, typename Compare>
+void introSort(T * first, T * last, Compare cmp)
+{
+    if (last - first < 2) return;
+    size_t depth = 0;
+    for (size_t n = last - first; n > 1; n >>= 1) depth += 2;
+    introSortLoop(first, last, depth, cmp);
+    insertionSort(first, last, cmp);
+}
+
+/**
+ * DynamicArray implement basic functionalities as STL std::vector.
+ * Storage is new[] allocated, spare capacity holds default constructed
+ * elements, so a buffer taken with release() is freed with delete[] and
+ * adopt() takes any new[] allocated array.
+ */
 template<typename T>
 class DynamicArray
 {
@@ -38,49 +156,104 @@ private:
     size_t  m_size;
     size_t  m_capacity;
 
+    static void copyElements(T * destination, const T * source, const size_t & count);
+    static void moveElements(T * destination, T * source, const size_t & count);
+    void reallocate(const size_t & capacity);
+    void grow(const size_t & required);
+    void resetElements(const size_t & begin, const size_t & end);
+
 public:
     DynamicArray(): m_array(NULL),
                     m_size(0),
                     m_capacity(0) {}
-    DynamicArray(const size_t & reserve);
+    DynamicArray(const size_t & size);
+    DynamicArray(const size_t & size, const T & value);
     DynamicArray(const DynamicArray & array);
+    DynamicArray(DynamicArray && array);
     ~DynamicArray();
 
-    void push_back(const T element);
+    DynamicArray& operator= (const DynamicArray & array);
+    DynamicArray& operator= (DynamicArray && array);
+    void swap(DynamicArray & array);
+
+    void push_back(const T & element);
+    void push_back(T && element);
+    template<typename... Args>
+    T& emplace_back(Args&&... args);
     void pop_back();
-    T back() const;
-    T front() const;
-    T at(const size_t & pos) const;
+    // copy [first, last) before pos, the range must not be inside this array
+    void insert(const size_t & pos, const T * first, const T * last);
+    void append(const T * elements, const size_t & count);
+
+    T& back();
+    const T& back() const;
+    T& front();
+    const T& front() const;
+    const T& at(const size_t & pos) const;
     T& operator[] (const size_t & pos);
     const T& operator[] (const size_t & pos) const;
+
     void clear();
+    void reserve(const size_t & capacity);
+    void resize(const size_t & size);
+    void resize(const size_t & size, const T & value);
     bool empty() const;
     size_t size() const;
     size_t capacity() const;
     T* data() const;
+    T* begin() const { return m_array; }
+    T* end() const { return m_array + m_size; }
+
+    /**
+     * hand the new[] allocated buffer of capacity() elements over to the
+     * caller, the array is left empty. nullptr if nothing was allocated.
+     */
+    T* release();
+    // take ownership of a new[] allocated array of capacity elements, the first size in use
+    void adopt(T * array, const size_t & size, const size_t & capacity);
 
-    void sort(bool (*cmp)(const T &, const T &));
+    template<typename Compare>
+    void sort(Compare cmp);
 };
 
 // note : classes with template have to implement their member functions within the header file
 // see : https://stackoverflow.com/questions/495021/why-can-templates-only-be-implemented-in-the-header-file
 template<typename T>
-DynamicArray<T>::DynamicArray(const size_t & reserve)
+DynamicArray<T>::DynamicArray(const size_t & size)
 {
-    m_size = reserve;
-    m_capacity = reserve;
-    m_array = new T[m_size];
+    m_size = size;
+    m_capacity = size;
+    m_array = size > 0 ? new T[size] : NULL;
 }
 template<typename T>
-DynamicArray<T>::DynamicArray(const DynamicArray & array)
+DynamicArray<T>::DynamicArray(const size_t & size, const T & value)
 {
-    m_size = array.m_size;
-    m_capacity = array.m_capacity;
+    m_size = size;
+    m_capacity = size;
+    m_array = size > 0 ? new T[size] : NULL;
     for (size_t i = 0; i < m_size; i++)
     {
-        m_array[i] = std::move(array.m_array[i]);
+        m_array[i] = value;
     }
 }
+template<typename T>
+DynamicArray<T>::DynamicArray(const DynamicArray & array)
+{
+    m_size = array.m_size;
+    m_capacity = array.m_size;
+    m_array = m_size > 0 ? new T[m_size] : NULL;
+    copyElements(m_array, array.m_array, m_size);
+}
+template<typename T>
+DynamicArray<T>::DynamicArray(DynamicArray && array)
+{
+    m_array = array.m_array;
+    m_size = array.m_size;
+    m_capacity = array.m_capacity;
+    array.m_array = NULL;
+    array.m_size = 0;
+    array.m_capacity = 0;
+}
 
 template<typename T>
 DynamicArray<T>::~DynamicArray()
@@ -89,90 +262,257 @@ DynamicArray<T>::~DynamicArray()
 }
 
 template<typename T>
-void DynamicArray<T>::push_back(const T element)
+DynamicArray<T>& DynamicArray<T>::operator= (const DynamicArray & array)
 {
-    if (m_capacity == 0)
+    if (this != &array)
     {
-        m_capacity = 1;
-        m_array = new T[m_capacity];
-        m_array[m_size++] = element;
+        DynamicArray copy(array);
+        swap(copy);
     }
-    else if (m_size == m_capacity)
+    return *this;
+}
+template<typename T>
+DynamicArray<T>& DynamicArray<T>::operator= (DynamicArray && array)
+{
+    if (this != &array)
     {
-        m_capacity *= 2;
-        T *new_array = new T[m_capacity];
-        for (size_t i = 0; i < m_size; i++)
+        delete[] m_array;
+        m_array = array.m_array;
+        m_size = array.m_size;
+        m_capacity = array.m_capacity;
+        array.m_array = NULL;
+        array.m_size = 0;
+        array.m_capacity = 0;
+    }
+    return *this;
+}
+template<typename T>
+void DynamicArray<T>::swap(DynamicArray & array)
+{
+    std::swap(m_array, array.m_array);
+    std::swap(m_size, array.m_size);
+    std::swap(m_capacity, array.m_capacity);
+}
+
+template<typename T>
+void DynamicArray<T>::copyElements(T * destination, const T * source, const size_t & count)
+{
+    if (std::is_trivially_copyable<T>::value)
+    {
+        if (count > 0) memcpy((void*)destination, (const void*)source, count * sizeof(T));
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        destination[i] = source[i];
+    }
+}
+template<typename T>
+void DynamicArray<T>::moveElements(T * destination, T * source, const size_t & count)
+{
+    // ranges may overlap
+    if (std::is_trivially_copyable<T>::value)
+    {
+        if (count > 0) memmove((void*)destination, (const void*)source, count * sizeof(T));
+        return;
+    }
+    if (destination < source)
+    {
+        for (size_t i = 0; i < count; i++) destination[i] = std::move(source[i]);
+    }
+    else
+    {
+        for (size_t i = count; i-- > 0;) destination[i] = std::move(source[i]);
+    }
+}
+
+template<typename T>
+void DynamicArray<T>::reallocate(const size_t & capacity)
+{
+    T *new_array = new T[capacity];
+    moveElements(new_array, m_array, m_size);
+    delete[] m_array;
+    m_array = new_array;
+    m_capacity = capacity;
+}
+template<typename T>
+void DynamicArray<T>::grow(const size_t & required)
+{
+    // geometric growth keeps push_back amortized O(1)
+    size_t capacity = m_capacity > 0 ? m_capacity * 2 : 4;
+    if (capacity < required) capacity = required;
+    reallocate(capacity);
+}
+template<typename T>
+void DynamicArray<T>::resetElements(const size_t & begin, const size_t & end)
+{
+    // elements past the size give back what they hold, trivial ones are left as is
+    if (!std::is_trivially_destructible<T>::value)
+    {
+        for (size_t i = begin; i < end; i++)
         {
-            new_array[i] = m_array[i];
+            m_array[i] = T();
         }
-        delete[] m_array;
-        m_array = new_array;
-        m_array[m_size++] = element;
+    }
+}
+
+template<typename T>
+void DynamicArray<T>::push_back(const T & element)
+{
+    if (m_size == m_capacity)
+    {
+        // element may be inside the array
+        T copy(element);
+        grow(m_size + 1);
+        m_array[m_size++] = std::move(copy);
     }
     else
     {
         m_array[m_size++] = element;
     }
 }
+template<typename T>
+void DynamicArray<T>::push_back(T && element)
+{
+    if (m_size == m_capacity)
+    {
+        T moved(std::move(element));
+        grow(m_size + 1);
+        m_array[m_size++] = std::move(moved);
+    }
+    else
+    {
+        m_array[m_size++] = std::move(element);
+    }
+}
+template<typename T>
+template<typename... Args>
+T& DynamicArray<T>::emplace_back(Args&&... args)
+{
+    // slots are constructed already, the element is built and moved in
+    if (m_size == m_capacity) grow(m_size + 1);
+    m_array[m_size] = T(std::forward<Args>(args)...);
+    return m_array[m_size++];
+}
 
 template<typename T>
 void DynamicArray<T>::pop_back()
 {
     assert(m_size > 0);
     m_size--;
-    m_array[m_size].~T();
+    resetElements(m_size, m_size + 1);
 }
 
 template<typename T>
-T DynamicArray<T>::back() const
+void DynamicArray<T>::insert(const size_t & pos, const T * first, const T * last)
+{
+    assert(pos <= m_size);
+    assert(last <= m_array || first >= m_array + m_capacity || first == last);
+    const size_t count = last - first;
+    if (count == 0) return;
+
+    if (m_size + count > m_capacity)
+    {
+        size_t capacity = m_capacity * 2;
+        if (capacity < m_size + count) capacity = m_size + count;
+        T *new_array = new T[capacity];
+        moveElements(new_array, m_array, pos);
+        moveElements(new_array + pos + count, m_array + pos, m_size - pos);
+        delete[] m_array;
+        m_array = new_array;
+        m_capacity = capacity;
+    }
+    else
+    {
+        moveElements(m_array + pos + count, m_array + pos, m_size - pos);
+    }
+    copyElements(m_array + pos, first, count);
+    m_size += count;
+}
+template<typename T>
+void DynamicArray<T>::append(const T * elements, const size_t & count)
+{
+    insert(m_size, elements, elements + count);
+}
+
+template<typename T>
+T& DynamicArray<T>::back()
 {
     assert(m_size > 0);
     return m_array[m_size - 1];
 }
 template<typename T>
-T DynamicArray<T>::front() const
+const T& DynamicArray<T>::back() const
+{
+    assert(m_size > 0);
+    return m_array[m_size - 1];
+}
+template<typename T>
+T& DynamicArray<T>::front()
 {
     assert(m_size > 0);
     return m_array[0];
 }
 template<typename T>
-T DynamicArray<T>::at(const size_t & pos) const
-{   
+const T& DynamicArray<T>::front() const
+{
+    assert(m_size > 0);
+    return m_array[0];
+}
+template<typename T>
+const T& DynamicArray<T>::at(const size_t & pos) const
+{
     assert(pos < m_size);
     return m_array[pos];
 }
 template<typename T>
 T& DynamicArray<T>::operator[] (const size_t & pos)
 {
-    assert(pos < m_capacity);
-    // if (pos >= m_capacity)
-    // {
-    //     m_capacity = pos + 1;
-    //     T *new_array = new T[m_capacity];
-    //     for (size_t i = 0; i < m_size; i++)
-    //     {
-    //         new_array[i] = m_array[i];
-    //     }
-    //     delete[] m_array;
-    //     m_array = new_array;
-    //     m_size = m_capacity;
-    // }
+    assert(pos < m_size);
     return m_array[pos];
 }
 template<typename T>
 const T& DynamicArray<T>::operator[] (const size_t & pos) const
 {
-    assert(pos < m_capacity);
+    assert(pos < m_size);
     return m_array[pos];
 }
+
 template<typename T>
 void DynamicArray<T>::clear()
 {
-    for (size_t i = 0; i < m_size; i++)
+    resetElements(0, m_size);
+    m_size = 0;
+}
+template<typename T>
+void DynamicArray<T>::reserve(const size_t & capacity)
+{
+    if (capacity > m_capacity) reallocate(capacity);
+}
+template<typename T>
+void DynamicArray<T>::resize(const size_t & size)
+{
+    if (size > m_capacity) grow(size);
+    // slots past the size may hold old values, trivial ones are never reset
+    for (size_t i = m_size; i < size; i++) m_array[i] = T();
+    if (size < m_size) resetElements(size, m_size);
+    m_size = size;
+}
+template<typename T>
+void DynamicArray<T>::resize(const size_t & size, const T & value)
+{
+    if (size > m_capacity)
     {
-        m_array[i].~T();
+        T copy(value);
+        grow(size);
+        for (size_t i = m_size; i < size; i++) m_array[i] = copy;
     }
-    m_size = 0;
+    else
+    {
+        for (size_t i = m_size; i < size; i++) m_array[i] = value;
+    }
+    if (size < m_size) resetElements(size, m_size);
+    m_size = size;
 }
 template<typename T>
 bool DynamicArray<T>::empty() const
@@ -196,9 +536,30 @@ T* DynamicArray<T>::data() const
 }
 
 template<typename T>
-void DynamicArray<T>::sort(bool(*cmp)(const T &, const T &))
+T* DynamicArray<T>::release()
+{
+    T *array = m_array;
+    m_array = NULL;
+    m_size = 0;
+    m_capacity = 0;
+    return array;
+}
+template<typename T>
+void DynamicArray<T>::adopt(T * array, const size_t & size, const size_t & capacity)
+{
+    assert(size <= capacity);
+    if (array == m_array) return;
+    delete[] m_array;
+    m_array = array;
+    m_size = array ? size : 0;
+    m_capacity = array ? capacity : 0;
+}
+
+template<typename T>
+template<typename Compare>
+void DynamicArray<T>::sort(Compare cmp)
 {
-    qsort(m_array, 0, m_size - 1, cmp);
+    introSort(m_array, m_array + m_size, cmp);
 }
 
 }
@@ -1,9 +1,11 @@
 #include "entity.hpp"
+#include "streaming.hpp"
 
 using namespace Lurdr;
 
 EntityConfig::EntityConfig(const char * filename):
     mesh_filename(nullptr),
+    stream_filename(nullptr),
     albedo_map(nullptr),
     diffuse_map(nullptr),
     specular_map(nullptr),
@@ -39,6 +41,15 @@ void EntityConfig::loadFromFile(const char * filename)
                 strcpy(mesh_filename, filename_buffer);
             }
         }
+        else if (strncmp(line_buffer, "stream ", 7) == 0)
+        {
+            scanned_items = sscanf(line_buffer, "stream %s", filename_buffer);
+            if (scanned_items == 1)
+            {
+                stream_filename = new char[strlen(filename_buffer) + 1];
+                strcpy(stream_filename, filename_buffer);
+            }
+        }
         else if (strncmp(line_buffer, "albedo ", 7) == 0)
         {
             scanned_items = sscanf(line_buffer, "albedo %s", filename_buffer);
@@ -81,11 +92,13 @@ void EntityConfig::loadFromFile(const char * filename)
 EntityConfig::~EntityConfig()
 {
     if (mesh_filename)  delete mesh_filename;
+    if (stream_filename) delete[] stream_filename;
     if (albedo_map)     delete albedo_map;
     if (diffuse_map)    delete diffuse_map;
     if (specular_map)   delete specular_map;
     if (normal_map)     delete normal_map;
     mesh_filename = nullptr;
+    stream_filename = nullptr;
     albedo_map = nullptr;
     diffuse_map = nullptr;
     specular_map = nullptr;
@@ -97,8 +110,13 @@ Entity::Entity():
     m_distance(0.0f),
     m_material(nullptr),
     m_mesh(nullptr),
+    m_streaming_mesh(nullptr),
     m_material_need_delete(false),
-    m_mesh_need_delete(false) {}
+    m_mesh_need_delete(false),
+    m_streaming_mesh_need_delete(false),
+    m_occluder(false),
+    m_lod_level(0),
+    m_lod_hysteresis(LOD_HYSTERESIS) {}
 
 Entity::Entity(const entityConf & config):
     Entity()
@@ -108,6 +126,11 @@ Entity::Entity(const entityConf & config):
         m_mesh = new TriangleMesh(config.mesh_filename);
         m_mesh_need_delete = true;
     }
+    if (config.stream_filename)
+    {
+        m_streaming_mesh = new StreamingMesh(config.stream_filename);
+        m_streaming_mesh_need_delete = true;
+    }
 
     m_material = new Material();
     m_material_need_delete = true;
@@ -134,6 +157,24 @@ Entity::~Entity()
 {
     if (m_material_need_delete) delete m_material;
     if (m_mesh_need_delete) delete m_mesh;
+    if (m_streaming_mesh_need_delete) delete m_streaming_mesh;
+}
+
+size_t Entity::selectLod(float screen_size)
+{
+    const size_t level_count = m_mesh ? m_mesh->lodCount() : 1;
+    size_t level = min(m_lod_level, level_count - 1);
+    // level k > 0 is drawn below LOD_SCREEN_SIZE / 2^(k - 1)
+    while (level + 1 < level_count && screen_size < LOD_SCREEN_SIZE * powf(0.5f, (float)level) * (1.0f - m_lod_hysteresis))
+    {
+        level++;
+    }
+    while (level > 0 && screen_size > LOD_SCREEN_SIZE * powf(0.5f, (float)(level - 1)) * (1.0f + m_lod_hysteresis))
+    {
+        level--;
+    }
+    m_lod_level = level;
+    return level;
 }
 
 bool Entity::compareDistance(Entity * const & a, Entity * const & b)
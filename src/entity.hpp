@@ -13,12 +13,20 @@
 namespace Lurdr
 {
 
+class StreamingMesh;
+
 #define MAX_CONF_LINE 256
+// bounds covering this fraction of the view switch to the first simplified
+// level of detail, every further level switches at half the size
+#define LOD_SCREEN_SIZE 0.5f
+// default band around every switch size, relative, keeps levels from flickering
+#define LOD_HYSTERESIS 0.1f
 
 class EntityConfig
 {
 public:
     char *mesh_filename;
+    char *stream_filename;     // StreamingMesh::build output, drawn instead of mesh
     char *albedo_map;
     char *diffuse_map;
     char *specular_map;
@@ -40,8 +48,13 @@ private:
 
     Material        *m_material;
     TriangleMesh    *m_mesh;
+    StreamingMesh   *m_streaming_mesh;
     bool            m_material_need_delete;
     bool            m_mesh_need_delete;
+    bool            m_streaming_mesh_need_delete;
+    bool            m_occluder;
+    size_t          m_lod_level;
+    float           m_lod_hysteresis;
 
 public:
     Entity();
@@ -62,9 +75,30 @@ public:
     const TriangleMesh * getTriangleMesh() const { return m_mesh; }
     TriangleMesh * getTriangleMesh() { return m_mesh; }
 
+    // drawn instead of the triangle mesh when set, its chunks are streamed in by the pipeline
+    void setStreamingMesh(StreamingMesh * mesh) { m_streaming_mesh = mesh; }
+    const StreamingMesh * getStreamingMesh() const { return m_streaming_mesh; }
+    StreamingMesh * getStreamingMesh() { return m_streaming_mesh; }
+
     void setMaterial(Material * material) { m_material = material; }
     const Material * getMaterial() const { return m_material; }
 
+    // occluders are drawn into the occlusion buffer that culls the other entities, always at level 0
+    void setOccluder(bool occluder) { m_occluder = occluder; if (occluder) m_lod_level = 0; }
+    bool isOccluder() const { return m_occluder; }
+
+    // level of detail of the mesh drawn by the pipeline, 0 is the full mesh
+    void setLodHysteresis(float hysteresis) { m_lod_hysteresis = hysteresis; }
+    float getLodHysteresis() const { return m_lod_hysteresis; }
+    size_t getLodLevel() const { return m_lod_level; }
+    const TriangleMesh * getLodMesh() const { return m_mesh ? m_mesh->getLod(m_lod_level) : nullptr; }
+    /**
+     * move to the level for bounds covering screen_size of the view (half the
+     * larger extent in normalized device coordinates), a switch needs the size
+     * to pass the switch size by the hysteresis
+     */
+    size_t selectLod(float screen_size);
+
     void setDistance(float distance) { m_distance = distance; }
     static bool compareDistance(Entity * const & a, Entity * const & b);
 };
@@ -44,9 +44,10 @@ private:
 public:
     EnvLight() = delete;
     EnvLight(const char * filename);
+    ~EnvLight();
 
     virtual LightComp getLight(vec3 normal, vec3 frag_pos, vec3 view_dir);
-}
+};
 
 }
 
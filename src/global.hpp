@@ -25,18 +25,42 @@ public:
     bool depth_test;
     bool backface_culling;
     bool texture_filtering_linear;
+    long thread_count;
+    bool deferred_shading;
+    bool depth_prepass;
+    bool occlusion_culling;
+    bool optimize_meshes;
+    bool mesh_cache;
+    bool build_meshlets;
+    long lod_levels;
 
     Global():
         wireframe_mode(false),
         depth_test(true),
         backface_culling(true),
-        texture_filtering_linear(TF_LINEAR) {}
+        texture_filtering_linear(TF_LINEAR),
+        thread_count(1),
+        deferred_shading(false),
+        depth_prepass(false),
+        occlusion_culling(false),
+        optimize_meshes(false),
+        mesh_cache(false),
+        build_meshlets(false),
+        lod_levels(0) {}
 };
 
 #define LURDR_WIREFRAME_MODE(val)     (Singleton<Global>::get().wireframe_mode=val)
 #define LURDR_DEPTH_TEST(val)         (Singleton<Global>::get().depth_test=val)
 #define LURDR_BACKFACE_CULLING(val)   (Singleton<Global>::get().backface_culling=val)
 #define LURDR_TEXTURE_FILTERING(val)  (Singleton<Global>::get().texture_filtering_linear=val)
+#define LURDR_THREAD_COUNT(val)       (Singleton<Global>::get().thread_count=val)
+#define LURDR_DEFERRED_SHADING(val)   (Singleton<Global>::get().deferred_shading=val)
+#define LURDR_DEPTH_PREPASS(val)      (Singleton<Global>::get().depth_prepass=val)
+#define LURDR_OCCLUSION_CULLING(val)  (Singleton<Global>::get().occlusion_culling=val)
+#define LURDR_OPTIMIZE_MESHES(val)    (Singleton<Global>::get().optimize_meshes=val)
+#define LURDR_MESH_CACHE(val)         (Singleton<Global>::get().mesh_cache=val)
+#define LURDR_BUILD_MESHLETS(val)     (Singleton<Global>::get().build_meshlets=val)
+#define LURDR_LOD_LEVELS(val)         (Singleton<Global>::get().lod_levels=val)
 
 typedef unsigned char       byte_t;  // 1 bytes
 typedef unsigned short      UINT16;  // 2 bytes
@@ -48,6 +48,9 @@ void BMPImage::loadImage()
 {
     FILE *fp;
     assert(m_filename != nullptr);
+    // an image that fails to load reads as 0 x 0 instead of garbage
+    memset(&m_file_header, 0, sizeof(BMPFileHeader));
+    memset(&m_info_header, 0, sizeof(BMPInfoHeader));
     fp = fopen(m_filename, "rb");
     if (fp == nullptr)
     {
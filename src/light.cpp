@@ -1,4 +1,5 @@
 #include "light.hpp"
+#include "simd.hpp"
 
 using namespace Lurdr;
 
@@ -51,4 +52,129 @@ LightComp PointLight::getLight(vec3 normal, vec3 frag_pos, vec3 view_dir)
     return comp;
 }
 
+void Light::getLightBatch(
+    const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+    long count, vec3_batch & diffuse, vec3_batch & specular
+) {
+    for (long i = 0; i < count; i++)
+    {
+        LightComp comp = getLight(normal.get(i), frag_pos.get(i), view_dir.get(i));
+        diffuse.x[i] += comp.diffuse.x;
+        diffuse.y[i] += comp.diffuse.y;
+        diffuse.z[i] += comp.diffuse.z;
+        specular.x[i] += comp.specular.x;
+        specular.y[i] += comp.specular.y;
+        specular.z[i] += comp.specular.z;
+    }
+}
+
+// x^32 by repeated squaring, stands in for powf(x, 32.0f) on vectors
+static inline simd_float simdPow32(simd_float a)
+{
+    a = simdMul(a, a);
+    a = simdMul(a, a);
+    a = simdMul(a, a);
+    a = simdMul(a, a);
+    return simdMul(a, a);
+}
+
+static inline void accumulateLightBatch(
+    vec3_batch & diffuse, vec3_batch & specular, long i, const vec3 & light_diffuse,
+    const vec3 & light_specular, simd_float diffuse_factor, simd_float specular_factor, simd_float attenuation
+) {
+    simdStore(diffuse.x + i, simdAdd(simdLoad(diffuse.x + i), simdMul(simdMul(simdSet(light_diffuse.x), diffuse_factor), attenuation)));
+    simdStore(diffuse.y + i, simdAdd(simdLoad(diffuse.y + i), simdMul(simdMul(simdSet(light_diffuse.y), diffuse_factor), attenuation)));
+    simdStore(diffuse.z + i, simdAdd(simdLoad(diffuse.z + i), simdMul(simdMul(simdSet(light_diffuse.z), diffuse_factor), attenuation)));
+    simdStore(specular.x + i, simdAdd(simdLoad(specular.x + i), simdMul(simdMul(simdSet(light_specular.x), specular_factor), attenuation)));
+    simdStore(specular.y + i, simdAdd(simdLoad(specular.y + i), simdMul(simdMul(simdSet(light_specular.y), specular_factor), attenuation)));
+    simdStore(specular.z + i, simdAdd(simdLoad(specular.z + i), simdMul(simdMul(simdSet(light_specular.z), specular_factor), attenuation)));
+}
+
+void DirectionalLight::getLightBatch(
+    const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+    long count, vec3_batch & diffuse, vec3_batch & specular
+) {
+    __unused_variable(frag_pos);
+
+    const simd_float zero = simdSet(0.0f);
+    const simd_float dir_x = simdSet(m_direction.x);
+    const simd_float dir_y = simdSet(m_direction.y);
+    const simd_float dir_z = simdSet(m_direction.z);
+
+    for (long i = 0; i < count; i += SIMD_WIDTH)
+    {
+        simd_float n_x = simdLoad(normal.x + i);
+        simd_float n_y = simdLoad(normal.y + i);
+        simd_float n_z = simdLoad(normal.z + i);
+        simdNormalize(n_x, n_y, n_z);
+
+        const simd_float view_x = simdLoad(view_dir.x + i);
+        const simd_float view_y = simdLoad(view_dir.y + i);
+        const simd_float view_z = simdLoad(view_dir.z + i);
+
+        const simd_float lambertian = simdMax(simdDot(simdSub(zero, dir_x), simdSub(zero, dir_y), simdSub(zero, dir_z), n_x, n_y, n_z), zero);
+#ifdef _BLINN_PHONG_
+        simd_float halfway_x = simdAdd(simdSub(zero, dir_x), view_x);
+        simd_float halfway_y = simdAdd(simdSub(zero, dir_y), view_y);
+        simd_float halfway_z = simdAdd(simdSub(zero, dir_z), view_z);
+        simdNormalize(halfway_x, halfway_y, halfway_z);
+        const simd_float spec = simdPow32(simdMax(simdDot(n_x, n_y, n_z, halfway_x, halfway_y, halfway_z), zero));
+#else
+        const simd_float d = simdMul(simdSet(2.0f), simdDot(dir_x, dir_y, dir_z, n_x, n_y, n_z));
+        simd_float reflect_x = simdSub(dir_x, simdMul(d, n_x));
+        simd_float reflect_y = simdSub(dir_y, simdMul(d, n_y));
+        simd_float reflect_z = simdSub(dir_z, simdMul(d, n_z));
+        simdNormalize(reflect_x, reflect_y, reflect_z);
+        const simd_float spec = simdPow32(simdMax(simdDot(view_x, view_y, view_z, reflect_x, reflect_y, reflect_z), zero));
+#endif
+
+        accumulateLightBatch(diffuse, specular, i, m_diffuse, m_specular, lambertian, spec, simdSet(1.0f));
+    }
+}
+
+void PointLight::getLightBatch(
+    const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+    long count, vec3_batch & diffuse, vec3_batch & specular
+) {
+    const simd_float zero = simdSet(0.0f);
+
+    for (long i = 0; i < count; i += SIMD_WIDTH)
+    {
+        simd_float n_x = simdLoad(normal.x + i);
+        simd_float n_y = simdLoad(normal.y + i);
+        simd_float n_z = simdLoad(normal.z + i);
+        simdNormalize(n_x, n_y, n_z);
+
+        const simd_float view_x = simdLoad(view_dir.x + i);
+        const simd_float view_y = simdLoad(view_dir.y + i);
+        const simd_float view_z = simdLoad(view_dir.z + i);
 
+        simd_float light_dir_x = simdSub(simdSet(m_position.x), simdLoad(frag_pos.x + i));
+        simd_float light_dir_y = simdSub(simdSet(m_position.y), simdLoad(frag_pos.y + i));
+        simd_float light_dir_z = simdSub(simdSet(m_position.z), simdLoad(frag_pos.z + i));
+        const simd_float distance = simdSqrt(simdDot(light_dir_x, light_dir_y, light_dir_z, light_dir_x, light_dir_y, light_dir_z));
+        simdNormalize(light_dir_x, light_dir_y, light_dir_z);
+
+        const simd_float lambertian = simdMax(simdDot(light_dir_x, light_dir_y, light_dir_z, n_x, n_y, n_z), zero);
+#ifdef _BLINN_PHONG_
+        simd_float halfway_x = simdAdd(light_dir_x, view_x);
+        simd_float halfway_y = simdAdd(light_dir_y, view_y);
+        simd_float halfway_z = simdAdd(light_dir_z, view_z);
+        simdNormalize(halfway_x, halfway_y, halfway_z);
+        const simd_float spec = simdPow32(simdMax(simdDot(n_x, n_y, n_z, halfway_x, halfway_y, halfway_z), zero));
+#else
+        const simd_float d = simdMul(simdSet(2.0f), simdDot(simdSub(zero, light_dir_x), simdSub(zero, light_dir_y), simdSub(zero, light_dir_z), n_x, n_y, n_z));
+        const simd_float reflect_x = simdSub(simdSub(zero, light_dir_x), simdMul(d, n_x));
+        const simd_float reflect_y = simdSub(simdSub(zero, light_dir_y), simdMul(d, n_y));
+        const simd_float reflect_z = simdSub(simdSub(zero, light_dir_z), simdMul(d, n_z));
+        const simd_float spec = simdPow32(simdMax(simdDot(view_x, view_y, view_z, reflect_x, reflect_y, reflect_z), zero));
+#endif
+        // attenuation
+        const simd_float attenuation = simdDiv(simdSet(1.0f), simdAdd(
+            simdAdd(simdSet(m_constant), simdMul(simdSet(m_linear), distance)),
+            simdMul(simdMul(simdSet(m_quadratic), distance), distance)
+        ));
+
+        accumulateLightBatch(diffuse, specular, i, m_diffuse, m_specular, lambertian, spec, attenuation);
+    }
+}
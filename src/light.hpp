@@ -41,6 +41,14 @@ public:
         m_specular(specular) {}
 
     virtual LightComp getLight(vec3 normal, vec3 frag_pos, vec3 view_dir) = 0;
+    /**
+     * add the lighting of the first count lanes to diffuse and specular,
+     * the default calls getLight once per lane
+     */
+    virtual void getLightBatch(
+        const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+        long count, vec3_batch & diffuse, vec3_batch & specular
+    );
 
     void setPosition(const vec3 & position) { m_position = position; }
     void setDirection(const vec3 & direction) { m_direction = direction.normalized(); }
@@ -69,6 +77,10 @@ public:
         specular) {}
     
     LightComp getLight(vec3 normal, vec3 frag_pos, vec3 view_dir);
+    void getLightBatch(
+        const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+        long count, vec3_batch & diffuse, vec3_batch & specular
+    );
 };
 
 class PointLight : public Light
@@ -94,6 +106,10 @@ public:
         m_quadratic(0.01f) {}
         
     LightComp getLight(vec3 normal, vec3 frag_pos, vec3 view_dir);
+    void getLightBatch(
+        const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+        long count, vec3_batch & diffuse, vec3_batch & specular
+    );
 };
 
 
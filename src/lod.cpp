@@ -0,0 +1,124 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "lod.hpp"
+
+using namespace Lurdr;
+
+struct LodJob
+{
+    TriangleMesh    *mesh;
+    size_t          level_count;
+    TriangleMesh    *lods[LOD_MAX_LEVELS];
+    size_t          lod_count;
+};
+
+struct Lurdr::LodGeneratorContext
+{
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable changed;
+    DynamicArray<LodJob>    queued;     // jobs from next_job on are waiting
+    size_t                  next_job;
+    DynamicArray<LodJob>    finished;   // built, not attached yet
+    bool                    terminate;
+};
+
+static void lodWorker(LodGeneratorContext * context)
+{
+    std::unique_lock<std::mutex> lock(context->mutex);
+    while (true)
+    {
+        context->changed.wait(lock, [&] {
+            return context->terminate || context->next_job < context->queued.size();
+        });
+        if (context->next_job == context->queued.size())
+        {
+            return;
+        }
+
+        LodJob job = context->queued[context->next_job];
+        lock.unlock();
+        job.lod_count = job.mesh->buildLods(job.lods, job.level_count);
+        lock.lock();
+
+        // the job stays queued until its chain is in finished, so flush() sees it pending
+        context->next_job++;
+        if (context->next_job == context->queued.size())
+        {
+            context->queued.clear();
+            context->next_job = 0;
+        }
+        context->finished.push_back(job);
+        context->changed.notify_all();
+    }
+}
+
+LodGenerator::LodGenerator()
+{
+    m_context = new LodGeneratorContext();
+    m_context->next_job = 0;
+    m_context->terminate = false;
+    m_context->thread = std::thread(lodWorker, m_context);
+}
+
+LodGenerator::~LodGenerator()
+{
+    flush();
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        m_context->terminate = true;
+    }
+    m_context->changed.notify_all();
+    m_context->thread.join();
+    delete m_context;
+}
+
+void LodGenerator::submit(TriangleMesh * mesh, size_t level_count)
+{
+    LodJob job;
+    job.mesh = mesh;
+    job.level_count = level_count;
+    job.lod_count = 0;
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        m_context->queued.push_back(job);
+    }
+    m_context->changed.notify_all();
+}
+
+size_t LodGenerator::poll()
+{
+    DynamicArray<LodJob> finished;
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        for (size_t i = 0; i < m_context->finished.size(); i++)
+        {
+            finished.push_back(m_context->finished[i]);
+        }
+        m_context->finished.clear();
+    }
+
+    for (size_t i = 0; i < finished.size(); i++)
+    {
+        finished[i].mesh->setLods(finished[i].lods, finished[i].lod_count);
+    }
+    return finished.size();
+}
+
+void LodGenerator::flush()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        m_context->changed.wait(lock, [&] {
+            return m_context->next_job == m_context->queued.size();
+        });
+    }
+    poll();
+}
+
+size_t LodGenerator::getPendingCount() const
+{
+    std::unique_lock<std::mutex> lock(m_context->mutex);
+    return m_context->queued.size() - m_context->next_job + m_context->finished.size();
+}
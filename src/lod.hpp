@@ -0,0 +1,44 @@
+#ifndef __LOD_HPP__
+#define __LOD_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "global.hpp"
+#include "mesh.hpp"
+
+namespace Lurdr
+{
+
+struct LodGeneratorContext;
+
+/**
+ * Builds the level of detail chains of meshes on a worker thread. A submitted
+ * mesh is read by the worker and must not change until its chain is attached,
+ * chains are attached by poll() or flush() on the thread drawing the meshes,
+ * so the pipeline never sees a chain being written.
+ */
+class LodGenerator
+{
+private:
+    LodGeneratorContext *m_context;
+
+public:
+    LodGenerator();
+    // finishes and attaches the submitted meshes
+    ~LodGenerator();
+
+    LodGenerator(const LodGenerator &) = delete;
+    LodGenerator& operator= (const LodGenerator &) = delete;
+
+    void submit(TriangleMesh * mesh, size_t level_count = LOD_MAX_LEVELS);
+    // attach the chains finished so far, returns how many
+    size_t poll();
+    // wait for every submitted mesh and attach its chain
+    void flush();
+    size_t getPendingCount() const;
+};
+
+}
+
+#endif
@@ -25,6 +25,37 @@ int main(int argc, char * argv[]) {
             case 4:     
                 return_value = test_colormap();
                 break;
+            case 5:
+                return_value = test_envmap();
+                break;
+            case 6:
+                // viewer 6 [frame count] [output] [entity config] [width] [height]
+                return_value = test_batch(
+                    argc > 2 ? atol(argv[2]) : 120,
+                    argc > 3 ? argv[3] : "frame_%04ld.ppm",
+                    argc > 4 ? argv[4] : "assets/spot.txt",
+                    argc > 5 ? atol(argv[5]) : 512,
+                    argc > 6 ? atol(argv[6]) : 512 );
+                break;
+            case 7:
+                // viewer 7 [frame count] [output csv] [thread count]
+                return_value = test_bench(
+                    argc > 2 ? atol(argv[2]) : 30,
+                    argc > 3 ? argv[3] : "bench.csv",
+                    argc > 4 ? atol(argv[4]) : 1 );
+                break;
+            case 8:
+                // viewer 8 [element count] [repeat]
+                return_value = test_darray(
+                    argc > 2 ? atol(argv[2]) : 1000000,
+                    argc > 3 ? atol(argv[3]) : 5 );
+                break;
+            case 9:
+                return_value = test_mesh();
+                break;
+            case 10:
+                return_value = test_bvh();
+                break;
         }
     }
     return return_value;
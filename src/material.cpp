@@ -96,6 +96,11 @@ vec4 Texture::colorAt(long x, long y) const
 
 vec4 Texture::sampler(const Texture & texture, const vec2 & texcoord)
 {
+    // entity without this texture, e.g. empty albedo line in its config
+    if (texture.m_buffer == nullptr)
+    {
+        return texture.m_base_color;
+    }
     if (Singleton<Global>::get().texture_filtering_linear)
     {
         float xf = (float)texture.m_width * clamp(texcoord.u, 0.0f, 1.0f);
@@ -23,6 +23,9 @@ typedef class Vector4 rgba;
 typedef class Quaternion quat;
 typedef class Matrix3 mat3;
 typedef class Matrix4 mat4;
+typedef struct Vector2Batch vec2_batch;
+typedef struct Vector3Batch vec3_batch;
+typedef struct Vector3Batch rgb_batch;
 
 /**
  * Vector2
@@ -320,48 +323,31 @@ public:
     void rotate(const Quaternion & rotation);
 };
 
+// lane count of vector batches, a multiple of every supported SIMD width
+#define VECTOR_BATCH_SIZE 16
+
 /**
- * Quick Sort Function
- * reference : https://www.geeksforgeeks.org/cpp-program-for-quicksort/
+ * Vector2Batch / Vector3Batch
+ * structure-of-arrays storage of VECTOR_BATCH_SIZE vectors for batched (SIMD) shading
  */
-template<typename T>
-size_t qsortPartition(T* array, long low, long high, bool (*cmp)(const T &, const T &))
+struct Vector2Batch
 {
-    T &pivot = array[high];
-    long i = low;
-    long j = high - 1;
-    while (1)
-    {
-        while (cmp(array[i], pivot) && i < high)
-        {
-            i++;
-        }
-        while (!cmp(array[j], pivot) && j > low)
-        {
-            j--;
-        }
-
-        if (i >= j)
-        {
-            std::swap(array[i], array[high]);
-            return i;
-        }
-
-        std::swap(array[i], array[j]);
-    }
-}
+    alignas(32) float x[VECTOR_BATCH_SIZE];
+    alignas(32) float y[VECTOR_BATCH_SIZE];
+
+    void set(long i, const Vector2 & vec) { x[i] = vec.x; y[i] = vec.y; }
+    Vector2 get(long i) const { return Vector2(x[i], y[i]); }
+};
 
-template<typename T>
-void qsort(T* array, long low, long high, bool (*cmp)(const T &, const T &))
+struct Vector3Batch
 {
-    if (low < high)
-    {
-        long pivot = qsortPartition(array, low, high, cmp);
-        
-        qsort(array, low, pivot - 1, cmp);
-        qsort(array, pivot + 1, high, cmp);
-    }
-}
+    alignas(32) float x[VECTOR_BATCH_SIZE];
+    alignas(32) float y[VECTOR_BATCH_SIZE];
+    alignas(32) float z[VECTOR_BATCH_SIZE];
+
+    void set(long i, const Vector3 & vec) { x[i] = vec.x; y[i] = vec.y; z[i] = vec.z; }
+    Vector3 get(long i) const { return Vector3(x[i], y[i], z[i]); }
+};
 
 }
 
@@ -1,7 +1,59 @@
 #include "mesh.hpp"
+#include "meshcache.hpp"
+#include "objparser.hpp"
 
 using namespace Lurdr;
 
+FRUSTUM_RESULT Lurdr::testFrustum(const BoundingBox & bbox, const mat4 & mvp)
+{
+    // outcodes of the 8 corners in clip space, the view volume of the pipeline is
+    // -w <= x, y <= w and 0 <= z <= w (fragments outside [0, 1] depth are clipped)
+    UINT32 outside_all = 0x3F;
+    UINT32 outside_any = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        const vec4 p = mvp * vec4(
+            (i & 1) ? bbox.max_x : bbox.min_x,
+            (i & 2) ? bbox.max_y : bbox.min_y,
+            (i & 4) ? bbox.max_z : bbox.min_z,
+            1.0f);
+        const UINT32 code = (p.x < -p.w ? 0x01 : 0) | (p.x > p.w ? 0x02 : 0) |
+                            (p.y < -p.w ? 0x04 : 0) | (p.y > p.w ? 0x08 : 0) |
+                            (p.z <  0.0f ? 0x10 : 0) | (p.z > p.w ? 0x20 : 0);
+        outside_all &= code;
+        outside_any |= code;
+    }
+
+    if (outside_all)
+    {
+        return FRUSTUM_OUTSIDE;
+    }
+    return outside_any ? FRUSTUM_INTERSECT : FRUSTUM_INSIDE;
+}
+
+float Lurdr::projectScreenSize(const BoundingBox & bbox, const mat4 & mvp)
+{
+    float x_min = FLT_MAX, y_min = FLT_MAX;
+    float x_max = -FLT_MAX, y_max = -FLT_MAX;
+    for (int i = 0; i < 8; i++)
+    {
+        const vec4 p = mvp * vec4(
+            (i & 1) ? bbox.max_x : bbox.min_x,
+            (i & 2) ? bbox.max_y : bbox.min_y,
+            (i & 4) ? bbox.max_z : bbox.min_z,
+            1.0f);
+        if (p.w <= 0.0f)
+        {
+            return FLT_MAX;
+        }
+        x_min = min(x_min, p.x / p.w);
+        x_max = max(x_max, p.x / p.w);
+        y_min = min(y_min, p.y / p.w);
+        y_max = max(y_max, p.y / p.w);
+    }
+    return max(x_max - x_min, y_max - y_min) * 0.5f;
+}
+
 void OBJMesh::init()
 {
     m_filename = nullptr;
@@ -52,126 +104,53 @@ OBJMesh::~OBJMesh()
 
 void OBJMesh::loadMesh()
 {
-    FILE *fp;
     assert(m_filename != nullptr);
-    fp = fopen(m_filename, "rb");
-    if (fp == nullptr)
+    OBJData data;
+    if (!parseOBJ(m_filename, data))
     {
         printf("OBJMesh : mesh file: %s open failed\n", m_filename);
         return;
     }
 
-    char line_buffer[MAX_OBJ_LINE];
-    DynamicArray<Vector3> vertices;
-    DynamicArray<Vector2> texture_coords;
-    DynamicArray<Vector3> vertex_normals;
-    DynamicArray<size_t> vertex_idxes;
-    DynamicArray<size_t> texture_idxes;
-    DynamicArray<size_t> normal_idxes;
-
-    float x, y, z;
-    size_t v1, v2, v3, vt1, vt2, vt3, vn1, vn2, vn3;
-    long scanned_items;
-    while (fgets(line_buffer, MAX_OBJ_LINE, fp))
-    {
-        if (strncmp(line_buffer, "v ", 2) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "v %f %f %f", &x, &y, &z);
-            assert(scanned_items == 3);
-            vertices.push_back(Vector3(x, y, z));
-        }
-        else if (strncmp(line_buffer, "vt ", 3) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "vt %f %f", &x, &y);
-            assert(scanned_items == 2);
-            texture_coords.push_back(Vector2(x, y));
-        }
-        else if (strncmp(line_buffer, "vn ", 3) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "vn %f %f %f", &x, &y, &z);
-            assert(scanned_items == 3);
-            vertex_normals.push_back(Vector3(x, y, z));
-        }
-        else if (strncmp(line_buffer, "f ", 2) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "f %lu/%lu/%lu %lu/%lu/%lu %lu/%lu/%lu", &v1, &vt1, &vn1, &v2, &vt2, &vn2, &v3, &vt3, &vn3);
-            if (scanned_items != 9)
-            {
-                scanned_items = sscanf(line_buffer, "f %lu %lu %lu", &v1, &v2, &v3);
-                if (scanned_items != 3)
-                {
-                    scanned_items = sscanf(line_buffer, "f %lu//%lu %lu//%lu %lu//%lu", &v1, &vn1, &v2, &vn2, &v3, &vn3);
-                    assert(scanned_items == 6);
-                    vertex_idxes.push_back(v1);
-                    vertex_idxes.push_back(v2);
-                    vertex_idxes.push_back(v3);
-                    normal_idxes.push_back(vn1);
-                    normal_idxes.push_back(vn2);
-                    normal_idxes.push_back(vn3);
-                }
-                else
-                {
-                    vertex_idxes.push_back(v1);
-                    vertex_idxes.push_back(v2);
-                    vertex_idxes.push_back(v3);
-                }
-            }
-            else
-            {
-                vertex_idxes.push_back(v1);
-                vertex_idxes.push_back(v2);
-                vertex_idxes.push_back(v3);
-                texture_idxes.push_back(vt1);
-                texture_idxes.push_back(vt2);
-                texture_idxes.push_back(vt3);
-                normal_idxes.push_back(vn1);
-                normal_idxes.push_back(vn2);
-                normal_idxes.push_back(vn3);
-            }
-        }
-    }
-
-    if (vertices.size() > 0)
+    // OBJMesh keeps the 1 based indices of the file
+    m_vertex_count = data.vertex_count;
+    m_vs = data.vertices;
+    if (data.face_count > 0)
     {
-        m_vertex_count = vertices.size();
-        m_vs = new Vector3[vertices.size()];
-        for (size_t i = 0; i < vertices.size(); i++)
+        m_face_count = data.face_count;
+        m_fs = new size_t[data.face_count * 3];
+        for (size_t i = 0; i < data.face_count * 3; i++)
         {
-            m_vs[i] = vertices[i];
+            m_fs[i] = data.faces[i / 3][i % 3] + 1;
         }
     }
-    if (vertex_idxes.size() > 0 && vertex_idxes.size() % 3 == 0)
+    if (data.face_texcoords)
     {
-        m_face_count = vertex_idxes.size() / 3;
-        m_fs = new size_t[vertex_idxes.size()];
-        for (size_t i = 0; i < vertex_idxes.size(); i++)
+        m_tex_coords = data.texture_coords;
+        data.texture_coords = nullptr;
+        m_fvts = new size_t[data.face_count * 3];
+        for (size_t i = 0; i < data.face_count * 3; i++)
         {
-            m_fs[i] = vertex_idxes[i];
+            m_fvts[i] = data.face_texcoords[i / 3][i % 3] + 1;
         }
-    }
-    if (texture_idxes.size() > 0 && texture_idxes.size() % 3 == 0)
-    {
-        // ...
         m_has_tex_coords = true;
     }
-    if (normal_idxes.size() > 0 && normal_idxes.size() % 3 == 0)
+    if (data.face_normals)
     {
-        // assert(vertex_normals.size() == m_vertex_count);
-        m_vns = new Vector3[vertex_normals.size()];
-        for (size_t i = 0; i < vertex_normals.size(); i++)
-        {
-            m_vns[i] = vertex_normals[i];
-        }
-
-        assert(normal_idxes.size() / 3 == m_face_count);
-        m_fvns = new size_t[normal_idxes.size()];
-        for (size_t i = 0; i < normal_idxes.size(); i++)
+        m_vns = data.vertex_normals;
+        data.vertex_normals = nullptr;
+        m_fvns = new size_t[data.face_count * 3];
+        for (size_t i = 0; i < data.face_count * 3; i++)
         {
-            m_fvns[i] = normal_idxes[i];
+            m_fvns[i] = data.face_normals[i / 3][i % 3] + 1;
         }
         m_has_vertex_normals = true;
     }
-    fclose(fp);
+    delete[] data.texture_coords;
+    delete[] data.vertex_normals;
+    delete[] data.faces;
+    delete[] data.face_texcoords;
+    delete[] data.face_normals;
 }
 
 void OBJMesh::printMeshInfo() const
@@ -333,9 +312,26 @@ TriangleMesh::TriangleMesh():
     m_faces(nullptr),
     m_face_texcoords(nullptr),
     m_face_normals(nullptr),
+    m_welded_vertices(nullptr),
+    m_indices(nullptr),
+    m_meshlets(nullptr),
+    m_meshlet_vertices(nullptr),
+    m_meshlet_faces(nullptr),
+    m_meshlet_triangles(nullptr),
+    m_lods(),
     m_mesh_center(vec3::ZERO),
+    m_bounding_box(BoundingBox()),
+    m_mapping(nullptr),
+    m_mapping_borrowed(false),
     m_vertex_count(0),
     m_face_count(0),
+    m_normal_count(0),
+    m_texcoord_count(0),
+    m_unique_vertex_count(0),
+    m_meshlet_count(0),
+    m_meshlet_vertex_count(0),
+    m_lod_count(0),
+    m_acmr_before(0.0f),
     m_has_vertex_normals(false),
     m_has_triangle_normals(false),
     m_has_texture_coords(false) {}
@@ -343,242 +339,87 @@ TriangleMesh::TriangleMesh():
 TriangleMesh::TriangleMesh(const char * filename):
     TriangleMesh()
 {
-    FILE *fp;
     assert(filename != nullptr);
-    fp = fopen(filename, "rb");
-    if (fp == nullptr)
+    const bool mesh_cache = Singleton<Global>::get().mesh_cache;
+    const UINT64 source_hash = mesh_cache ? hashFileContents(filename) : 0;
+    if (mesh_cache && source_hash != 0 && loadCache(filename, source_hash))
     {
-        printf("TriangleMesh : mesh file: %s open failed\n", filename);
         return;
     }
 
-    char line_buffer[MAX_OBJ_LINE];
-    DynamicArray<vec3>  vertices;
-    DynamicArray<vec3>  vertex_normals;
-    DynamicArray<vec3i> faces;
-    DynamicArray<vec3i> face_texcoords;
-    DynamicArray<vec3i> face_normals;
-    DynamicArray<vec2>  texture_coords;
-
-    float x, y, z;
-    size_t v1, v2, v3, vt1, vt2, vt3, vn1, vn2, vn3;
-    long scanned_items;
-    while (fgets(line_buffer, MAX_OBJ_LINE, fp))
+    OBJData data;
+    if (!parseOBJ(filename, data))
     {
-        if (strncmp(line_buffer, "v ", 2) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "v %f %f %f", &x, &y, &z);
-            assert(scanned_items == 3);
-            vertices.push_back(vec3(x, y, z));
-        }
-        else if (strncmp(line_buffer, "vt ", 3) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "vt %f %f", &x, &y);
-            assert(scanned_items == 2);
-            texture_coords.push_back(vec2(x, y));
-        }
-        else if (strncmp(line_buffer, "vn ", 3) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "vn %f %f %f", &x, &y, &z);
-            assert(scanned_items == 3);
-            vertex_normals.push_back(vec3(x, y, z));
-        }
-        else if (strncmp(line_buffer, "f ", 2) == 0)
-        {
-            scanned_items = sscanf(line_buffer, "f %lu/%lu/%lu %lu/%lu/%lu %lu/%lu/%lu", &v1, &vt1, &vn1, &v2, &vt2, &vn2, &v3, &vt3, &vn3);
-            if (scanned_items != 9)
-            {
-                scanned_items = sscanf(line_buffer, "f %lu %lu %lu", &v1, &v2, &v3);
-                if (scanned_items != 3)
-                {
-                    scanned_items = sscanf(line_buffer, "f %lu//%lu %lu//%lu %lu//%lu", &v1, &vn1, &v2, &vn2, &v3, &vn3);
-                    if (scanned_items != 6)
-                    {
-                        scanned_items = sscanf(line_buffer, "f %lu/%lu %lu/%lu %lu/%lu", &v1, &vt1, &v2, &vt2, &v3, &vt3);
-                        vec3i ft;
-                        ft[0] = vt1 - 1;
-                        ft[1] = vt2 - 1;
-                        ft[2] = vt3 - 1;
-                        face_texcoords.push_back(ft);
-                    }
-                    else
-                    {
-                        vec3i fn;
-                        fn[0] = vn1 - 1;
-                        fn[1] = vn2 - 1;
-                        fn[2] = vn3 - 1;
-                        face_normals.push_back(fn);
-                    }
-                    vec3i f;
-                    f[0] = v1 - 1;
-                    f[1] = v2 - 1;
-                    f[2] = v3 - 1;
-                    faces.push_back(f);
-                }
-                else
-                {
-                    vec3i f;
-                    f[0] = v1 - 1;
-                    f[1] = v2 - 1;
-                    f[2] = v3 - 1;
-                    faces.push_back(f);
-                }
-            }
-            else
-            {
-                vec3i f;
-                f[0] = v1 - 1;
-                f[1] = v2 - 1;
-                f[2] = v3 - 1;
-                faces.push_back(f);
-                vec3i ft;
-                ft[0] = vt1 - 1;
-                ft[1] = vt2 - 1;
-                ft[2] = vt3 - 1;
-                face_texcoords.push_back(ft);
-                vec3i fn;
-                fn[0] = vn1 - 1;
-                fn[1] = vn2 - 1;
-                fn[2] = vn3 - 1;
-                face_normals.push_back(fn);
-            }
-        }
+        printf("TriangleMesh : mesh file: %s open failed\n", filename);
+        return;
     }
 
-    if (vertices.size() > 0)
+    m_vertex_count = data.vertex_count;
+    m_face_count = data.face_count;
+    m_vertices = data.vertices;
+    m_faces = data.faces;
+    m_face_texcoords = data.face_texcoords;
+    m_face_normals = data.face_normals;
+    if (data.texcoord_count > 0)
     {
-        m_vertex_count = vertices.size();
-        m_vertices = new vec3[vertices.size()];
-        for (size_t i = 0; i < vertices.size(); i++)
-        {
-            m_vertices[i] = vertices[i];
-        }
-    }
-    if (faces.size() > 0)
-    {
-        m_face_count = faces.size();
-        m_faces = new vec3i[faces.size()];
-        for (size_t i = 0; i < faces.size(); i++)
-        {
-            m_faces[i] = faces[i];
-        }
-    }
-    if (face_texcoords.size() > 0)
-    {
-        assert(face_texcoords.size() == m_face_count);
-        m_face_texcoords = new vec3i[face_texcoords.size()];
-        for (size_t i = 0; i < face_texcoords.size(); i++)
-        {
-            m_face_texcoords[i] = face_texcoords[i];
-        }
-    }
-    if (face_normals.size() > 0)
-    {
-        assert(face_normals.size() == m_face_count);
-        m_face_normals = new vec3i[face_normals.size()];
-        for (size_t i = 0; i < face_normals.size(); i++)
-        {
-            m_face_normals[i] = face_normals[i];
-        }
-    }
-    if (texture_coords.size() > 0)
-    {
-        // assert(texture_coords.size() == m_vertex_count);
-        m_texture_coords = new vec2[texture_coords.size()];
-        for (size_t i = 0; i < texture_coords.size(); i++)
-        {
-            m_texture_coords[i] = texture_coords[i];
-        }
+        m_texcoord_count = data.texcoord_count;
+        m_texture_coords = data.texture_coords;
         m_has_texture_coords = true;
     }
-    if (vertex_normals.size() > 0)
+    if (data.normal_count > 0)
     {
-        // assert(vertex_normals.size() == m_vertex_count);
-        m_vertex_normals = new vec3[vertex_normals.size()];
-        for (size_t i = 0; i < vertex_normals.size(); i++)
-        {
-            m_vertex_normals[i] = vertex_normals[i];
-        }
+        m_normal_count = data.normal_count;
+        m_vertex_normals = data.vertex_normals;
         m_has_vertex_normals = true;
     }
-    fclose(fp);
     computeMeshCenter();
-}
-
-TriangleMesh::TriangleMesh(const TriangleMesh & tri_mesh):
-    TriangleMesh()
-{
-    m_vertex_count = tri_mesh.m_vertex_count;
-    m_face_count = tri_mesh.m_face_count;
-    m_has_vertex_normals = tri_mesh.m_has_vertex_normals;
-    m_has_triangle_normals = tri_mesh.m_has_triangle_normals;
-    m_has_texture_coords = tri_mesh.m_has_texture_coords;
-
-    if (m_vertex_count > 0)
+    computeBoundingBox();
+    weldVertices();
+    if (Singleton<Global>::get().optimize_meshes)
     {
-        m_vertices = new vec3[m_vertex_count];
-        for (size_t i = 0; i < m_vertex_count; i++)
-        {
-            m_vertices[i] = tri_mesh.m_vertices[i];
-        }
+        optimizeVertexCache();
     }
-    if (m_face_count > 0)
+    const bool write_cache = mesh_cache && source_hash != 0 && m_face_count > 0;
+    if (write_cache)
     {
-        m_faces = new vec3i[m_face_count];
-        for (size_t i = 0; i < m_face_count; i++)
-        {
-            m_faces[i] = tri_mesh.m_faces[i];
-        }
+        // stored with the mesh, the levels take theirs from it
+        computeTriangleNormals();
     }
-    if (m_has_vertex_normals)
+    if (Singleton<Global>::get().build_meshlets)
     {
-        m_vertex_normals = new vec3[m_vertex_count];
-        for (size_t i = 0; i < m_vertex_count; i++)
-        {
-            m_vertex_normals[i] = tri_mesh.m_vertex_normals[i];
-        }
-
-        m_face_normals = new vec3i[m_face_count];
-        for (size_t i = 0; i < m_face_count; i++)
-        {
-            m_face_normals[i] = tri_mesh.m_face_normals[i];
-        }
+        buildMeshlets();
     }
-    if (m_has_triangle_normals)
+    if (Singleton<Global>::get().lod_levels > 0)
     {
-        m_triangle_normals = new vec3[m_face_count];
-        for (size_t i = 0; i < m_face_count; i++)
-        {
-            m_triangle_normals[i] = tri_mesh.m_triangle_normals[i];
-        }
+        generateLods(Singleton<Global>::get().lod_levels);
     }
-    if (m_has_texture_coords)
+    if (write_cache && !writeCache(filename, source_hash))
     {
-        m_texture_coords = new vec2[m_vertex_count];
-        for (size_t i = 0; i < m_vertex_count; i++)
-        {
-            m_texture_coords[i] = tri_mesh.m_texture_coords[i];
-        }
-
-        m_face_texcoords = new vec3i[m_face_count];
-        for (size_t i = 0; i < m_face_count; i++)
-        {
-            m_face_texcoords[i] = tri_mesh.m_face_texcoords[i];
-        }
+        printf("TriangleMesh : mesh cache for %s write failed\n", filename);
     }
-    computeMeshCenter();
+}
+
+TriangleMesh::TriangleMesh(const TriangleMesh & tri_mesh):
+    TriangleMesh()
+{
+    copyFrom(tri_mesh);
 }
 
 TriangleMesh & TriangleMesh::operator= (const TriangleMesh & tri_mesh)
 {
-    if (m_vertices)         delete[] m_vertices;
-    if (m_vertex_normals)   delete[] m_vertex_normals;
-    if (m_triangle_normals) delete[] m_triangle_normals;
-    if (m_faces)            delete[] m_faces;
-    if (m_texture_coords)   delete[] m_texture_coords;
+    if (this == &tri_mesh) return *this;
+    clearArrays();
+    copyFrom(tri_mesh);
+    return *this;
+}
 
+// deep copy of the arrays, meshlets and levels of tri_mesh into a mesh without any
+void TriangleMesh::copyFrom(const TriangleMesh & tri_mesh)
+{
     m_vertex_count = tri_mesh.m_vertex_count;
     m_face_count = tri_mesh.m_face_count;
+    m_normal_count = tri_mesh.m_normal_count;
+    m_texcoord_count = tri_mesh.m_texcoord_count;
     m_has_vertex_normals = tri_mesh.m_has_vertex_normals;
     m_has_triangle_normals = tri_mesh.m_has_triangle_normals;
     m_has_texture_coords = tri_mesh.m_has_texture_coords;
@@ -601,8 +442,8 @@ TriangleMesh & TriangleMesh::operator= (const TriangleMesh & tri_mesh)
     }
     if (m_has_vertex_normals)
     {
-        m_vertex_normals = new vec3[m_vertex_count];
-        for (size_t i = 0; i < m_vertex_count; i++)
+        m_vertex_normals = new vec3[m_normal_count];
+        for (size_t i = 0; i < m_normal_count; i++)
         {
             m_vertex_normals[i] = tri_mesh.m_vertex_normals[i];
         }
@@ -623,8 +464,8 @@ TriangleMesh & TriangleMesh::operator= (const TriangleMesh & tri_mesh)
     }
     if (m_has_texture_coords)
     {
-        m_texture_coords = new vec2[m_vertex_count];
-        for (size_t i = 0; i < m_vertex_count; i++)
+        m_texture_coords = new vec2[m_texcoord_count];
+        for (size_t i = 0; i < m_texcoord_count; i++)
         {
             m_texture_coords[i] = tri_mesh.m_texture_coords[i];
         }
@@ -636,12 +477,31 @@ TriangleMesh & TriangleMesh::operator= (const TriangleMesh & tri_mesh)
         }
     }
     computeMeshCenter();
-
-    return *this;
+    computeBoundingBox();
+    weldVertices();
+    if (tri_mesh.hasMeshlets())
+    {
+        buildMeshlets();
+    }
+    m_acmr_before = tri_mesh.m_acmr_before;
+    m_lod_count = tri_mesh.m_lod_count;
+    for (size_t i = 0; i < m_lod_count; i++)
+    {
+        m_lods[i] = new TriangleMesh(*tri_mesh.m_lods[i]);
+    }
 }
 
 TriangleMesh::~TriangleMesh()
 {
+    clearArrays();
+}
+
+// free every array and level, the pointers are left null for what is rebuilt next
+void TriangleMesh::clearArrays()
+{
+    // levels first, they may point into the mapping
+    clearLods();
+    releaseMapping();
     if (m_vertices)         delete[] m_vertices;
     if (m_vertex_normals)   delete[] m_vertex_normals;
     if (m_triangle_normals) delete[] m_triangle_normals;
@@ -649,6 +509,19 @@ TriangleMesh::~TriangleMesh()
     if (m_face_texcoords)   delete[] m_face_texcoords;
     if (m_face_normals)     delete[] m_face_normals;
     if (m_texture_coords)   delete[] m_texture_coords;
+    if (m_welded_vertices)  delete[] m_welded_vertices;
+    if (m_indices)          delete[] m_indices;
+    m_vertices = nullptr;
+    m_vertex_normals = nullptr;
+    m_triangle_normals = nullptr;
+    m_faces = nullptr;
+    m_face_texcoords = nullptr;
+    m_face_normals = nullptr;
+    m_texture_coords = nullptr;
+    m_welded_vertices = nullptr;
+    m_indices = nullptr;
+    m_unique_vertex_count = 0;
+    clearMeshlets();
 }
 
 void TriangleMesh::printMeshInfo() const
@@ -658,6 +531,14 @@ void TriangleMesh::printMeshInfo() const
         printf("-- TriangleMesh info -------------------------\n");
         printf("    vertex count : %-6lu\n", m_vertex_count);
         printf("      face count : %-6lu\n", m_face_count);
+        printf(" unique vertices : %-6lu\n", m_unique_vertex_count);
+        if (m_meshlets)
+            printf("        meshlets : %-6lu\n", m_meshlet_count);
+        if (m_acmr_before > 0.0f)
+            printf("     acmr before : %.3f\n", m_acmr_before);
+        printf("            acmr : %.3f\n", computeACMR());
+        for (size_t i = 0; i < m_lod_count; i++)
+            printf("     lod %lu faces : %-6lu\n", i + 1, m_lods[i]->m_face_count);
         if (m_has_vertex_normals)
             printf("  vertex normals : True\n");
         else
@@ -682,6 +563,7 @@ void TriangleMesh::printMeshInfo() const
 void TriangleMesh::computeVertexNormals()
 {
     if (m_has_vertex_normals) return;
+    detachMapping();
     
     if (!m_has_triangle_normals)
     {
@@ -702,6 +584,7 @@ void TriangleMesh::computeVertexNormals()
     }
 
     DynamicArray<vec3> vertex_normals;
+    vertex_normals.reserve(m_vertex_count);
     for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
     {
         vec3 n;
@@ -712,13 +595,11 @@ void TriangleMesh::computeVertexNormals()
         vertex_normals.push_back(n.normalized());
     }
 
-    m_vertex_normals = new vec3[vertex_normals.size()];
-    for (size_t i = 0; i < vertex_normals.size(); i++)
-    {
-        m_vertex_normals[i] = vertex_normals[i];
-    }
+    m_normal_count = vertex_normals.size();
+    m_vertex_normals = vertex_normals.release();
 
     m_has_vertex_normals = true;
+    weldVertices();
 }
 
 void TriangleMesh::computeTriangleNormals()
@@ -726,7 +607,7 @@ void TriangleMesh::computeTriangleNormals()
     if (m_has_triangle_normals) return;
 
     DynamicArray<vec3> triangle_normals;
-
+    triangle_normals.reserve(m_face_count);
     for (size_t fidx = 0; fidx < m_face_count; fidx++)
     {
         vec3 u = m_vertices[m_faces[fidx][1]] - m_vertices[m_faces[fidx][0]];
@@ -735,71 +616,1105 @@ void TriangleMesh::computeTriangleNormals()
         triangle_normals.push_back(u.cross(v).normalized());
     }
 
-    m_triangle_normals = new vec3[triangle_normals.size()];
-    for (size_t i = 0; i < triangle_normals.size(); i++)
-    {
-        m_triangle_normals[i] = triangle_normals[i];
-    }
+    m_triangle_normals = triangle_normals.release();
 
     m_has_triangle_normals = true;
 }
 
-void TriangleMesh::computeMeshCenter()
+/**
+ * Collect every unique (position, normal, texcoord) index tuple referenced by the faces
+ * into one interleaved vertex with a single index per corner, so that the pipeline runs
+ * the vertex shader once per tuple and fetches a corner with one lookup.
+ */
+void TriangleMesh::weldVertices()
 {
-    vec3 center = vec3::ZERO;
+    detachMapping();
+    if (m_welded_vertices) delete[] m_welded_vertices;
+    if (m_indices)         delete[] m_indices;
+    m_welded_vertices = nullptr;
+    m_indices = nullptr;
+    m_unique_vertex_count = 0;
 
-    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    if (m_face_count == 0) return;
+
+    const bool has_normals = m_has_vertex_normals && m_face_normals;
+    const bool has_texcoords = m_has_texture_coords && m_face_texcoords;
+
+    // open addressing hash table over the tuples, at most half full
+    size_t table_size = 1;
+    while (table_size < m_face_count * 3 * 2) table_size <<= 1;
+    long *table = new long[table_size];
+    memset(table, -1, table_size * sizeof(long));
+
+    assert(m_face_count * 3 <= 0xFFFFFFFFu);
+    vec3i *tuples = new vec3i[m_face_count * 3];
+    m_indices = new UINT32[m_face_count * 3];
+
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
     {
-        center += m_vertices[vidx];
+        for (size_t vidx = 0; vidx < 3; vidx++)
+        {
+            vec3i tuple;
+            tuple[0] = m_faces[fidx][vidx];
+            tuple[1] = has_normals ? m_face_normals[fidx][vidx] : -1;
+            tuple[2] = has_texcoords ? m_face_texcoords[fidx][vidx] : -1;
+
+            size_t hash = (size_t)tuple[0] * 73856093u ^ (size_t)tuple[1] * 19349663u ^ (size_t)tuple[2] * 83492791u;
+            size_t slot = hash & (table_size - 1);
+            while (true)
+            {
+                const long index = table[slot];
+                if (index < 0)
+                {
+                    table[slot] = m_unique_vertex_count;
+                    tuples[m_unique_vertex_count] = tuple;
+                    m_indices[fidx * 3 + vidx] = m_unique_vertex_count++;
+                    break;
+                }
+                const vec3i & other = tuples[index];
+                if (other[0] == tuple[0] && other[1] == tuple[1] && other[2] == tuple[2])
+                {
+                    m_indices[fidx * 3 + vidx] = index;
+                    break;
+                }
+                slot = (slot + 1) & (table_size - 1);
+            }
+        }
     }
 
-    m_mesh_center = center * (1.0f / m_vertex_count);
+    delete[] table;
+
+    m_welded_vertices = new MeshVertex[m_unique_vertex_count];
+    for (size_t vidx = 0; vidx < m_unique_vertex_count; vidx++)
+    {
+        const vec3i & tuple = tuples[vidx];
+        m_welded_vertices[vidx].position = m_vertices[tuple[0]];
+        m_welded_vertices[vidx].normal   = tuple[1] >= 0 ? m_vertex_normals[tuple[1]] : vec3::ZERO;
+        m_welded_vertices[vidx].texcoord = tuple[2] >= 0 ? m_texture_coords[tuple[2]] : vec2::ZERO;
+    }
+    delete[] tuples;
+
+    // meshlets index the welded vertices
+    if (m_meshlets)
+    {
+        buildMeshlets();
+    }
 }
 
-BoundingBox TriangleMesh::getAxisAlignBoundingBox() const
+/**
+ * fraction of misses per face of a FIFO post transform cache over the unique
+ * vertices, 3 for no reuse at all and about 0.5 at best for large meshes
+ */
+float TriangleMesh::computeACMR(size_t cache_size) const
 {
-    BoundingBox bounding_box(
-         FLOAT_INF,  FLOAT_INF,  FLOAT_INF,
-        -FLOAT_INF, -FLOAT_INF, -FLOAT_INF
-    );
+    if (m_face_count == 0) return 0.0f;
 
-    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    // a vertex is in the cache while fewer than cache_size misses followed its own
+    size_t *cache_time = new size_t[m_unique_vertex_count];
+    memset(cache_time, 0, m_unique_vertex_count * sizeof(size_t));
+    size_t time = cache_size + 1;
+    size_t misses = 0;
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
     {
-        bounding_box.min_x = min(m_vertices[vidx].x, bounding_box.min_x);
-        bounding_box.min_y = min(m_vertices[vidx].y, bounding_box.min_y);
-        bounding_box.min_z = min(m_vertices[vidx].z, bounding_box.min_z);
-        bounding_box.max_x = max(m_vertices[vidx].x, bounding_box.max_x);
-        bounding_box.max_y = max(m_vertices[vidx].y, bounding_box.max_y);
-        bounding_box.max_z = max(m_vertices[vidx].z, bounding_box.max_z);
+        for (size_t i = 0; i < 3; i++)
+        {
+            const UINT32 vidx = m_indices[fidx * 3 + i];
+            if (time - cache_time[vidx] > cache_size)
+            {
+                cache_time[vidx] = time++;
+                misses++;
+            }
+        }
     }
-    
-    return bounding_box;
+    delete[] cache_time;
+    return (float)misses / m_face_count;
 }
 
-vec3 TriangleMesh::getMaxBound() const
+/**
+ * copy of attributes with the elements in first use order of indices, indices are
+ * rewritten and -1 entries kept. Unreferenced elements go last.
+ */
+template<typename T>
+static T * renumberFirstUse(const T * attributes, size_t count, vec3i * indices, size_t face_count)
 {
-    vec3 max_bound(-FLOAT_INF, -FLOAT_INF, -FLOAT_INF);
-
-    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    long *remap = new long[count];
+    memset(remap, -1, count * sizeof(long));
+    long next = 0;
+    for (size_t fidx = 0; fidx < face_count; fidx++)
     {
-        max_bound.x = max(m_vertices[vidx].x, max_bound.x);
-        max_bound.y = max(m_vertices[vidx].y, max_bound.y);
-        max_bound.z = max(m_vertices[vidx].z, max_bound.z);
+        for (size_t i = 0; i < 3; i++)
+        {
+            long & index = indices[fidx][i];
+            if (index < 0) continue;
+            if (remap[index] < 0)
+            {
+                remap[index] = next++;
+            }
+            index = remap[index];
+        }
     }
 
-    return max_bound;
+    T *renumbered = new T[count];
+    for (size_t i = 0; i < count; i++)
+    {
+        if (remap[i] < 0)
+        {
+            remap[i] = next++;
+        }
+        renumbered[remap[i]] = attributes[i];
+    }
+    delete[] remap;
+    return renumbered;
 }
 
-vec3 TriangleMesh::getMinBound() const
+/**
+ * Tipsify (Sander et al. 2007): fan out around a vertex, emitting its remaining faces,
+ * then continue with the neighbour that is still cached and has faces left, falling
+ * back to recently used vertices and then input order at dead ends. Attributes are
+ * renumbered afterwards so the unique vertices are also fetched in order.
+ */
+void TriangleMesh::optimizeVertexCache()
 {
-    vec3 min_bound(FLOAT_INF, FLOAT_INF, FLOAT_INF);
-
-    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    if (m_face_count == 0) return;
+    detachMapping();
+
+    const float acmr = computeACMR();
+    const size_t vertex_count = m_unique_vertex_count;
+    const size_t cache_size = VERTEX_CACHE_SIZE;
+
+    // faces around every unique vertex, live counts the ones not emitted yet
+    UINT32 *adjacency_offsets = new UINT32[vertex_count + 1];
+    UINT32 *adjacent_faces = new UINT32[m_face_count * 3];
+    UINT32 *live = new UINT32[vertex_count];
+    memset(adjacency_offsets, 0, (vertex_count + 1) * sizeof(UINT32));
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            adjacency_offsets[m_indices[fidx * 3 + i] + 1]++;
+        }
+    }
+    for (size_t vidx = 0; vidx < vertex_count; vidx++)
+    {
+        adjacency_offsets[vidx + 1] += adjacency_offsets[vidx];
+        live[vidx] = adjacency_offsets[vidx];
+    }
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            adjacent_faces[live[m_indices[fidx * 3 + i]]++] = fidx;
+        }
+    }
+    for (size_t vidx = 0; vidx < vertex_count; vidx++)
     {
-        min_bound.x = max(m_vertices[vidx].x, min_bound.x);
-        min_bound.y = max(m_vertices[vidx].y, min_bound.y);
-        min_bound.z = max(m_vertices[vidx].z, min_bound.z);
+        live[vidx] = adjacency_offsets[vidx + 1] - adjacency_offsets[vidx];
     }
 
-    return min_bound;
+    size_t *cache_time = new size_t[vertex_count];
+    memset(cache_time, 0, vertex_count * sizeof(size_t));
+    bool *emitted = new bool[m_face_count];
+    memset(emitted, 0, m_face_count * sizeof(bool));
+    UINT32 *order = new UINT32[m_face_count];
+    // vertices of the emitted faces, the ones of the last fan are the candidates
+    UINT32 *dead_end = new UINT32[m_face_count * 3];
+    size_t dead_end_count = 0;
+
+    size_t time = cache_size + 1;
+    size_t order_count = 0;
+    size_t cursor = 0;
+    long fan = 0;
+    while (fan >= 0)
+    {
+        const size_t candidates = dead_end_count;
+        for (UINT32 a = adjacency_offsets[fan]; a < adjacency_offsets[fan + 1]; a++)
+        {
+            const UINT32 fidx = adjacent_faces[a];
+            if (emitted[fidx]) continue;
+            for (size_t i = 0; i < 3; i++)
+            {
+                const UINT32 vidx = m_indices[fidx * 3 + i];
+                dead_end[dead_end_count++] = vidx;
+                live[vidx]--;
+                if (time - cache_time[vidx] > cache_size)
+                {
+                    cache_time[vidx] = time++;
+                }
+            }
+            emitted[fidx] = true;
+            order[order_count++] = fidx;
+        }
+
+        // the candidate that stays cached longest while its faces are emitted
+        fan = -1;
+        long best_priority = -1;
+        for (size_t c = candidates; c < dead_end_count; c++)
+        {
+            const UINT32 vidx = dead_end[c];
+            if (live[vidx] == 0) continue;
+            long priority = 0;
+            if (time - cache_time[vidx] + 2 * live[vidx] <= cache_size)
+            {
+                priority = time - cache_time[vidx];
+            }
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                fan = vidx;
+            }
+        }
+        while (fan < 0 && dead_end_count > 0)
+        {
+            const UINT32 vidx = dead_end[--dead_end_count];
+            if (live[vidx] > 0) fan = vidx;
+        }
+        while (fan < 0 && cursor < vertex_count)
+        {
+            if (live[cursor] > 0) fan = cursor;
+            cursor++;
+        }
+    }
+    assert(order_count == m_face_count);
+
+    vec3i *faces = new vec3i[m_face_count];
+    for (size_t fidx = 0; fidx < m_face_count; fidx++) faces[fidx] = m_faces[order[fidx]];
+    delete[] m_faces;
+    m_faces = faces;
+    if (m_face_normals)
+    {
+        vec3i *face_normals = new vec3i[m_face_count];
+        for (size_t fidx = 0; fidx < m_face_count; fidx++) face_normals[fidx] = m_face_normals[order[fidx]];
+        delete[] m_face_normals;
+        m_face_normals = face_normals;
+    }
+    if (m_face_texcoords)
+    {
+        vec3i *face_texcoords = new vec3i[m_face_count];
+        for (size_t fidx = 0; fidx < m_face_count; fidx++) face_texcoords[fidx] = m_face_texcoords[order[fidx]];
+        delete[] m_face_texcoords;
+        m_face_texcoords = face_texcoords;
+    }
+    if (m_has_triangle_normals)
+    {
+        vec3 *triangle_normals = new vec3[m_face_count];
+        for (size_t fidx = 0; fidx < m_face_count; fidx++) triangle_normals[fidx] = m_triangle_normals[order[fidx]];
+        delete[] m_triangle_normals;
+        m_triangle_normals = triangle_normals;
+    }
+
+    delete[] adjacency_offsets;
+    delete[] adjacent_faces;
+    delete[] live;
+    delete[] cache_time;
+    delete[] emitted;
+    delete[] order;
+    delete[] dead_end;
+
+    vec3 *vertices = renumberFirstUse(m_vertices, m_vertex_count, m_faces, m_face_count);
+    delete[] m_vertices;
+    m_vertices = vertices;
+    if (m_has_vertex_normals && m_face_normals)
+    {
+        vec3 *vertex_normals = renumberFirstUse(m_vertex_normals, m_normal_count, m_face_normals, m_face_count);
+        delete[] m_vertex_normals;
+        m_vertex_normals = vertex_normals;
+    }
+    if (m_has_texture_coords && m_face_texcoords)
+    {
+        vec2 *texture_coords = renumberFirstUse(m_texture_coords, m_texcoord_count, m_face_texcoords, m_face_count);
+        delete[] m_texture_coords;
+        m_texture_coords = texture_coords;
+    }
+
+    // unique vertices are collected in face order, so first use order as well
+    weldVertices();
+    m_acmr_before = acmr;
+
+    for (size_t i = 0; i < m_lod_count; i++)
+    {
+        m_lods[i]->optimizeVertexCache();
+    }
+}
+
+void TriangleMesh::clearMeshlets()
+{
+    if (m_meshlets)          delete[] m_meshlets;
+    if (m_meshlet_vertices)  delete[] m_meshlet_vertices;
+    if (m_meshlet_faces)     delete[] m_meshlet_faces;
+    if (m_meshlet_triangles) delete[] m_meshlet_triangles;
+    m_meshlets = nullptr;
+    m_meshlet_vertices = nullptr;
+    m_meshlet_faces = nullptr;
+    m_meshlet_triangles = nullptr;
+    m_meshlet_count = 0;
+    m_meshlet_vertex_count = 0;
+}
+
+/**
+ * bounding sphere around the box of the positions and the normal cone,
+ * degenerate triangles face nowhere and are ignored
+ * reference : meshoptimizer, meshopt_computeClusterBounds
+ */
+static void computeMeshletBounds(
+    Meshlet & meshlet, const UINT32 * vertices, const UINT32 * faces,
+    const vec3 * positions, const MeshVertex * welded_vertices, const vec3i * mesh_faces)
+{
+    vec3 min_bound = welded_vertices[vertices[0]].position;
+    vec3 max_bound = min_bound;
+    for (size_t i = 1; i < meshlet.vertex_count; i++)
+    {
+        const vec3 & p = welded_vertices[vertices[i]].position;
+        min_bound = vec3(min(min_bound.x, p.x), min(min_bound.y, p.y), min(min_bound.z, p.z));
+        max_bound = vec3(max(max_bound.x, p.x), max(max_bound.y, p.y), max(max_bound.z, p.z));
+    }
+    meshlet.center = (min_bound + max_bound) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (size_t i = 0; i < meshlet.vertex_count; i++)
+    {
+        meshlet.radius = max(meshlet.radius, (welded_vertices[vertices[i]].position - meshlet.center).length());
+    }
+
+    vec3 normals[MESHLET_MAX_TRIANGLES];
+    vec3 axis = vec3::ZERO;
+    for (size_t i = 0; i < meshlet.face_count; i++)
+    {
+        const vec3i & face = mesh_faces[faces[i]];
+        normals[i] = (positions[face[1]] - positions[face[0]]).cross(positions[face[2]] - positions[face[0]]);
+        if (normals[i].length() > 0.0f)
+        {
+            normals[i].normalize();
+            axis += normals[i];
+        }
+    }
+
+    meshlet.cone_apex = meshlet.center;
+    meshlet.cone_axis = axis;
+    meshlet.cone_cutoff = 1.0f;
+    if (axis.length() == 0.0f)
+    {
+        return;
+    }
+    axis.normalize();
+    meshlet.cone_axis = axis;
+
+    float min_dot = 1.0f;
+    for (size_t i = 0; i < meshlet.face_count; i++)
+    {
+        if (normals[i].length() > 0.0f)
+        {
+            min_dot = min(min_dot, axis.dot(normals[i]));
+        }
+    }
+    // wide cones put the apex far away and hardly ever cull
+    if (min_dot <= 0.1f)
+    {
+        return;
+    }
+
+    // move the apex back along the axis until it is behind every triangle plane
+    float max_t = 0.0f;
+    for (size_t i = 0; i < meshlet.face_count; i++)
+    {
+        if (normals[i].length() > 0.0f)
+        {
+            const vec3 & p0 = positions[mesh_faces[faces[i]][0]];
+            max_t = max(max_t, (meshlet.center - p0).dot(normals[i]) / axis.dot(normals[i]));
+        }
+    }
+    meshlet.cone_apex = meshlet.center - axis * max_t;
+    meshlet.cone_cutoff = min(sqrtf(1.0f - min_dot * min_dot) + MESHLET_CONE_EPSILON, 1.0f);
+}
+
+/**
+ * Greedy clustering, a meshlet grows by the face next to it that adds the
+ * fewest new vertices, ties go to the face closest to the meshlet. A meshlet
+ * is closed when nothing more fits MESHLET_MAX_VERTICES and
+ * MESHLET_MAX_TRIANGLES, the next one starts from the closest face left
+ * around it. Faces connect through shared positions, so meshlets grow across
+ * texture and normal seams.
+ */
+void TriangleMesh::buildMeshlets()
+{
+    detachMapping();
+    clearMeshlets();
+    if (m_face_count == 0) return;
+
+    // faces around every position
+    size_t *adjacency_offsets = new size_t[m_vertex_count + 1];
+    UINT32 *adjacent_faces = new UINT32[m_face_count * 3];
+    memset(adjacency_offsets, 0, (m_vertex_count + 1) * sizeof(size_t));
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            adjacency_offsets[m_faces[fidx][i] + 1]++;
+        }
+    }
+    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    {
+        adjacency_offsets[vidx + 1] += adjacency_offsets[vidx];
+    }
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            adjacent_faces[adjacency_offsets[m_faces[fidx][i]]++] = fidx;
+        }
+    }
+    for (size_t vidx = m_vertex_count; vidx > 0; vidx--)
+    {
+        adjacency_offsets[vidx] = adjacency_offsets[vidx - 1];
+    }
+    adjacency_offsets[0] = 0;
+
+    vec3 *face_centers = new vec3[m_face_count];
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        face_centers[fidx] = (m_vertices[m_faces[fidx][0]] + m_vertices[m_faces[fidx][1]] + m_vertices[m_faces[fidx][2]]) * (1.0f / 3.0f);
+    }
+
+    bool *emitted = new bool[m_face_count];
+    memset(emitted, 0, m_face_count * sizeof(bool));
+    // local index of a unique vertex in the open meshlet, -1 if not in it
+    long *local_index = new long[m_unique_vertex_count];
+    memset(local_index, -1, m_unique_vertex_count * sizeof(long));
+
+    DynamicArray<Meshlet> meshlets;
+    DynamicArray<UINT32> meshlet_vertices;
+    DynamicArray<UINT32> candidates;
+    m_meshlet_faces = new UINT32[m_face_count];
+    m_meshlet_triangles = new byte_t[m_face_count * 3];
+
+    Meshlet meshlet;
+    meshlet.vertex_offset = 0;
+    meshlet.vertex_count = 0;
+    meshlet.face_offset = 0;
+    meshlet.face_count = 0;
+    vec3 center_sum = vec3::ZERO;
+    vec3 center = vec3::ZERO;
+    size_t emitted_count = 0;
+    size_t next_seed = 0;
+    while (emitted_count < m_face_count)
+    {
+        long best_face = -1;
+        UINT32 best_new_vertices = 4;
+        float best_distance = FLT_MAX;
+        for (size_t i = 0; i < candidates.size(); )
+        {
+            const UINT32 fidx = candidates[i];
+            if (emitted[fidx])
+            {
+                candidates[i] = candidates[candidates.size() - 1];
+                candidates.pop_back();
+                continue;
+            }
+            i++;
+
+            UINT32 new_vertices = 0;
+            for (size_t k = 0; k < 3; k++)
+            {
+                new_vertices += local_index[m_indices[fidx * 3 + k]] < 0 ? 1 : 0;
+            }
+            if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES)
+            {
+                continue;
+            }
+            const vec3 offset = face_centers[fidx] - center;
+            const float distance = offset.dot(offset);
+            if (new_vertices < best_new_vertices || (new_vertices == best_new_vertices && distance < best_distance))
+            {
+                best_face = fidx;
+                best_new_vertices = new_vertices;
+                best_distance = distance;
+            }
+        }
+
+        if (best_face < 0 || meshlet.face_count == MESHLET_MAX_TRIANGLES)
+        {
+            if (meshlet.face_count > 0)
+            {
+                const UINT32 *vertices = meshlet_vertices.data() + meshlet.vertex_offset;
+                computeMeshletBounds(meshlet, vertices, m_meshlet_faces + meshlet.face_offset, m_vertices, m_welded_vertices, m_faces);
+                meshlets.push_back(meshlet);
+                for (size_t i = 0; i < meshlet.vertex_count; i++)
+                {
+                    local_index[vertices[i]] = -1;
+                }
+
+                meshlet.vertex_offset = meshlet_vertices.size();
+                meshlet.vertex_count = 0;
+                meshlet.face_offset = emitted_count;
+                meshlet.face_count = 0;
+                center_sum = vec3::ZERO;
+                // candidates are evaluated again against the empty meshlet
+                continue;
+            }
+            while (emitted[next_seed]) next_seed++;
+            best_face = next_seed;
+        }
+        // the frontier of a closed meshlet only seeds the next one
+        if (meshlet.face_count == 0)
+        {
+            candidates.clear();
+        }
+
+        const UINT32 fidx = best_face;
+        for (size_t k = 0; k < 3; k++)
+        {
+            const UINT32 vidx = m_indices[fidx * 3 + k];
+            if (local_index[vidx] < 0)
+            {
+                local_index[vidx] = meshlet.vertex_count++;
+                meshlet_vertices.push_back(vidx);
+            }
+            m_meshlet_triangles[emitted_count * 3 + k] = (byte_t)local_index[vidx];
+
+            const long pidx = m_faces[fidx][k];
+            for (size_t a = adjacency_offsets[pidx]; a < adjacency_offsets[pidx + 1]; a++)
+            {
+                if (!emitted[adjacent_faces[a]] && adjacent_faces[a] != fidx)
+                {
+                    candidates.push_back(adjacent_faces[a]);
+                }
+            }
+        }
+        m_meshlet_faces[emitted_count++] = fidx;
+        emitted[fidx] = true;
+        meshlet.face_count++;
+        center_sum += face_centers[fidx];
+        center = center_sum * (1.0f / meshlet.face_count);
+    }
+    computeMeshletBounds(
+        meshlet, meshlet_vertices.data() + meshlet.vertex_offset, m_meshlet_faces + meshlet.face_offset,
+        m_vertices, m_welded_vertices, m_faces);
+    meshlets.push_back(meshlet);
+
+    delete[] adjacency_offsets;
+    delete[] adjacent_faces;
+    delete[] face_centers;
+    delete[] emitted;
+    delete[] local_index;
+
+    m_meshlet_count = meshlets.size();
+    m_meshlets = meshlets.release();
+    m_meshlet_vertex_count = meshlet_vertices.size();
+    m_meshlet_vertices = meshlet_vertices.release();
+}
+
+/**
+ * sum of squared distances to a set of planes, the symmetric 4x4 matrix is
+ * stored as its upper triangle
+ * reference : Garland and Heckbert, Surface Simplification Using Quadric Error Metrics
+ */
+struct Quadric
+{
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+    double weight;
+};
+
+static void addPlaneQuadric(Quadric & q, const vec3 & normal, float distance, float weight)
+{
+    const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+    q.a2 += weight * a * a;
+    q.ab += weight * a * b;
+    q.ac += weight * a * c;
+    q.ad += weight * a * d;
+    q.b2 += weight * b * b;
+    q.bc += weight * b * c;
+    q.bd += weight * b * d;
+    q.c2 += weight * c * c;
+    q.cd += weight * c * d;
+    q.d2 += weight * d * d;
+    q.weight += weight;
+}
+
+static void addQuadric(Quadric & q, const Quadric & other)
+{
+    q.a2 += other.a2;
+    q.ab += other.ab;
+    q.ac += other.ac;
+    q.ad += other.ad;
+    q.b2 += other.b2;
+    q.bc += other.bc;
+    q.bd += other.bd;
+    q.c2 += other.c2;
+    q.cd += other.cd;
+    q.d2 += other.d2;
+    q.weight += other.weight;
+}
+
+// mean squared distance of p to the planes
+static double quadricError(const Quadric & q, const vec3 & p)
+{
+    const double x = p.x, y = p.y, z = p.z;
+    const double error = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z + q.d2 +
+                         2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z + q.ad * x + q.bd * y + q.cd * z);
+    return q.weight > 0.0 ? fabs(error) / q.weight : 0.0;
+}
+
+struct Collapse
+{
+    double  cost;
+    UINT32  from;
+    UINT32  to;
+};
+
+static int compareCollapse(const void * a, const void * b)
+{
+    const double cost_a = ((const Collapse*)a)->cost;
+    const double cost_b = ((const Collapse*)b)->cost;
+    return cost_a < cost_b ? -1 : (cost_a > cost_b ? 1 : 0);
+}
+
+/**
+ * Half edge collapses on the unique vertices, a vertex moves onto one of its
+ * neighbours so the attributes of the kept vertex stay valid for every face.
+ * Unique vertices split at texture and normal seams, which makes seams open
+ * borders of the unique vertex topology. Only vertices whose every edge is
+ * shared by exactly two faces are removed, borders and seams stay in place.
+ * Every pass sorts the cheapest collapse of each vertex by quadric error and
+ * applies them in order, skipping the ones next to a vertex that already
+ * changed in this pass, until the target is reached or no collapse within
+ * LOD_MAX_ERROR is left.
+ */
+TriangleMesh * TriangleMesh::simplify(size_t target_face_count, float * error) const
+{
+    const size_t vertex_count = m_unique_vertex_count;
+    vec3 *positions = new vec3[vertex_count];
+    for (size_t vidx = 0; vidx < vertex_count; vidx++)
+    {
+        positions[vidx] = m_welded_vertices[vidx].position;
+    }
+
+    UINT32 *triangles = new UINT32[m_face_count * 3];
+    bool *face_alive = new bool[m_face_count];
+    Quadric *quadrics = new Quadric[vertex_count];
+    memset(quadrics, 0, vertex_count * sizeof(Quadric));
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            triangles[fidx * 3 + i] = m_indices[fidx * 3 + i];
+        }
+        face_alive[fidx] = true;
+
+        // planes weighted by triangle area
+        const vec3 & p0 = positions[triangles[fidx * 3 + 0]];
+        const vec3 normal = (positions[triangles[fidx * 3 + 1]] - p0).cross(positions[triangles[fidx * 3 + 2]] - p0);
+        const float length = normal.length();
+        if (length > 0.0f)
+        {
+            const vec3 unit_normal = normal * (1.0f / length);
+            for (size_t i = 0; i < 3; i++)
+            {
+                addPlaneQuadric(quadrics[triangles[fidx * 3 + i]], unit_normal, -unit_normal.dot(p0), length * 0.5f);
+            }
+        }
+    }
+
+    size_t *adjacency_offsets = new size_t[vertex_count + 1];
+    UINT32 *adjacent_faces = new UINT32[m_face_count * 3];
+    UINT32 *neighbour_count = new UINT32[vertex_count];
+    UINT32 *marks = new UINT32[vertex_count];
+    bool *touched = new bool[vertex_count];
+    Collapse *collapses = new Collapse[vertex_count];
+    memset(neighbour_count, 0, vertex_count * sizeof(UINT32));
+    memset(marks, 0, vertex_count * sizeof(UINT32));
+    UINT32 mark = 0;
+
+    // collapses moving the surface farther than this are never done
+    const vec3 extent = getMaxBound() - getMinBound();
+    const double max_error = LOD_MAX_ERROR * extent.length() * LOD_MAX_ERROR * extent.length();
+
+    size_t face_count = m_face_count;
+    double max_cost = 0.0;
+    while (face_count > target_face_count)
+    {
+        // faces around every vertex
+        memset(adjacency_offsets, 0, (vertex_count + 1) * sizeof(size_t));
+        for (size_t fidx = 0; fidx < m_face_count; fidx++)
+        {
+            for (size_t i = 0; face_alive[fidx] && i < 3; i++)
+            {
+                adjacency_offsets[triangles[fidx * 3 + i] + 1]++;
+            }
+        }
+        for (size_t vidx = 0; vidx < vertex_count; vidx++)
+        {
+            adjacency_offsets[vidx + 1] += adjacency_offsets[vidx];
+        }
+        for (size_t fidx = 0; fidx < m_face_count; fidx++)
+        {
+            for (size_t i = 0; face_alive[fidx] && i < 3; i++)
+            {
+                adjacent_faces[adjacency_offsets[triangles[fidx * 3 + i]]++] = fidx;
+            }
+        }
+        for (size_t vidx = vertex_count; vidx > 0; vidx--)
+        {
+            adjacency_offsets[vidx] = adjacency_offsets[vidx - 1];
+        }
+        adjacency_offsets[0] = 0;
+
+        // cheapest collapse of every interior vertex, each neighbour of an
+        // interior vertex shares exactly two of its faces
+        size_t collapse_count = 0;
+        for (size_t u = 0; u < vertex_count; u++)
+        {
+            const size_t begin = adjacency_offsets[u];
+            const size_t end = adjacency_offsets[u + 1];
+            for (size_t a = begin; a < end; a++)
+            {
+                for (size_t i = 0; i < 3; i++)
+                {
+                    neighbour_count[triangles[adjacent_faces[a] * 3 + i]]++;
+                }
+            }
+            bool interior = begin < end;
+            Collapse collapse = { DBL_MAX, (UINT32)u, (UINT32)u };
+            for (size_t a = begin; a < end; a++)
+            {
+                for (size_t i = 0; i < 3; i++)
+                {
+                    const UINT32 w = triangles[adjacent_faces[a] * 3 + i];
+                    if (w == u)
+                    {
+                        continue;
+                    }
+                    interior = interior && neighbour_count[w] == 2;
+                    const double cost = quadricError(quadrics[u], positions[w]);
+                    if (cost < collapse.cost)
+                    {
+                        collapse.cost = cost;
+                        collapse.to = w;
+                    }
+                }
+            }
+            for (size_t a = begin; a < end; a++)
+            {
+                for (size_t i = 0; i < 3; i++)
+                {
+                    neighbour_count[triangles[adjacent_faces[a] * 3 + i]] = 0;
+                }
+            }
+            if (interior && collapse.cost <= max_error)
+            {
+                collapses[collapse_count++] = collapse;
+            }
+        }
+        ::qsort(collapses, collapse_count, sizeof(Collapse), compareCollapse);
+        if (collapse_count == 0)
+        {
+            break;
+        }
+
+        // a collapse removes two faces, collapses much worse than the last one
+        // needed are left for later passes where cheaper ones may show up
+        const size_t collapse_goal = min((face_count - target_face_count + 1) / 2, collapse_count) - 1;
+        const double pass_error_limit = collapses[collapse_goal].cost * 1.5;
+
+        memset(touched, 0, vertex_count * sizeof(bool));
+        size_t collapsed = 0;
+        for (size_t c = 0; c < collapse_count && face_count > target_face_count; c++)
+        {
+            const UINT32 u = collapses[c].from;
+            const UINT32 v = collapses[c].to;
+            if (collapses[c].cost > pass_error_limit)
+            {
+                break;
+            }
+            if (touched[u] || touched[v])
+            {
+                continue;
+            }
+
+            // link condition, u and v only share the two vertices across their
+            // common faces, otherwise the collapse pinches the surface
+            mark += 2;
+            for (size_t a = adjacency_offsets[u]; a < adjacency_offsets[u + 1]; a++)
+            {
+                for (size_t i = 0; i < 3; i++)
+                {
+                    marks[triangles[adjacent_faces[a] * 3 + i]] = mark;
+                }
+            }
+            size_t shared = 0;
+            for (size_t a = adjacency_offsets[v]; a < adjacency_offsets[v + 1]; a++)
+            {
+                for (size_t i = 0; i < 3; i++)
+                {
+                    const UINT32 w = triangles[adjacent_faces[a] * 3 + i];
+                    if (marks[w] == mark && w != u && w != v)
+                    {
+                        marks[w] = mark + 1;
+                        shared++;
+                    }
+                }
+            }
+            if (shared != 2)
+            {
+                continue;
+            }
+
+            // the faces that remain around u must not fold over
+            bool flipped = false;
+            for (size_t a = adjacency_offsets[u]; a < adjacency_offsets[u + 1] && !flipped; a++)
+            {
+                const UINT32 *t = &triangles[adjacent_faces[a] * 3];
+                if (t[0] == v || t[1] == v || t[2] == v)
+                {
+                    continue;
+                }
+                vec3 p[3];
+                for (size_t i = 0; i < 3; i++)
+                {
+                    p[i] = positions[t[i]];
+                }
+                const vec3 before = (p[1] - p[0]).cross(p[2] - p[0]);
+                for (size_t i = 0; i < 3; i++)
+                {
+                    p[i] = t[i] == u ? positions[v] : p[i];
+                }
+                const vec3 after = (p[1] - p[0]).cross(p[2] - p[0]);
+                flipped = before.dot(after) <= 0.25f * before.length() * after.length();
+            }
+            if (flipped)
+            {
+                continue;
+            }
+
+            for (size_t a = adjacency_offsets[u]; a < adjacency_offsets[u + 1]; a++)
+            {
+                const UINT32 fidx = adjacent_faces[a];
+                UINT32 *t = &triangles[fidx * 3];
+                for (size_t i = 0; i < 3; i++)
+                {
+                    touched[t[i]] = true;
+                }
+                if (t[0] == v || t[1] == v || t[2] == v)
+                {
+                    face_alive[fidx] = false;
+                    face_count--;
+                    continue;
+                }
+                for (size_t i = 0; i < 3; i++)
+                {
+                    t[i] = t[i] == u ? v : t[i];
+                }
+            }
+            addQuadric(quadrics[v], quadrics[u]);
+            max_cost = max(max_cost, collapses[c].cost);
+            collapsed++;
+        }
+        if (collapsed == 0)
+        {
+            break;
+        }
+    }
+
+    // keep the vertices still in use, in first use order
+    long *remap = new long[vertex_count];
+    memset(remap, -1, vertex_count * sizeof(long));
+    const bool has_normals = m_has_vertex_normals && m_face_normals;
+    const bool has_texcoords = m_has_texture_coords && m_face_texcoords;
+
+    TriangleMesh *lod = new TriangleMesh();
+    lod->m_face_count = face_count;
+    lod->m_faces = new vec3i[face_count];
+    size_t lod_face = 0;
+    for (size_t fidx = 0; fidx < m_face_count; fidx++)
+    {
+        if (!face_alive[fidx])
+        {
+            continue;
+        }
+        for (size_t i = 0; i < 3; i++)
+        {
+            const UINT32 vidx = triangles[fidx * 3 + i];
+            if (remap[vidx] < 0)
+            {
+                remap[vidx] = lod->m_vertex_count++;
+            }
+            lod->m_faces[lod_face][i] = remap[vidx];
+        }
+        lod_face++;
+    }
+
+    lod->m_vertices = new vec3[lod->m_vertex_count];
+    if (has_normals)
+    {
+        lod->m_normal_count = lod->m_vertex_count;
+        lod->m_vertex_normals = new vec3[lod->m_vertex_count];
+        lod->m_face_normals = new vec3i[face_count];
+        lod->m_has_vertex_normals = true;
+    }
+    if (has_texcoords)
+    {
+        lod->m_texcoord_count = lod->m_vertex_count;
+        lod->m_texture_coords = new vec2[lod->m_vertex_count];
+        lod->m_face_texcoords = new vec3i[face_count];
+        lod->m_has_texture_coords = true;
+    }
+    for (size_t vidx = 0; vidx < vertex_count; vidx++)
+    {
+        if (remap[vidx] < 0)
+        {
+            continue;
+        }
+        lod->m_vertices[remap[vidx]] = positions[vidx];
+        if (has_normals)
+        {
+            lod->m_vertex_normals[remap[vidx]] = m_welded_vertices[vidx].normal;
+        }
+        if (has_texcoords)
+        {
+            lod->m_texture_coords[remap[vidx]] = m_welded_vertices[vidx].texcoord;
+        }
+    }
+    // the simplified mesh is welded, every attribute uses the position indices
+    for (size_t fidx = 0; fidx < face_count; fidx++)
+    {
+        if (has_normals)   lod->m_face_normals[fidx] = lod->m_faces[fidx];
+        if (has_texcoords) lod->m_face_texcoords[fidx] = lod->m_faces[fidx];
+    }
+
+    delete[] positions;
+    delete[] triangles;
+    delete[] face_alive;
+    delete[] quadrics;
+    delete[] adjacency_offsets;
+    delete[] adjacent_faces;
+    delete[] neighbour_count;
+    delete[] marks;
+    delete[] touched;
+    delete[] collapses;
+    delete[] remap;
+
+    if (error)
+    {
+        *error = (float)sqrt(max_cost);
+    }
+
+    lod->computeMeshCenter();
+    lod->computeBoundingBox();
+    if (m_has_triangle_normals)
+    {
+        lod->computeTriangleNormals();
+    }
+    lod->weldVertices();
+    if (hasMeshlets())
+    {
+        lod->buildMeshlets();
+    }
+    if (isVertexCacheOptimized())
+    {
+        lod->optimizeVertexCache();
+    }
+    return lod;
+}
+
+size_t TriangleMesh::buildLods(TriangleMesh ** lods, size_t level_count) const
+{
+    // every level comes from the full mesh, errors do not pile up along the chain
+    size_t count = 0;
+    size_t face_count = m_face_count;
+    while (count < level_count && count < LOD_MAX_LEVELS)
+    {
+        TriangleMesh *lod = simplify((size_t)(face_count * LOD_REDUCTION));
+        // stop once borders and seams are all that is left
+        if (lod->m_face_count == 0 || lod->m_face_count > face_count * LOD_MIN_REDUCTION)
+        {
+            delete lod;
+            break;
+        }
+        lods[count++] = lod;
+        face_count = lod->m_face_count;
+    }
+    return count;
+}
+
+void TriangleMesh::setLods(TriangleMesh ** lods, size_t count)
+{
+    clearLods();
+    m_lod_count = min(count, (size_t)LOD_MAX_LEVELS);
+    for (size_t i = 0; i < m_lod_count; i++)
+    {
+        m_lods[i] = lods[i];
+    }
+}
+
+void TriangleMesh::generateLods(size_t level_count)
+{
+    TriangleMesh *lods[LOD_MAX_LEVELS];
+    const size_t count = buildLods(lods, level_count);
+    setLods(lods, count);
+}
+
+void TriangleMesh::clearLods()
+{
+    for (size_t i = 0; i < m_lod_count; i++)
+    {
+        delete m_lods[i];
+        m_lods[i] = nullptr;
+    }
+    m_lod_count = 0;
+}
+
+const TriangleMesh * TriangleMesh::getLod(size_t level) const
+{
+    if (level == 0 || m_lod_count == 0)
+    {
+        return this;
+    }
+    return m_lods[min(level, m_lod_count) - 1];
+}
+
+void TriangleMesh::computeMeshCenter()
+{
+    vec3 center = vec3::ZERO;
+
+    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    {
+        center += m_vertices[vidx];
+    }
+
+    m_mesh_center = center * (1.0f / m_vertex_count);
+}
+
+void TriangleMesh::computeBoundingBox()
+{
+    BoundingBox bounding_box(
+         FLOAT_INF,  FLOAT_INF,  FLOAT_INF,
+        -FLOAT_INF, -FLOAT_INF, -FLOAT_INF
+    );
+
+    for (size_t vidx = 0; vidx < m_vertex_count; vidx++)
+    {
+        bounding_box.min_x = min(m_vertices[vidx].x, bounding_box.min_x);
+        bounding_box.min_y = min(m_vertices[vidx].y, bounding_box.min_y);
+        bounding_box.min_z = min(m_vertices[vidx].z, bounding_box.min_z);
+        bounding_box.max_x = max(m_vertices[vidx].x, bounding_box.max_x);
+        bounding_box.max_y = max(m_vertices[vidx].y, bounding_box.max_y);
+        bounding_box.max_z = max(m_vertices[vidx].z, bounding_box.max_z);
+    }
+    
+    m_bounding_box = bounding_box;
+}
+
+BoundingBox TriangleMesh::getAxisAlignBoundingBox() const
+{
+    return m_bounding_box;
+}
+
+vec3 TriangleMesh::getMaxBound() const
+{
+    return vec3(m_bounding_box.max_x, m_bounding_box.max_y, m_bounding_box.max_z);
+}
+
+vec3 TriangleMesh::getMinBound() const
+{
+    return vec3(m_bounding_box.min_x, m_bounding_box.min_y, m_bounding_box.min_z);
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <float.h>
 #include "global.hpp"
 #include "maths.hpp"
 #include "darray.hpp"
@@ -12,9 +13,11 @@
 namespace Lurdr
 {
 
-#define MAX_OBJ_LINE 256
 #define FLOAT_INF 1e6
 
+class MappedFile;
+struct MeshCacheHeader;
+
 struct BoundingBox
 {
     float min_x;
@@ -47,6 +50,20 @@ struct BoundingBox
     }
 };
 
+typedef enum {FRUSTUM_OUTSIDE, FRUSTUM_INTERSECT, FRUSTUM_INSIDE} FRUSTUM_RESULT;
+
+/**
+ * classify a model space bounding box against the view volume of the
+ * model-view-projection matrix mvp
+ */
+FRUSTUM_RESULT testFrustum(const BoundingBox & bbox, const mat4 & mvp);
+
+/**
+ * half the larger extent of the projected bounding box in normalized device
+ * coordinates, 1 covers the whole view, FLT_MAX when it reaches behind the eye
+ */
+float projectScreenSize(const BoundingBox & bbox, const mat4 & mvp);
+
 class OBJMesh
 {
 private:
@@ -118,6 +135,53 @@ public:
 
 #define VERTEX(a) (*(vec3*)&m_vertices[a*3])
 
+// limits of one meshlet, local vertex indices have to fit a byte
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+// widens the normal cone a little, triangles seen almost edge on stay in
+#define MESHLET_CONE_EPSILON 1e-3f
+
+// simplified levels of detail a mesh keeps besides the full mesh
+#define LOD_MAX_LEVELS 4
+// each level targets this fraction of the faces of the previous one
+#define LOD_REDUCTION 0.5f
+// a level that keeps more than this fraction of the faces ends the chain
+#define LOD_MIN_REDUCTION 0.9f
+// largest distance a collapse may move the surface, relative to the bounding box diagonal
+#define LOD_MAX_ERROR 0.02f
+
+// entries of the FIFO post transform cache optimizeVertexCache targets
+#define VERTEX_CACHE_SIZE 16
+
+/**
+ * Welded vertex of a TriangleMesh, one per unique (position, normal, texcoord)
+ * combination. Attributes the mesh lacks are zero.
+ */
+struct MeshVertex
+{
+    vec3    position;
+    vec3    normal;
+    vec2    texcoord;
+};
+
+/**
+ * Cluster of neighbouring faces of a TriangleMesh, bounds are in model space.
+ * Every triangle of the meshlet faces away from an eye position when
+ * dot(normalize(cone_apex - eye), cone_axis) >= cone_cutoff.
+ */
+struct Meshlet
+{
+    vec3    center;         // bounding sphere
+    float   radius;
+    vec3    cone_apex;
+    vec3    cone_axis;
+    float   cone_cutoff;    // 1 when the normals are too spread to ever cull
+    UINT32  vertex_offset;  // into TriangleMesh::getMeshletVertices()
+    UINT32  vertex_count;
+    UINT32  face_offset;    // into TriangleMesh::getMeshletFaces()
+    UINT32  face_count;
+};
+
 class TriangleMesh
 {
 private:
@@ -128,16 +192,54 @@ private:
     vec3i   *m_faces;
     vec3i   *m_face_texcoords;
     vec3i   *m_face_normals;
+    MeshVertex *m_welded_vertices;  // interleaved attributes of the unique vertices
+    UINT32  *m_indices;             // three per face into m_welded_vertices
+    Meshlet *m_meshlets;
+    UINT32  *m_meshlet_vertices;    // per meshlet indices into m_welded_vertices
+    UINT32  *m_meshlet_faces;       // faces in meshlet order
+    byte_t  *m_meshlet_triangles;   // per m_meshlet_faces entry indices into the vertices of its meshlet
+    TriangleMesh *m_lods[LOD_MAX_LEVELS];   // simplified levels, owned
     vec3    m_mesh_center;
+    BoundingBox m_bounding_box;     // model space, computed at load
+    MappedFile *m_mapping;          // mesh cache the arrays point into, nullptr if they are owned
+    bool     m_mapping_borrowed;    // levels point into the mapping of their mesh, which frees it
 
     size_t   m_vertex_count;
     size_t   m_face_count;
+    size_t   m_normal_count;
+    size_t   m_texcoord_count;
+    size_t   m_unique_vertex_count;
+    size_t   m_meshlet_count;
+    size_t   m_meshlet_vertex_count;
+    size_t   m_lod_count;
+    float    m_acmr_before;         // before optimizeVertexCache, 0 if never run
     
     bool     m_has_vertex_normals;
     bool     m_has_triangle_normals;
     bool     m_has_texture_coords;
+
+    void weldVertices();
+    void clearArrays();
+    void copyFrom(const TriangleMesh & tri_mesh);
+    void clearMeshlets();
+    void clearLods();
+
+    // defined in meshcache.cpp
+    bool loadCache(const char * filename, UINT64 source_hash);
+    bool writeCache(const char * filename, UINT64 source_hash) const;
+    void mapCache(MappedFile * mapping, const MeshCacheHeader * header);
+    // copy the mapped arrays so they can be replaced, before any change
+    void detachMapping();
+    void releaseMapping();
 public:
     TriangleMesh();
+    /**
+     * load a Wavefront OBJ file, meshlets and levels of detail are built
+     * with LURDR_BUILD_MESHLETS and LURDR_LOD_LEVELS. With LURDR_MESH_CACHE on
+     * the mesh, its meshlets and levels are written to filename
+     * MESH_CACHE_EXTENSION and later loads map that file instead while the
+     * OBJ contents hash the same
+     */
     TriangleMesh(const char * filename);
     TriangleMesh(const TriangleMesh & tri_mesh);
     ~TriangleMesh();
@@ -147,6 +249,41 @@ public:
     void computeVertexNormals();
     void computeTriangleNormals();
     void computeMeshCenter();
+    void computeBoundingBox();
+    /**
+     * cluster the faces into meshlets, the pipeline culls whole meshlets
+     * against the view frustum and by their normal cone before vertex shading
+     * and draws the faces in meshlet order. Meshlets are rebuilt with the
+     * welded vertices and carried over to copies.
+     */
+    void buildMeshlets();
+
+    /**
+     * simplified copy with about target_face_count faces by quadric error edge
+     * collapse, texture and normal seams and open borders are kept. The copy
+     * is welded, one index per corner for every attribute. error, if given,
+     * receives the largest root mean square distance of a moved vertex to the
+     * faces it replaced, in model units.
+     */
+    TriangleMesh * simplify(size_t target_face_count, float * error = nullptr) const;
+    /**
+     * chain of up to level_count simplified levels, every one simplified from
+     * this mesh down to LOD_REDUCTION of the face count of the level before,
+     * written to lods and owned by the caller, returns the level count
+     */
+    size_t buildLods(TriangleMesh ** lods, size_t level_count = LOD_MAX_LEVELS) const;
+    // take ownership of levels 1 to count, replacing the current ones
+    void setLods(TriangleMesh ** lods, size_t count);
+    void generateLods(size_t level_count = LOD_MAX_LEVELS);
+
+    /**
+     * reorder the faces for post transform cache reuse and renumber every
+     * attribute in first use order, levels of detail are optimized as well.
+     * Done at load when LURDR_OPTIMIZE_MESHES is on.
+     */
+    void optimizeVertexCache();
+    // average cache miss ratio, transformed vertices per face
+    float computeACMR(size_t cache_size = VERTEX_CACHE_SIZE) const;
 
     BoundingBox getAxisAlignBoundingBox() const;
     vec3 getMaxBound() const;
@@ -155,9 +292,19 @@ public:
     bool hasVertexNormals() const { return m_has_vertex_normals; }
     bool hasTriangleNormals() const { return m_has_triangle_normals; }
     bool hasTextureCoords() const { return m_has_texture_coords; }
+    bool hasMeshlets() const { return m_meshlets != nullptr; }
+    bool isVertexCacheOptimized() const { return m_acmr_before > 0.0f; }
+    bool isMapped() const { return m_mapping != nullptr; }
 
     size_t vertexCount() const { return m_vertex_count; }
     size_t faceCount() const { return m_face_count; }
+    size_t uniqueVertexCount() const { return m_unique_vertex_count; }
+    size_t meshletCount() const { return m_meshlet_count; }
+    size_t meshletVertexCount() const { return m_meshlet_vertex_count; }
+    // levels including the full mesh at level 0
+    size_t lodCount() const { return m_lod_count + 1; }
+    // the coarsest level for levels past the chain
+    const TriangleMesh * getLod(size_t level) const;
 
     vec3* getVertices() const { return m_vertices; }
     vec3* getVertexNormals() const { return m_vertex_normals; }
@@ -166,9 +313,18 @@ public:
     vec3i* getFaceTexcoords() const { return m_face_texcoords; }
     vec3i* getFaceNormals() const { return m_face_normals; }
     vec2* getTextureCoords() const { return m_texture_coords; }
+    // what the pipeline draws, m_faces and the attribute arrays welded at load
+    MeshVertex* getWeldedVertices() const { return m_welded_vertices; }
+    UINT32* getIndices() const { return m_indices; }
+    Meshlet* getMeshlets() const { return m_meshlets; }
+    UINT32* getMeshletVertices() const { return m_meshlet_vertices; }
+    UINT32* getMeshletFaces() const { return m_meshlet_faces; }
+    byte_t* getMeshletTriangles() const { return m_meshlet_triangles; }
     vec3 getMeshCenter() const { return m_mesh_center; }
 
     void printMeshInfo() const;
+
+    friend class StreamingMesh;
 };
 
 }
@@ -0,0 +1,490 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "meshcache.hpp"
+
+using namespace Lurdr;
+
+#define MESH_CACHE_LAYOUT ((UINT32)(sizeof(vec3) | sizeof(vec2) << 8 | sizeof(vec3i) << 16 | sizeof(MeshVertex) << 24))
+
+/**
+ * MappedFile
+ */
+
+MappedFile::MappedFile(const char * filename):
+    m_data(nullptr),
+    m_size(0)
+{
+    // private copy on write mapping, meshes may still write their arrays in place
+#ifdef _WIN32
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = nullptr;
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    }
+    if (mapping != nullptr)
+    {
+        m_data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    }
+    if (m_data == nullptr)
+    {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_size = size.QuadPart;
+#else
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) return;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        void *data = mmap(nullptr, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            m_data = data;
+            m_size = file_stat.st_size;
+        }
+    }
+    // the mapping keeps the file alive
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    munmap(m_data, m_size);
+#endif
+}
+
+UINT64 Lurdr::hashFileContents(const char * filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == nullptr) return 0;
+
+    const size_t buffer_size = 1 << 16;
+    byte_t *buffer = new byte_t[buffer_size];
+    UINT64 hash = 14695981039346656037ull;
+    size_t read_size;
+    while ((read_size = fread(buffer, 1, buffer_size, fp)) > 0)
+    {
+        for (size_t i = 0; i < read_size; i++)
+        {
+            hash = (hash ^ buffer[i]) * 1099511628211ull;
+        }
+    }
+    delete[] buffer;
+    fclose(fp);
+    return hash;
+}
+
+/**
+ * TriangleMesh cache
+ */
+
+static char * cachePath(const char * filename)
+{
+    const size_t length = strlen(filename);
+    char *path = new char[length + sizeof(MESH_CACHE_EXTENSION)];
+    memcpy(path, filename, length);
+    memcpy(path + length, MESH_CACHE_EXTENSION, sizeof(MESH_CACHE_EXTENSION));
+    return path;
+}
+
+// bytes of every array of the mesh of header, in MESH_CACHE_ARRAY order
+static void cacheArraySizes(const MeshCacheHeader & header, size_t * array_sizes)
+{
+    array_sizes[MESH_CACHE_VERTICES]          = header.vertex_count * sizeof(vec3);
+    array_sizes[MESH_CACHE_NORMALS]           = header.normal_count * sizeof(vec3);
+    array_sizes[MESH_CACHE_TEXCOORDS]         = header.texcoord_count * sizeof(vec2);
+    array_sizes[MESH_CACHE_FACES]             = header.face_count * sizeof(vec3i);
+    array_sizes[MESH_CACHE_FACE_NORMALS]      = header.face_count * sizeof(vec3i);
+    array_sizes[MESH_CACHE_FACE_TEXCOORDS]    = header.face_count * sizeof(vec3i);
+    array_sizes[MESH_CACHE_TRIANGLE_NORMALS]  = header.face_count * sizeof(vec3);
+    array_sizes[MESH_CACHE_WELDED_VERTICES]   = header.welded_vertex_count * sizeof(MeshVertex);
+    array_sizes[MESH_CACHE_INDICES]           = header.face_count * 3 * sizeof(UINT32);
+    array_sizes[MESH_CACHE_MESHLETS]          = header.meshlet_count * sizeof(Meshlet);
+    array_sizes[MESH_CACHE_MESHLET_VERTICES]  = header.meshlet_vertex_count * sizeof(UINT32);
+    array_sizes[MESH_CACHE_MESHLET_FACES]     = header.meshlet_count ? header.face_count * sizeof(UINT32) : 0;
+    array_sizes[MESH_CACHE_MESHLET_TRIANGLES] = header.meshlet_count ? header.face_count * 3 : 0;
+}
+
+// true if every face of faces indexes [first, count), -1 marks an attribute the OBJ face lacks
+static bool validFaceIndices(const vec3i * faces, size_t face_count, long first, UINT64 count)
+{
+    for (size_t fidx = 0; faces && fidx < face_count; fidx++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (faces[fidx][k] < first || faces[fidx][k] >= (long)count) return false;
+        }
+    }
+    return true;
+}
+
+// true if every stored index lies inside the array it indexes, the renderer reads them unchecked
+static bool validIndices(const byte_t * data, const MeshCacheHeader & header)
+{
+    const UINT64 *offsets = header.offsets;
+    const size_t face_count = header.face_count;
+    const vec3i *face_normals = offsets[MESH_CACHE_FACE_NORMALS] ? (const vec3i*)(data + offsets[MESH_CACHE_FACE_NORMALS]) : nullptr;
+    const vec3i *face_texcoords = offsets[MESH_CACHE_FACE_TEXCOORDS] ? (const vec3i*)(data + offsets[MESH_CACHE_FACE_TEXCOORDS]) : nullptr;
+    if (!validFaceIndices((const vec3i*)(data + offsets[MESH_CACHE_FACES]), face_count, 0, header.vertex_count) ||
+        !validFaceIndices(face_normals, face_count, -1, header.normal_count) ||
+        !validFaceIndices(face_texcoords, face_count, -1, header.texcoord_count))
+    {
+        return false;
+    }
+
+    const UINT32 *indices = (const UINT32*)(data + offsets[MESH_CACHE_INDICES]);
+    for (size_t i = 0; i < face_count * 3; i++)
+    {
+        if (indices[i] >= header.welded_vertex_count) return false;
+    }
+
+    const Meshlet *meshlets = (const Meshlet*)(data + offsets[MESH_CACHE_MESHLETS]);
+    const UINT32 *meshlet_vertices = (const UINT32*)(data + offsets[MESH_CACHE_MESHLET_VERTICES]);
+    const UINT32 *meshlet_faces = (const UINT32*)(data + offsets[MESH_CACHE_MESHLET_FACES]);
+    const byte_t *meshlet_triangles = data + offsets[MESH_CACHE_MESHLET_TRIANGLES];
+    for (size_t i = 0; i < header.meshlet_vertex_count; i++)
+    {
+        if (meshlet_vertices[i] >= header.welded_vertex_count) return false;
+    }
+    for (size_t midx = 0; midx < header.meshlet_count; midx++)
+    {
+        const Meshlet & meshlet = meshlets[midx];
+        if ((UINT64)meshlet.vertex_offset + meshlet.vertex_count > header.meshlet_vertex_count ||
+            (UINT64)meshlet.face_offset + meshlet.face_count > face_count)
+        {
+            return false;
+        }
+        for (size_t slot = meshlet.face_offset; slot < meshlet.face_offset + meshlet.face_count; slot++)
+        {
+            if (meshlet_faces[slot] >= face_count ||
+                meshlet_triangles[slot * 3 + 0] >= meshlet.vertex_count ||
+                meshlet_triangles[slot * 3 + 1] >= meshlet.vertex_count ||
+                meshlet_triangles[slot * 3 + 2] >= meshlet.vertex_count)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// header of the mesh or level at offset if it belongs to source_hash, all its
+// arrays lie in the file and all its indices in their arrays
+static const MeshCacheHeader * validHeader(const byte_t * data, size_t file_size, UINT64 offset, UINT64 source_hash)
+{
+    if (offset % MESH_CACHE_ALIGNMENT != 0 || offset > file_size || file_size - offset < sizeof(MeshCacheHeader))
+    {
+        return nullptr;
+    }
+    const MeshCacheHeader *header = (const MeshCacheHeader*)(data + offset);
+    bool valid = header->magic == MESH_CACHE_MAGIC &&
+                 header->version == MESH_CACHE_VERSION &&
+                 header->layout == MESH_CACHE_LAYOUT &&
+                 header->meshlet_layout == sizeof(Meshlet) &&
+                 header->source_hash == source_hash &&
+                 header->vertex_count <= file_size && header->normal_count <= file_size &&
+                 header->texcoord_count <= file_size && header->face_count <= file_size &&
+                 header->welded_vertex_count <= file_size && header->meshlet_count <= file_size &&
+                 header->meshlet_vertex_count <= file_size && header->lod_count <= LOD_MAX_LEVELS;
+    if (valid)
+    {
+        size_t array_sizes[MESH_CACHE_ARRAY_COUNT];
+        cacheArraySizes(*header, array_sizes);
+        for (size_t i = 0; i < MESH_CACHE_ARRAY_COUNT; i++)
+        {
+            const UINT64 array_offset = header->offsets[i];
+            if (array_offset % MESH_CACHE_ALIGNMENT != 0 || array_offset > file_size || array_sizes[i] > file_size - array_offset)
+            {
+                valid = false;
+            }
+        }
+        const UINT64 *offsets = header->offsets;
+        valid = valid && offsets[MESH_CACHE_VERTICES] && offsets[MESH_CACHE_FACES] &&
+                offsets[MESH_CACHE_TRIANGLE_NORMALS] && offsets[MESH_CACHE_WELDED_VERTICES] &&
+                offsets[MESH_CACHE_INDICES] &&
+                (header->meshlet_count == 0 || (offsets[MESH_CACHE_MESHLETS] && offsets[MESH_CACHE_MESHLET_VERTICES] &&
+                 offsets[MESH_CACHE_MESHLET_FACES] && offsets[MESH_CACHE_MESHLET_TRIANGLES]));
+        valid = valid && validIndices(data, *header);
+    }
+    return valid ? header : nullptr;
+}
+
+bool TriangleMesh::loadCache(const char * filename, UINT64 source_hash)
+{
+    char *path = cachePath(filename);
+    MappedFile *mapping = new MappedFile(path);
+    delete[] path;
+
+    const Global & global = Singleton<Global>::get();
+    const byte_t *data = (const byte_t*)mapping->data();
+    const size_t file_size = mapping->size();
+    const MeshCacheHeader *header = data ? validHeader(data, file_size, 0, source_hash) : nullptr;
+    // the face order, meshlets and levels depend on the load settings
+    bool valid = header != nullptr &&
+                 (header->acmr_before > 0.0f) == global.optimize_meshes &&
+                 (header->meshlet_count > 0) == global.build_meshlets &&
+                 header->lod_levels == (UINT32)clamp(global.lod_levels, 0L, (long)LOD_MAX_LEVELS);
+    const MeshCacheHeader *lod_headers[LOD_MAX_LEVELS];
+    for (size_t i = 0; valid && i < header->lod_count; i++)
+    {
+        lod_headers[i] = validHeader(data, file_size, header->lod_offsets[i], source_hash);
+        valid = lod_headers[i] != nullptr && lod_headers[i]->lod_count == 0;
+    }
+    if (!valid)
+    {
+        delete mapping;
+        return false;
+    }
+
+    mapCache(mapping, header);
+    m_lod_count = header->lod_count;
+    for (size_t i = 0; i < m_lod_count; i++)
+    {
+        m_lods[i] = new TriangleMesh();
+        m_lods[i]->mapCache(mapping, lod_headers[i]);
+        m_lods[i]->m_mapping_borrowed = true;
+    }
+    return true;
+}
+
+void TriangleMesh::mapCache(MappedFile * mapping, const MeshCacheHeader * header)
+{
+    byte_t *data = (byte_t*)mapping->data();
+    const UINT64 *offsets = header->offsets;
+    m_mapping = mapping;
+    m_vertices          = (vec3*)(data + offsets[MESH_CACHE_VERTICES]);
+    m_vertex_normals    = offsets[MESH_CACHE_NORMALS] ? (vec3*)(data + offsets[MESH_CACHE_NORMALS]) : nullptr;
+    m_texture_coords    = offsets[MESH_CACHE_TEXCOORDS] ? (vec2*)(data + offsets[MESH_CACHE_TEXCOORDS]) : nullptr;
+    m_faces             = (vec3i*)(data + offsets[MESH_CACHE_FACES]);
+    m_face_normals      = offsets[MESH_CACHE_FACE_NORMALS] ? (vec3i*)(data + offsets[MESH_CACHE_FACE_NORMALS]) : nullptr;
+    m_face_texcoords    = offsets[MESH_CACHE_FACE_TEXCOORDS] ? (vec3i*)(data + offsets[MESH_CACHE_FACE_TEXCOORDS]) : nullptr;
+    m_triangle_normals  = (vec3*)(data + offsets[MESH_CACHE_TRIANGLE_NORMALS]);
+    m_welded_vertices   = (MeshVertex*)(data + offsets[MESH_CACHE_WELDED_VERTICES]);
+    m_indices           = (UINT32*)(data + offsets[MESH_CACHE_INDICES]);
+    if (header->meshlet_count > 0)
+    {
+        m_meshlets          = (Meshlet*)(data + offsets[MESH_CACHE_MESHLETS]);
+        m_meshlet_vertices  = (UINT32*)(data + offsets[MESH_CACHE_MESHLET_VERTICES]);
+        m_meshlet_faces     = (UINT32*)(data + offsets[MESH_CACHE_MESHLET_FACES]);
+        m_meshlet_triangles = data + offsets[MESH_CACHE_MESHLET_TRIANGLES];
+    }
+
+    m_vertex_count = header->vertex_count;
+    m_face_count = header->face_count;
+    m_normal_count = header->normal_count;
+    m_texcoord_count = header->texcoord_count;
+    m_unique_vertex_count = header->welded_vertex_count;
+    m_meshlet_count = header->meshlet_count;
+    m_meshlet_vertex_count = header->meshlet_vertex_count;
+    m_acmr_before = header->acmr_before;
+    m_has_vertex_normals = (header->flags & MESH_CACHE_VERTEX_NORMALS) != 0;
+    m_has_texture_coords = (header->flags & MESH_CACHE_TEXTURE_COORDS) != 0;
+    m_has_triangle_normals = true;
+    m_mesh_center = vec3(header->center[0], header->center[1], header->center[2]);
+    m_bounding_box = BoundingBox(
+        header->bounds[0], header->bounds[1], header->bounds[2],
+        header->bounds[3], header->bounds[4], header->bounds[5]);
+}
+
+// pad from position up to offset and write size bytes of data there
+static bool writeAt(FILE * fp, UINT64 & position, UINT64 offset, const void * data, size_t size)
+{
+    static const byte_t padding[MESH_CACHE_ALIGNMENT] = {};
+    const size_t padding_size = offset - position;
+    position = offset + size;
+    return fwrite(padding, 1, padding_size, fp) == padding_size && fwrite(data, 1, size, fp) == size;
+}
+
+bool TriangleMesh::writeCache(const char * filename, UINT64 source_hash) const
+{
+    // the mesh then every level, each a header followed by its arrays
+    const size_t mesh_count = 1 + m_lod_count;
+    MeshCacheHeader headers[1 + LOD_MAX_LEVELS];
+    const void *arrays[1 + LOD_MAX_LEVELS][MESH_CACHE_ARRAY_COUNT];
+    size_t array_sizes[1 + LOD_MAX_LEVELS][MESH_CACHE_ARRAY_COUNT];
+    UINT64 header_offsets[1 + LOD_MAX_LEVELS];
+    UINT64 offset = 0;
+    for (size_t midx = 0; midx < mesh_count; midx++)
+    {
+        const TriangleMesh *mesh = midx == 0 ? this : m_lods[midx - 1];
+        assert(mesh->m_has_triangle_normals && mesh->m_welded_vertices);
+
+        MeshCacheHeader & header = headers[midx];
+        memset(&header, 0, sizeof(header));
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.layout = MESH_CACHE_LAYOUT;
+        header.meshlet_layout = sizeof(Meshlet);
+        header.flags = (mesh->m_has_vertex_normals ? MESH_CACHE_VERTEX_NORMALS : 0) |
+                       (mesh->m_has_texture_coords ? MESH_CACHE_TEXTURE_COORDS : 0);
+        header.lod_levels = midx == 0 ? (UINT32)clamp(Singleton<Global>::get().lod_levels, 0L, (long)LOD_MAX_LEVELS) : 0;
+        header.source_hash = source_hash;
+        header.vertex_count = mesh->m_vertex_count;
+        header.normal_count = mesh->m_vertex_normals ? mesh->m_normal_count : 0;
+        header.texcoord_count = mesh->m_texture_coords ? mesh->m_texcoord_count : 0;
+        header.face_count = mesh->m_face_count;
+        header.welded_vertex_count = mesh->m_unique_vertex_count;
+        header.meshlet_count = mesh->m_meshlets ? mesh->m_meshlet_count : 0;
+        header.meshlet_vertex_count = mesh->m_meshlets ? mesh->m_meshlet_vertex_count : 0;
+        header.lod_count = midx == 0 ? m_lod_count : 0;
+        header.acmr_before = mesh->m_acmr_before;
+        header.center[0] = mesh->m_mesh_center.x;
+        header.center[1] = mesh->m_mesh_center.y;
+        header.center[2] = mesh->m_mesh_center.z;
+        header.bounds[0] = mesh->m_bounding_box.min_x;
+        header.bounds[1] = mesh->m_bounding_box.min_y;
+        header.bounds[2] = mesh->m_bounding_box.min_z;
+        header.bounds[3] = mesh->m_bounding_box.max_x;
+        header.bounds[4] = mesh->m_bounding_box.max_y;
+        header.bounds[5] = mesh->m_bounding_box.max_z;
+
+        const void *mesh_arrays[MESH_CACHE_ARRAY_COUNT] = {
+            mesh->m_vertices, mesh->m_vertex_normals, mesh->m_texture_coords,
+            mesh->m_faces, mesh->m_face_normals, mesh->m_face_texcoords,
+            mesh->m_triangle_normals, mesh->m_welded_vertices, mesh->m_indices,
+            mesh->m_meshlets, mesh->m_meshlet_vertices, mesh->m_meshlet_faces, mesh->m_meshlet_triangles
+        };
+        memcpy(arrays[midx], mesh_arrays, sizeof(mesh_arrays));
+        cacheArraySizes(header, array_sizes[midx]);
+
+        offset = (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+        header_offsets[midx] = offset;
+        offset += sizeof(MeshCacheHeader);
+        for (size_t i = 0; i < MESH_CACHE_ARRAY_COUNT; i++)
+        {
+            if (arrays[midx][i] == nullptr || array_sizes[midx][i] == 0) continue;
+            offset = (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+            header.offsets[i] = offset;
+            offset += array_sizes[midx][i];
+        }
+    }
+    for (size_t i = 0; i < m_lod_count; i++)
+    {
+        headers[0].lod_offsets[i] = header_offsets[i + 1];
+    }
+
+    // written aside and renamed, a cache is never seen half written
+    char *path = cachePath(filename);
+    const size_t path_length = strlen(path);
+    char *temp_path = new char[path_length + 5];
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".tmp", 5);
+
+    bool written = false;
+    FILE *fp = fopen(temp_path, "wb");
+    if (fp != nullptr)
+    {
+        written = true;
+        UINT64 position = 0;
+        for (size_t midx = 0; written && midx < mesh_count; midx++)
+        {
+            written = writeAt(fp, position, header_offsets[midx], &headers[midx], sizeof(MeshCacheHeader));
+            for (size_t i = 0; written && i < MESH_CACHE_ARRAY_COUNT; i++)
+            {
+                if (headers[midx].offsets[i] == 0) continue;
+                written = writeAt(fp, position, headers[midx].offsets[i], arrays[midx][i], array_sizes[midx][i]);
+            }
+        }
+        written = fclose(fp) == 0 && written;
+    }
+    if (written)
+    {
+        remove(path);
+        written = rename(temp_path, path) == 0;
+    }
+    if (!written)
+    {
+        remove(temp_path);
+    }
+
+    delete[] path;
+    delete[] temp_path;
+    return written;
+}
+
+template<typename T>
+static T * copyArray(const T * array, size_t count)
+{
+    if (array == nullptr) return nullptr;
+    T *copy = new T[count];
+    for (size_t i = 0; i < count; i++)
+    {
+        copy[i] = array[i];
+    }
+    return copy;
+}
+
+void TriangleMesh::detachMapping()
+{
+    if (m_mapping == nullptr) return;
+
+    // levels point into the same mapping
+    if (!m_mapping_borrowed)
+    {
+        for (size_t i = 0; i < m_lod_count; i++)
+        {
+            m_lods[i]->detachMapping();
+        }
+    }
+    m_vertices          = copyArray(m_vertices, m_vertex_count);
+    m_vertex_normals    = copyArray(m_vertex_normals, m_normal_count);
+    m_texture_coords    = copyArray(m_texture_coords, m_texcoord_count);
+    m_faces             = copyArray(m_faces, m_face_count);
+    m_face_normals      = copyArray(m_face_normals, m_face_count);
+    m_face_texcoords    = copyArray(m_face_texcoords, m_face_count);
+    m_triangle_normals  = copyArray(m_triangle_normals, m_face_count);
+    m_welded_vertices   = copyArray(m_welded_vertices, m_unique_vertex_count);
+    m_indices           = copyArray(m_indices, m_face_count * 3);
+    m_meshlets          = copyArray(m_meshlets, m_meshlet_count);
+    m_meshlet_vertices  = copyArray(m_meshlet_vertices, m_meshlet_vertex_count);
+    m_meshlet_faces     = copyArray(m_meshlet_faces, m_face_count);
+    m_meshlet_triangles = copyArray(m_meshlet_triangles, m_face_count * 3);
+    if (!m_mapping_borrowed) delete m_mapping;
+    m_mapping = nullptr;
+    m_mapping_borrowed = false;
+}
+
+void TriangleMesh::releaseMapping()
+{
+    if (m_mapping == nullptr) return;
+
+    m_vertices = nullptr;
+    m_vertex_normals = nullptr;
+    m_texture_coords = nullptr;
+    m_faces = nullptr;
+    m_face_normals = nullptr;
+    m_face_texcoords = nullptr;
+    m_triangle_normals = nullptr;
+    m_welded_vertices = nullptr;
+    m_indices = nullptr;
+    m_meshlets = nullptr;
+    m_meshlet_vertices = nullptr;
+    m_meshlet_faces = nullptr;
+    m_meshlet_triangles = nullptr;
+    if (!m_mapping_borrowed) delete m_mapping;
+    m_mapping = nullptr;
+    m_mapping_borrowed = false;
+}
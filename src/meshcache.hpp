@@ -0,0 +1,103 @@
+#ifndef __MESHCACHE_HPP__
+#define __MESHCACHE_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "global.hpp"
+#include "mesh.hpp"
+
+namespace Lurdr
+{
+
+// appended to the OBJ path, the cache sits next to its source
+#define MESH_CACHE_EXTENSION ".lrmesh"
+#define MESH_CACHE_MAGIC 0x48534d4cu   // "LMSH"
+#define MESH_CACHE_VERSION 2
+// every array starts at a multiple of this from the start of the file
+#define MESH_CACHE_ALIGNMENT 16
+
+#define MESH_CACHE_VERTEX_NORMALS   0x1
+#define MESH_CACHE_TEXTURE_COORDS   0x2
+
+enum MESH_CACHE_ARRAY
+{
+    MESH_CACHE_VERTICES = 0,
+    MESH_CACHE_NORMALS,
+    MESH_CACHE_TEXCOORDS,
+    MESH_CACHE_FACES,
+    MESH_CACHE_FACE_NORMALS,
+    MESH_CACHE_FACE_TEXCOORDS,
+    MESH_CACHE_TRIANGLE_NORMALS,
+    MESH_CACHE_WELDED_VERTICES,
+    MESH_CACHE_INDICES,
+    MESH_CACHE_MESHLETS,
+    MESH_CACHE_MESHLET_VERTICES,
+    MESH_CACHE_MESHLET_FACES,
+    MESH_CACHE_MESHLET_TRIANGLES,
+    MESH_CACHE_ARRAY_COUNT
+};
+
+/**
+ * Start of a binary mesh cache. Arrays are stored in the in-memory layout of
+ * this build so a mapped file is used in place, layout and meshlet_layout
+ * hold the element sizes and a cache from a different layout is rebuilt.
+ * Offsets are from the start of the file and 0 for arrays the mesh does not
+ * have. Every level of detail follows the arrays of the mesh as a header of
+ * its own and its arrays.
+ */
+struct MeshCacheHeader
+{
+    UINT32  magic;
+    UINT32  version;
+    UINT32  layout;
+    UINT32  meshlet_layout;
+    UINT32  flags;
+    UINT32  lod_levels;             // LURDR_LOD_LEVELS the levels were built for, 0 for a level
+    UINT64  source_hash;            // of the OBJ file contents
+    UINT64  vertex_count;
+    UINT64  normal_count;
+    UINT64  texcoord_count;
+    UINT64  face_count;
+    UINT64  welded_vertex_count;
+    UINT64  meshlet_count;
+    UINT64  meshlet_vertex_count;
+    UINT64  lod_count;
+    float   acmr_before;            // 0 unless faces were reordered for the vertex cache
+    float   center[3];
+    float   bounds[6];
+    UINT64  offsets[MESH_CACHE_ARRAY_COUNT];
+    UINT64  lod_offsets[LOD_MAX_LEVELS];    // of the header of every level
+};
+
+/**
+ * Private copy on write mapping of a whole file, writes to data() never reach
+ * the file, data() is nullptr if the file could not be mapped.
+ */
+class MappedFile
+{
+private:
+    void    *m_data;
+    size_t  m_size;
+#ifdef _WIN32
+    void    *m_file;
+    void    *m_mapping;
+#endif
+
+public:
+    MappedFile(const char * filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator= (const MappedFile &) = delete;
+
+    const void * data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+// 64 bit FNV-1a of the file contents, 0 if it cannot be read
+UINT64 hashFileContents(const char * filename);
+
+}
+
+#endif
@@ -55,6 +55,14 @@ void* operator new(size_t size)
 
 #endif
 
+// monotonic wall clock in milliseconds, for measuring intervals
+inline double getTimeMilliseconds()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
 class Timer
 {
 private:
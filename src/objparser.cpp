@@ -0,0 +1,433 @@
+#include <thread>
+#include "objparser.hpp"
+#include "meshcache.hpp"
+#include "parallel.hpp"
+
+using namespace Lurdr;
+
+// corners of one triangle in the relative fixups of a chunk, per attribute
+#define OBJ_FIXUP_POSITION  0
+#define OBJ_FIXUP_TEXCOORD  3
+#define OBJ_FIXUP_NORMAL    6
+#define OBJ_FIXUP_STRIDE    9
+
+/**
+ * Elements of one line aligned chunk. Relative indices can point before the
+ * chunk, they are stored relative to its first element and listed in fixups
+ * so the merge can add the element counts of the chunks before.
+ */
+struct OBJChunk
+{
+    const char          *begin;
+    const char          *end;
+    DynamicArray<vec3>  vertices;
+    DynamicArray<vec2>  texture_coords;
+    DynamicArray<vec3>  vertex_normals;
+    DynamicArray<vec3i> faces;
+    DynamicArray<vec3i> face_texcoords;     // empty until a face of the chunk has texcoords
+    DynamicArray<vec3i> face_normals;       // empty until a face of the chunk has normals
+    DynamicArray<size_t> fixups;            // face * OBJ_FIXUP_STRIDE + attribute + corner
+};
+
+struct OBJMergeJob
+{
+    OBJChunk    *chunks;
+    size_t      *bases;     // per chunk first vertex, texcoord, normal and face
+    OBJData     *data;
+};
+
+static const float s_float_powers[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const double s_double_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+static inline const char * skipSpaces(const char * p, const char * end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static inline const char * skipLine(const char * p, const char * end)
+{
+    while (p < end && *p != '\n') p++;
+    return p < end ? p + 1 : end;
+}
+
+/**
+ * decimal to float, exact when the mantissa and the power of ten are exact in
+ * float or double (Clinger's fast path), strtof otherwise
+ */
+static const char * parseFloat(const char * p, const char * end, float & value)
+{
+    p = skipSpaces(p, end);
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    UINT64 mantissa = 0;
+    long exponent = 0;
+    bool truncated = false;
+    const char *digits = p;
+    for (; p < end && isDigit(*p); p++)
+    {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0');
+        else { exponent++; truncated = true; }
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && isDigit(*p); p++)
+        {
+            if (mantissa < 100000000000000000ull) { mantissa = mantissa * 10 + (*p - '0'); exponent--; }
+            else truncated = true;
+        }
+    }
+    if (p == digits)
+    {
+        // not a number, inf and nan included
+        value = 0.0f;
+        return skipSpaces(p, end);
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool negative_exponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+        {
+            negative_exponent = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q))
+        {
+            long e = 0;
+            for (; q < end && isDigit(*q); q++)
+            {
+                if (e < 100000) e = e * 10 + (*q - '0');
+            }
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+
+    if (!truncated && mantissa <= (1ull << 24) && exponent >= -10 && exponent <= 10)
+    {
+        const float m = (float)mantissa;
+        value = exponent < 0 ? m / s_float_powers[-exponent] : m * s_float_powers[exponent];
+    }
+    else if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+    {
+        const double m = (double)mantissa;
+        value = (float)(exponent < 0 ? m / s_double_powers[-exponent] : m * s_double_powers[exponent]);
+    }
+    else
+    {
+        char token[64];
+        const size_t length = min((size_t)(p - start), sizeof(token) - 1);
+        memcpy(token, start, length);
+        token[length] = '\0';
+        value = strtof(token, nullptr);
+        return skipSpaces(p, end);
+    }
+    value = negative ? -value : value;
+    return skipSpaces(p, end);
+}
+
+static inline const char * parseIndex(const char * p, const char * end, long & value)
+{
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    value = 0;
+    for (; p < end && isDigit(*p); p++)
+    {
+        value = value * 10 + (*p - '0');
+    }
+    value = negative ? -value : value;
+    return p;
+}
+
+/**
+ * 0 based index of a 1 based or relative OBJ index, relative ones are
+ * returned relative to the chunk and flagged
+ */
+static inline long resolveIndex(long index, size_t count, bool & relative)
+{
+    relative = index < 0;
+    if (index < 0) return (long)count + index;
+    return index - 1;
+}
+
+static void parseFace(OBJChunk & chunk, const char * p, const char * end)
+{
+    vec3i first, previous;
+    bool first_relative[3] = {}, previous_relative[3] = {};
+    bool has_attribute[2] = {};
+    for (size_t corner = 0; ; corner++)
+    {
+        p = skipSpaces(p, end);
+        if (p >= end || *p == '\n' || !(isDigit(*p) || *p == '-'))
+        {
+            break;
+        }
+
+        // v, v/vt, v//vn or v/vt/vn
+        vec3i current;
+        bool relative[3] = {};
+        long index;
+        p = parseIndex(p, end, index);
+        current[0] = resolveIndex(index, chunk.vertices.size(), relative[0]);
+        current[1] = -1;
+        current[2] = -1;
+        if (p < end && *p == '/')
+        {
+            p++;
+            if (p < end && *p != '/')
+            {
+                p = parseIndex(p, end, index);
+                current[1] = resolveIndex(index, chunk.texture_coords.size(), relative[1]);
+            }
+            if (p < end && *p == '/')
+            {
+                p = parseIndex(p + 1, end, index);
+                current[2] = resolveIndex(index, chunk.vertex_normals.size(), relative[2]);
+            }
+        }
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+
+        if (corner == 0)
+        {
+            first = current;
+            memcpy(first_relative, relative, sizeof(relative));
+        }
+        else if (corner >= 2)
+        {
+            // fan around the first corner
+            const vec3i *corners[3] = { &first, &previous, &current };
+            const bool *corner_relative[3] = { first_relative, previous_relative, relative };
+            const size_t fidx = chunk.faces.size();
+            vec3i face, face_texcoord, face_normal;
+            for (size_t k = 0; k < 3; k++)
+            {
+                face[k] = (*corners[k])[0];
+                face_texcoord[k] = (*corners[k])[1];
+                face_normal[k] = (*corners[k])[2];
+                has_attribute[0] = has_attribute[0] || face_texcoord[k] >= 0 || corner_relative[k][1];
+                has_attribute[1] = has_attribute[1] || face_normal[k] >= 0 || corner_relative[k][2];
+                if (corner_relative[k][0]) chunk.fixups.push_back(fidx * OBJ_FIXUP_STRIDE + OBJ_FIXUP_POSITION + k);
+                if (corner_relative[k][1]) chunk.fixups.push_back(fidx * OBJ_FIXUP_STRIDE + OBJ_FIXUP_TEXCOORD + k);
+                if (corner_relative[k][2]) chunk.fixups.push_back(fidx * OBJ_FIXUP_STRIDE + OBJ_FIXUP_NORMAL + k);
+            }
+            chunk.faces.push_back(face);
+
+            // attribute arrays start at the first face having them, earlier faces get -1
+            vec3i missing;
+            missing[0] = missing[1] = missing[2] = -1;
+            if (has_attribute[0] && chunk.face_texcoords.size() == 0)
+            {
+                for (size_t i = 0; i < fidx; i++) chunk.face_texcoords.push_back(missing);
+            }
+            if (chunk.face_texcoords.size() > 0 || has_attribute[0]) chunk.face_texcoords.push_back(face_texcoord);
+            if (has_attribute[1] && chunk.face_normals.size() == 0)
+            {
+                for (size_t i = 0; i < fidx; i++) chunk.face_normals.push_back(missing);
+            }
+            if (chunk.face_normals.size() > 0 || has_attribute[1]) chunk.face_normals.push_back(face_normal);
+        }
+        previous = current;
+        memcpy(previous_relative, relative, sizeof(relative));
+    }
+}
+
+static void parseChunk(size_t chunk_index, size_t thread_index, void * data)
+{
+    __unused_variable(thread_index);
+
+    OBJChunk & chunk = ((OBJChunk*)data)[chunk_index];
+    const char *end = chunk.end;
+    for (const char *p = chunk.begin; p < end; )
+    {
+        p = skipSpaces(p, end);
+        if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            vec3 v;
+            p = parseFloat(p + 2, end, v.x);
+            p = parseFloat(p, end, v.y);
+            p = parseFloat(p, end, v.z);
+            chunk.vertices.push_back(v);
+        }
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+        {
+            vec2 vt;
+            p = parseFloat(p + 3, end, vt.x);
+            p = parseFloat(p, end, vt.y);
+            chunk.texture_coords.push_back(vt);
+        }
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+        {
+            vec3 vn;
+            p = parseFloat(p + 3, end, vn.x);
+            p = parseFloat(p, end, vn.y);
+            p = parseFloat(p, end, vn.z);
+            chunk.vertex_normals.push_back(vn);
+        }
+        else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+        {
+            const char *line_end = p;
+            while (line_end < end && *line_end != '\n') line_end++;
+            parseFace(chunk, p + 2, line_end);
+            p = line_end;
+        }
+        p = skipLine(p, end);
+    }
+}
+
+template<typename T>
+static void copyElements(T * destination, const DynamicArray<T> & source)
+{
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        destination[i] = source[i];
+    }
+}
+
+static void mergeChunk(size_t chunk_index, size_t thread_index, void * data)
+{
+    __unused_variable(thread_index);
+
+    const OBJMergeJob *job = (const OBJMergeJob*)data;
+    const OBJChunk & chunk = job->chunks[chunk_index];
+    const size_t *bases = job->bases + chunk_index * 4;
+    OBJData & out = *job->data;
+
+    copyElements(out.vertices + bases[0], chunk.vertices);
+    copyElements(out.texture_coords + bases[1], chunk.texture_coords);
+    copyElements(out.vertex_normals + bases[2], chunk.vertex_normals);
+
+    vec3i missing;
+    missing[0] = missing[1] = missing[2] = -1;
+    for (size_t fidx = 0; fidx < chunk.faces.size(); fidx++)
+    {
+        out.faces[bases[3] + fidx] = chunk.faces[fidx];
+        if (out.face_texcoords)
+        {
+            out.face_texcoords[bases[3] + fidx] = chunk.face_texcoords.size() > 0 ? chunk.face_texcoords[fidx] : missing;
+        }
+        if (out.face_normals)
+        {
+            out.face_normals[bases[3] + fidx] = chunk.face_normals.size() > 0 ? chunk.face_normals[fidx] : missing;
+        }
+    }
+    for (size_t i = 0; i < chunk.fixups.size(); i++)
+    {
+        const size_t fidx = bases[3] + chunk.fixups[i] / OBJ_FIXUP_STRIDE;
+        const size_t slot = chunk.fixups[i] % OBJ_FIXUP_STRIDE;
+        const size_t k = slot % 3;
+        if (slot < OBJ_FIXUP_TEXCOORD)      out.faces[fidx][k] += bases[0];
+        else if (slot < OBJ_FIXUP_NORMAL)   out.face_texcoords[fidx][k] += bases[1];
+        else                                out.face_normals[fidx][k] += bases[2];
+    }
+}
+
+bool Lurdr::parseOBJ(const char * filename, OBJData & data)
+{
+    memset(&data, 0, sizeof(data));
+
+    MappedFile file(filename);
+    const char *text = (const char*)file.data();
+    if (text == nullptr)
+    {
+        // empty files do not map
+        FILE *fp = fopen(filename, "rb");
+        if (fp == nullptr) return false;
+        fclose(fp);
+        return true;
+    }
+    const char *text_end = text + file.size();
+
+    // line aligned chunks
+    const size_t chunk_count = (file.size() + OBJ_CHUNK_SIZE - 1) / OBJ_CHUNK_SIZE;
+    OBJChunk *chunks = new OBJChunk[chunk_count];
+    const char *begin = text;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        const char *end = min(text + (i + 1) * OBJ_CHUNK_SIZE, text_end);
+        end = begin > end ? begin : end;
+        while (end < text_end && end[-1] != '\n') end++;
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+
+    const size_t thread_count = min((size_t)max(std::thread::hardware_concurrency(), 1u), chunk_count);
+    ThreadPool *thread_pool = thread_count > 1 ? new ThreadPool(thread_count) : nullptr;
+    if (thread_pool) thread_pool->parallelFor(chunk_count, parseChunk, chunks);
+    else for (size_t i = 0; i < chunk_count; i++) parseChunk(i, 0, chunks);
+
+    size_t *bases = new size_t[chunk_count * 4];
+    bool has_face_texcoords = false;
+    bool has_face_normals = false;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        bases[i * 4 + 0] = data.vertex_count;
+        bases[i * 4 + 1] = data.texcoord_count;
+        bases[i * 4 + 2] = data.normal_count;
+        bases[i * 4 + 3] = data.face_count;
+        data.vertex_count += chunks[i].vertices.size();
+        data.texcoord_count += chunks[i].texture_coords.size();
+        data.normal_count += chunks[i].vertex_normals.size();
+        data.face_count += chunks[i].faces.size();
+        has_face_texcoords = has_face_texcoords || chunks[i].face_texcoords.size() > 0;
+        has_face_normals = has_face_normals || chunks[i].face_normals.size() > 0;
+    }
+    if (chunk_count == 1)
+    {
+        // a lone chunk has no bases to add, its arrays are handed over as they are
+        OBJChunk & chunk = chunks[0];
+        if (data.vertex_count > 0)   data.vertices = chunk.vertices.release();
+        if (data.texcoord_count > 0) data.texture_coords = chunk.texture_coords.release();
+        if (data.normal_count > 0)   data.vertex_normals = chunk.vertex_normals.release();
+        if (data.face_count > 0)
+        {
+            data.faces = chunk.faces.release();
+            if (has_face_texcoords) data.face_texcoords = chunk.face_texcoords.release();
+            if (has_face_normals)   data.face_normals = chunk.face_normals.release();
+        }
+        delete thread_pool;
+        delete[] bases;
+        delete[] chunks;
+        return true;
+    }
+
+    if (data.vertex_count > 0)   data.vertices = new vec3[data.vertex_count];
+    if (data.texcoord_count > 0) data.texture_coords = new vec2[data.texcoord_count];
+    if (data.normal_count > 0)   data.vertex_normals = new vec3[data.normal_count];
+    if (data.face_count > 0)
+    {
+        data.faces = new vec3i[data.face_count];
+        if (has_face_texcoords) data.face_texcoords = new vec3i[data.face_count];
+        if (has_face_normals)   data.face_normals = new vec3i[data.face_count];
+    }
+
+    OBJMergeJob merge_job = { chunks, bases, &data };
+    if (thread_pool) thread_pool->parallelFor(chunk_count, mergeChunk, &merge_job);
+    else for (size_t i = 0; i < chunk_count; i++) mergeChunk(i, 0, &merge_job);
+
+    delete thread_pool;
+    delete[] bases;
+    delete[] chunks;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef __OBJPARSER_HPP__
+#define __OBJPARSER_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "global.hpp"
+#include "maths.hpp"
+#include "darray.hpp"
+
+namespace Lurdr
+{
+
+// bytes of the file parsed per task, smaller files are parsed on the calling thread
+#define OBJ_CHUNK_SIZE (1 << 22)
+
+/**
+ * Triangles of a Wavefront OBJ file. Polygons are fan triangulated, indices
+ * are 0 based with relative (negative) ones resolved and -1 marks a corner
+ * without that attribute. face_texcoords and face_normals are nullptr when no
+ * face has the attribute. Arrays are new[] allocated and owned by the caller,
+ * nullptr when empty.
+ */
+struct OBJData
+{
+    vec3    *vertices;
+    vec2    *texture_coords;
+    vec3    *vertex_normals;
+    vec3i   *faces;
+    vec3i   *face_texcoords;
+    vec3i   *face_normals;
+    size_t  vertex_count;
+    size_t  texcoord_count;
+    size_t  normal_count;
+    size_t  face_count;
+};
+
+/**
+ * parse the v, vt, vn and f elements of an OBJ file, everything else is
+ * skipped. Files larger than OBJ_CHUNK_SIZE are split into line aligned
+ * chunks parsed on all hardware threads and merged in file order. Returns
+ * false if the file cannot be read.
+ */
+bool parseOBJ(const char * filename, OBJData & data);
+
+}
+
+#endif
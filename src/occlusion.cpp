@@ -0,0 +1,176 @@
+#include "simd.hpp"
+#include "occlusion.hpp"
+
+using namespace Lurdr;
+
+// clip space w below this counts as crossing the near plane
+#define OCCLUSION_MIN_W 1e-5f
+
+OcclusionBuffer::OcclusionBuffer(long width, long height):
+    m_width(width),
+    m_height(height),
+    m_stride((width + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH),
+    m_clip_vertices(nullptr),
+    m_clip_capacity(0)
+{
+    assert(width > 0 && height > 0);
+    m_storage = new float[m_stride * m_height + SIMD_WIDTH];
+    m_depth_buffer = (float*)(((size_t)m_storage + sizeof(float) * SIMD_WIDTH - 1) & ~(size_t)(sizeof(float) * SIMD_WIDTH - 1));
+    clear();
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+    delete[] m_storage;
+    delete[] m_clip_vertices;
+}
+
+void OcclusionBuffer::clear()
+{
+    const float far_depth = 1.0f;
+    UINT32 bits;
+    memcpy(&bits, &far_depth, sizeof(bits));
+    simdFill32(m_depth_buffer, bits, m_stride * m_height);
+}
+
+static inline float edgeFunction(float ax, float ay, float bx, float by, float px, float py)
+{
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+void OcclusionBuffer::rasterizeOccluder(const TriangleMesh * mesh, const mat4 & mvp)
+{
+    if (m_clip_capacity < mesh->vertexCount())
+    {
+        delete[] m_clip_vertices;
+        m_clip_capacity = mesh->vertexCount();
+        m_clip_vertices = new vec4[m_clip_capacity];
+    }
+
+    // screen position and depth of every vertex, w <= 0 marks vertices at or behind the eye
+    const vec3 *vertices = mesh->getVertices();
+    for (size_t i = 0; i < mesh->vertexCount(); i++)
+    {
+        vec4 p = mvp * vec4(vertices[i].x, vertices[i].y, vertices[i].z, 1.0f);
+        if (p.w < OCCLUSION_MIN_W)
+        {
+            m_clip_vertices[i].w = 0.0f;
+            continue;
+        }
+        const float inv_w = 1.0f / p.w;
+        m_clip_vertices[i] = vec4(
+            (p.x * inv_w * 0.5f + 0.5f) * m_width,
+            (p.y * inv_w * 0.5f + 0.5f) * m_height,
+            p.z * inv_w,
+            p.w);
+    }
+
+    const vec3i *faces = mesh->getFaces();
+    for (size_t f = 0; f < mesh->faceCount(); f++)
+    {
+        const vec4 *a = &m_clip_vertices[faces[f][0]];
+        const vec4 *b = &m_clip_vertices[faces[f][1]];
+        const vec4 *c = &m_clip_vertices[faces[f][2]];
+        if (a->w == 0.0f || b->w == 0.0f || c->w == 0.0f)
+        {
+            continue;
+        }
+
+        // occluders are rasterized double sided, flip to counter-clockwise
+        float area = edgeFunction(a->x, a->y, b->x, b->y, c->x, c->y);
+        if (area < 0.0f)
+        {
+            const vec4 *t = b;
+            b = c;
+            c = t;
+            area = -area;
+        }
+        if (area <= 0.0f)
+        {
+            continue;
+        }
+        const float inv_area = 1.0f / area;
+
+        const long x_min = max((long)floorf(min(a->x, min(b->x, c->x))), 0L);
+        const long x_max = min((long)ceilf(max(a->x, max(b->x, c->x))), m_width - 1);
+        const long y_min = max((long)floorf(min(a->y, min(b->y, c->y))), 0L);
+        const long y_max = min((long)ceilf(max(a->y, max(b->y, c->y))), m_height - 1);
+        for (long y = y_min; y <= y_max; y++)
+        {
+            float *row = m_depth_buffer + y * m_stride;
+            const float py = y + 0.5f;
+            for (long x = x_min; x <= x_max; x++)
+            {
+                const float px = x + 0.5f;
+                const float w0 = edgeFunction(b->x, b->y, c->x, c->y, px, py);
+                const float w1 = edgeFunction(c->x, c->y, a->x, a->y, px, py);
+                const float w2 = edgeFunction(a->x, a->y, b->x, b->y, px, py);
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                {
+                    continue;
+                }
+                // z / w is affine in screen space
+                const float z = (w0 * a->z + w1 * b->z + w2 * c->z) * inv_area;
+                if (z >= 0.0f && z <= 1.0f && z < row[x])
+                {
+                    row[x] = z;
+                }
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::testBounds(const BoundingBox & bbox, const mat4 & mvp) const
+{
+    float x_min = FLT_MAX, y_min = FLT_MAX, z_min = FLT_MAX;
+    float x_max = -FLT_MAX, y_max = -FLT_MAX;
+    for (int i = 0; i < 8; i++)
+    {
+        const vec4 p = mvp * vec4(
+            (i & 1) ? bbox.max_x : bbox.min_x,
+            (i & 2) ? bbox.max_y : bbox.min_y,
+            (i & 4) ? bbox.max_z : bbox.min_z,
+            1.0f);
+        if (p.w < OCCLUSION_MIN_W)
+        {
+            return true;
+        }
+        const float inv_w = 1.0f / p.w;
+        x_min = min(x_min, p.x * inv_w);
+        x_max = max(x_max, p.x * inv_w);
+        y_min = min(y_min, p.y * inv_w);
+        y_max = max(y_max, p.y * inv_w);
+        z_min = min(z_min, p.z * inv_w);
+    }
+    if (z_min < 0.0f)
+    {
+        return true;
+    }
+
+    // pixels whose centers might be covered, one extra pixel around for safety
+    const long x0 = max((long)floorf((x_min * 0.5f + 0.5f) * m_width) - 1, 0L);
+    const long x1 = min((long)ceilf((x_max * 0.5f + 0.5f) * m_width) + 1, m_width - 1);
+    const long y0 = max((long)floorf((y_min * 0.5f + 0.5f) * m_height) - 1, 0L);
+    const long y1 = min((long)ceilf((y_max * 0.5f + 0.5f) * m_height) + 1, m_height - 1);
+    if (x0 > x1 || y0 > y1)
+    {
+        return true;
+    }
+
+    // visible as soon as one pixel of the rectangle is farther than the box,
+    // rows are tested in aligned SIMD_WIDTH spans, the padding is far depth
+    const simd_float box_depth = simdSet(z_min);
+    const long span_begin = x0 / SIMD_WIDTH * SIMD_WIDTH;
+    for (long y = y0; y <= y1; y++)
+    {
+        const float *row = m_depth_buffer + y * m_stride;
+        for (long x = span_begin; x <= x1; x += SIMD_WIDTH)
+        {
+            if (simdAnyLess(box_depth, simdLoad(row + x)))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef __OCCLUSION_HPP__
+#define __OCCLUSION_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <float.h>
+#include "global.hpp"
+#include "maths.hpp"
+#include "mesh.hpp"
+
+namespace Lurdr
+{
+
+#define OCCLUSION_BUFFER_WIDTH 256
+#define OCCLUSION_BUFFER_HEIGHT 128
+
+/**
+ * Small software depth buffer for occlusion culling. Occluder meshes are
+ * rasterized into it with the depth convention of the pipeline (z / w in
+ * [0, 1], smaller is closer), then the screen bounds of other meshes are
+ * tested against it SIMD_WIDTH pixels at a time. Rows are padded to
+ * SIMD_WIDTH and aligned, any resolution maps to the whole view.
+ */
+class OcclusionBuffer
+{
+private:
+    long    m_width;
+    long    m_height;
+    long    m_stride;           // floats per row, a multiple of SIMD_WIDTH
+    float   *m_storage;
+    float   *m_depth_buffer;
+    vec4    *m_clip_vertices;   // scratch for rasterizeOccluder
+    size_t  m_clip_capacity;
+
+public:
+    OcclusionBuffer(long width = OCCLUSION_BUFFER_WIDTH, long height = OCCLUSION_BUFFER_HEIGHT);
+    ~OcclusionBuffer();
+
+    OcclusionBuffer(const OcclusionBuffer &) = delete;
+    OcclusionBuffer& operator= (const OcclusionBuffer &) = delete;
+
+    long getWidth() const { return m_width; }
+    long getHeight() const { return m_height; }
+    long getStride() const { return m_stride; }
+    const float * depthBuffer() const { return m_depth_buffer; }
+
+    void clear();
+
+    /**
+     * rasterize both sides of every triangle of mesh, triangles crossing the
+     * near plane are skipped so occlusion stays conservative
+     */
+    void rasterizeOccluder(const TriangleMesh * mesh, const mat4 & mvp);
+
+    /**
+     * false only if the model space bbox is certainly hidden behind the
+     * occluders, boxes crossing the near plane or off screen always pass
+     */
+    bool testBounds(const BoundingBox & bbox, const mat4 & mvp) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "parallel.hpp"
+
+using namespace Lurdr;
+
+struct Lurdr::ThreadPoolContext
+{
+    std::thread             *workers;
+    std::mutex              mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+
+    // current job, guarded by mutex except for the atomic counters
+    PARALLEL_TASK(task);
+    void                    *data;
+    size_t                  task_count;
+    std::atomic<size_t>     next_task;
+    size_t                  busy_workers;
+    size_t                  generation;
+    bool                    terminate;
+};
+
+static void runTasks(ThreadPoolContext * context, size_t thread_index)
+{
+    while (true)
+    {
+        size_t task_index = context->next_task.fetch_add(1);
+        if (task_index >= context->task_count)
+        {
+            return;
+        }
+        context->task(task_index, thread_index, context->data);
+    }
+}
+
+static void workerLoop(ThreadPoolContext * context, size_t thread_index)
+{
+    size_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(context->mutex);
+            context->job_ready.wait(lock, [&] {
+                return context->terminate || context->generation != generation;
+            });
+            if (context->terminate)
+            {
+                return;
+            }
+            generation = context->generation;
+        }
+
+        runTasks(context, thread_index);
+
+        {
+            std::unique_lock<std::mutex> lock(context->mutex);
+            context->busy_workers--;
+            if (context->busy_workers == 0)
+            {
+                context->job_done.notify_one();
+            }
+        }
+    }
+}
+
+ThreadPool::ThreadPool(size_t thread_count):
+    m_thread_count(thread_count > 0 ? thread_count : 1)
+{
+    m_context = new ThreadPoolContext();
+    m_context->workers = nullptr;
+    m_context->task = nullptr;
+    m_context->data = nullptr;
+    m_context->task_count = 0;
+    m_context->next_task = 0;
+    m_context->busy_workers = 0;
+    m_context->generation = 0;
+    m_context->terminate = false;
+
+    if (m_thread_count > 1)
+    {
+        m_context->workers = new std::thread[m_thread_count - 1];
+        for (size_t i = 0; i < m_thread_count - 1; i++)
+        {
+            m_context->workers[i] = std::thread(workerLoop, m_context, i + 1);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        m_context->terminate = true;
+    }
+    m_context->job_ready.notify_all();
+
+    for (size_t i = 0; i + 1 < m_thread_count; i++)
+    {
+        m_context->workers[i].join();
+    }
+    delete[] m_context->workers;
+    delete m_context;
+}
+
+void ThreadPool::parallelFor(size_t task_count, PARALLEL_TASK(task), void * data)
+{
+    if (task_count == 0)
+    {
+        return;
+    }
+
+    if (m_thread_count == 1 || task_count == 1)
+    {
+        for (size_t i = 0; i < task_count; i++)
+        {
+            task(i, 0, data);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        m_context->task = task;
+        m_context->data = data;
+        m_context->task_count = task_count;
+        m_context->next_task = 0;
+        m_context->busy_workers = m_thread_count - 1;
+        m_context->generation++;
+    }
+    m_context->job_ready.notify_all();
+
+    runTasks(m_context, 0);
+
+    std::unique_lock<std::mutex> lock(m_context->mutex);
+    m_context->job_done.wait(lock, [&] {
+        return m_context->busy_workers == 0;
+    });
+}
@@ -0,0 +1,46 @@
+#ifndef __PARALLEL_HPP__
+#define __PARALLEL_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "global.hpp"
+
+namespace Lurdr
+{
+
+#define PARALLEL_TASK(name) void(*name)(size_t,size_t,void*)
+
+struct ThreadPoolContext;
+
+/**
+ * A fixed pool of worker threads running parallel-for style jobs.
+ * The calling thread always takes part in the job as thread 0, so a pool
+ * of N threads spawns N - 1 workers.
+ */
+class ThreadPool
+{
+private:
+    size_t              m_thread_count;
+    ThreadPoolContext   *m_context;
+
+public:
+    ThreadPool() = delete;
+    ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool& operator= (const ThreadPool &) = delete;
+
+    size_t getThreadCount() const { return m_thread_count; }
+
+    /**
+     * run task(task_index, thread_index, data) for task_index in [0, task_count)
+     * and block until every task has finished, tasks are handed out in order
+     */
+    void parallelFor(size_t task_count, PARALLEL_TASK(task), void * data);
+};
+
+}
+
+#endif
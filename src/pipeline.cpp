@@ -1,10 +1,30 @@
+#include <typeinfo>
 #include "pipeline.hpp"
+#include "occlusion.hpp"
+#include "streaming.hpp"
+#include "misc.hpp"
 
 using namespace Lurdr;
 
 // #define _FLAT_FILL_TRIANGLE_RASTERIZATION_
 // #define _BARYCENTRIC_TRIANGLE_RASTERIZATION_0_
 #define _BARYCENTRIC_TRIANGLE_RASTERIZATION_1_
+// step edge functions along scanlines and trivially accept/reject 8x8 blocks,
+// comment out to fall back to the per-pixel edge function loop for A/B comparison
+#define _INCREMENTAL_EDGE_RASTERIZATION_
+// collect fragments into SoA batches for Shader::fragBatch instead of calling
+// Shader::frag per pixel, comment out to shade every fragment immediately
+#define _BATCH_FRAGMENT_SHADING_
+// instantiate the pipeline per built-in shader type and render state,
+// comment out to always run the generic (virtual Shader) instantiation
+#define _SPECIALIZED_PIPELINE_
+
+// blocks line up with the tiles of the coarse depth buffer so a block can be
+// culled or accepted against a single tile min/max
+#define RASTER_BLOCK_SIZE DEPTH_TILE_SIZE
+// relative margin on interpolated depth bounds, covers the rounding difference
+// between block corners and per-pixel incremental edge functions
+#define HIERARCHICAL_DEPTH_EPSILON 1e-4f
 
 #define WIREFRAME_EPSILON 0.5f
 
@@ -14,253 +34,961 @@ static inline float edgeFunction(const vec3 & a, const vec3 & b, const vec3 & c)
     return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
 }
 
+/**
+ * Sort-middle multithread rasterization
+ * triangles are set up once on the calling thread, binned into TILE_SIZE x TILE_SIZE
+ * screen tiles, then every tile is rasterized and shaded by exactly one worker thread,
+ * so color and depth buffers need no locks. Triangles of a tile keep their submission
+ * order, the result is identical to the single thread path.
+ */
+struct RasterTriangle
+{
+    v2f             v0;
+    v2f             v1;
+    v2f             v2;
+    const Entity    *entity;
+    long            x_min;
+    long            x_max;
+    long            y_min;
+    long            y_max;
+};
+
+// triangles of one tile in submission order, a chain of blocks in the frame arena
+struct TileBinBlock
+{
+    TileBinBlock            *next;
+    size_t                  count;
+    const RasterTriangle    *triangles[TILE_BIN_BLOCK_SIZE];
+};
+
+struct TileBin
+{
+    TileBinBlock    *first;
+    TileBinBlock    *last;
+};
+
+struct TileJob
+{
+    const FrameBuffer   *frame_buffer;
+    const Scene         *scene;
+    const Shader        *shader;
+    long                tile_count_x;
+};
+
+struct ResolveJob
+{
+    const FrameBuffer   *frame_buffer;
+    const Scene         *scene;
+    const Shader        *shader;
+};
+
+struct VertexJob
+{
+    const TriangleMesh  *mesh;
+    const Entity        *entity;
+    const Scene         *scene;
+    const Shader        *shader;
+    const vdata         *uniform;
+    const UINT32        *meshlets;  // one chunk per visible meshlet, nullptr for all unique vertices
+};
+
+// mesh drawn for an entity this frame, a streaming mesh gives one per chunk
+struct DrawItem
+{
+    const Entity        *entity;
+    const TriangleMesh  *mesh;
+    size_t              entity_index;
+};
+
+// arenas of a thread, padded so that threads do not share a cache line
+struct ThreadArena
+{
+    FrameArena          arena;
+    char                padding[64];
+};
+
+static ThreadPool                       *s_thread_pool = nullptr;
+static FrameArena                       s_frame_arena;
+static ThreadArena                      *s_thread_arenas = nullptr;
+static long                             s_thread_arena_count = 0;
+static v2f                              *s_transformed_vertices = nullptr;
+static TileBin                          *s_tile_bins = nullptr;
+static long                             s_tile_bin_count = 0;
+static PipelinePassTimings              s_pass_timings = { 0.0, 0.0, 0.0 };
+static PipelineStatistics               s_statistics;
+static OcclusionBuffer                  *s_occlusion_buffer = nullptr;
+static DynamicArray<bool>               s_entity_occluded;
+static UINT32                           *s_visible_meshlets = nullptr;
+static size_t                           s_visible_meshlet_count = 0;
+static DynamicArray<DrawItem>           s_draw_items;
+
+#ifdef _PIPELINE_STATISTICS_
+#define PIPELINE_STATISTICS(x) x
+
+// statistics of one thread, padded so that threads do not share a cache line
+struct ThreadStatistics
+{
+    PipelineStatistics  statistics;
+    char                padding[64];
+};
+
+static ThreadStatistics                 *s_thread_statistics = nullptr;
+static long                             s_thread_statistics_count = 0;
+// slot of the running thread, bound by the entry point of every task
+static thread_local PipelineStatistics  *t_statistics = nullptr;
+// time taken by StageTimers nested in the innermost running one
+static thread_local double              t_nested_ms = 0.0;
+
+/**
+ * add the time of the enclosing scope minus the time of nested StageTimers
+ * to target, so every stage gets exclusive time
+ */
+class StageTimer
+{
+private:
+    double  *m_target;
+    double  m_start;
+    double  m_outer_nested_ms;
+public:
+    StageTimer(double * target):
+        m_target(target),
+        m_start(getTimeMilliseconds()),
+        m_outer_nested_ms(t_nested_ms)
+    {
+        t_nested_ms = 0.0;
+    }
+    ~StageTimer()
+    {
+        const double elapsed = getTimeMilliseconds() - m_start;
+        *m_target += elapsed - t_nested_ms;
+        t_nested_ms = m_outer_nested_ms + elapsed;
+    }
+};
+
+static void bindThreadStatistics(size_t thread_index)
+{
+    t_statistics = &s_thread_statistics[thread_index].statistics;
+}
+
+static void resetStatistics(long thread_count)
+{
+    if (thread_count != s_thread_statistics_count)
+    {
+        delete[] s_thread_statistics;
+        s_thread_statistics = new ThreadStatistics[thread_count];
+        s_thread_statistics_count = thread_count;
+    }
+    memset(s_thread_statistics, 0, sizeof(ThreadStatistics) * thread_count);
+    // the calling thread is thread 0 of the thread pool
+    bindThreadStatistics(0);
+}
+
+static void gatherStatistics()
+{
+    memset(&s_statistics, 0, sizeof(PipelineStatistics));
+    for (long i = 0; i < s_thread_statistics_count; i++)
+    {
+        const PipelineStatistics & t = s_thread_statistics[i].statistics;
+        s_statistics.entities_frustum_culled += t.entities_frustum_culled;
+        s_statistics.entities_occlusion_culled += t.entities_occlusion_culled;
+        s_statistics.meshlets_culled += t.meshlets_culled;
+        s_statistics.vertices_shaded += t.vertices_shaded;
+        s_statistics.triangles_submitted += t.triangles_submitted;
+        s_statistics.triangles_frustum_culled += t.triangles_frustum_culled;
+        s_statistics.triangles_backface_culled += t.triangles_backface_culled;
+        s_statistics.triangles_rasterized += t.triangles_rasterized;
+        s_statistics.fragments_tested += t.fragments_tested;
+        s_statistics.fragments_depth_rejected += t.fragments_depth_rejected;
+        s_statistics.fragments_shaded += t.fragments_shaded;
+        s_statistics.pixels_written += t.pixels_written;
+        s_statistics.clear_ms += t.clear_ms;
+        s_statistics.vertex_ms += t.vertex_ms;
+        s_statistics.setup_ms += t.setup_ms;
+        s_statistics.raster_ms += t.raster_ms;
+        s_statistics.fragment_ms += t.fragment_ms;
+    }
+}
+#else
+#define PIPELINE_STATISTICS(x)
+#endif
+
+// bound by the draw and the entry point of every task
+static void bindPoolArena(size_t thread_index)
+{
+    bindThreadArena(&s_thread_arenas[thread_index].arena);
+}
+
+// release the transient data of the last frame, every thread of the pool gets an arena
+static void resetArenas(long thread_count)
+{
+    if (thread_count != s_thread_arena_count)
+    {
+        delete[] s_thread_arenas;
+        s_thread_arenas = new ThreadArena[thread_count];
+        s_thread_arena_count = thread_count;
+    }
+    beginArenaFrame();
+    s_frame_arena.reset();
+    for (long i = 0; i < s_thread_arena_count; i++)
+    {
+        s_thread_arenas[i].arena.reset();
+    }
+    // the calling thread is thread 0 of the thread pool
+    bindPoolArena(0);
+}
+
+static ThreadPool * getThreadPool(long thread_count)
+{
+    if (s_thread_pool == nullptr || s_thread_pool->getThreadCount() != (size_t)thread_count)
+    {
+        delete s_thread_pool;
+        s_thread_pool = new ThreadPool(thread_count);
+    }
+    return s_thread_pool;
+}
+
+static void binTriangle(const FrameBuffer & frame_buffer, const RasterTriangle & triangle)
+{
+    if (triangle.x_min >= triangle.x_max || triangle.y_min >= triangle.y_max)
+    {
+        return;
+    }
+
+    const long tile_count_x = (frame_buffer.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+    const RasterTriangle *stored = s_frame_arena.make<RasterTriangle>(triangle);
+
+    for (long ty = triangle.y_min / TILE_SIZE; ty <= (triangle.y_max - 1) / TILE_SIZE; ty++)
+    {
+        for (long tx = triangle.x_min / TILE_SIZE; tx <= (triangle.x_max - 1) / TILE_SIZE; tx++)
+        {
+            TileBin & bin = s_tile_bins[ty * tile_count_x + tx];
+            if (bin.last == nullptr || bin.last->count == TILE_BIN_BLOCK_SIZE)
+            {
+                TileBinBlock *block = s_frame_arena.make<TileBinBlock>();
+                block->next = nullptr;
+                block->count = 0;
+                if (bin.last) bin.last->next = block;
+                else          bin.first = block;
+                bin.last = block;
+            }
+            bin.last->triangles[bin.last->count++] = stored;
+        }
+    }
+}
+
+// qualified calls bind to the implementation of S at compile time,
+// the generic Shader instantiation goes through the vtable
+template<typename S>
+static inline v2f shaderVert(const S * shader, const vdata & in, const Entity * entity, const Scene & scene)
+{
+    return shader->S::vert(in, entity, scene);
+}
+template<>
+inline v2f shaderVert<Shader>(const Shader * shader, const vdata & in, const Entity * entity, const Scene & scene)
+{
+    return shader->vert(in, entity, scene);
+}
+
+template<typename S>
+static inline vec4 shaderFrag(const S * shader, const v2f & in, const Entity * entity, const Scene & scene)
+{
+    return shader->S::frag(in, entity, scene);
+}
+template<>
+inline vec4 shaderFrag<Shader>(const Shader * shader, const v2f & in, const Entity * entity, const Scene & scene)
+{
+    return shader->frag(in, entity, scene);
+}
+
+template<typename S>
+static inline void shaderFragBatch(const S * shader, const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene)
+{
+    shader->S::fragBatch(in, out, entity, scene);
+}
+template<>
+inline void shaderFragBatch<Shader>(const Shader * shader, const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene)
+{
+    shader->fragBatch(in, out, entity, scene);
+}
+
+/**
+ * pick the pipeline instantiation once per draw: built-in shaders (matched by
+ * exact type, so subclasses stay generic) get their own instantiation, render
+ * state flags of Global become compile-time constants
+ */
 void Pipeline::draw(const FrameBuffer & frame_buffer, const Scene & scene, const Shader * shader)
 {
-    // scene.sortEntity();
-    frame_buffer.clearDepthBuffer(1.0f);
+    UINT32 state = 0;
+    if (Singleton<Global>::get().depth_test)
+    {
+        state |= RENDER_STATE_DEPTH_TEST;
+    }
+    if (Singleton<Global>::get().wireframe_mode)
+    {
+        state |= RENDER_STATE_WIREFRAME;
+    }
+    if (Singleton<Global>::get().backface_culling)
+    {
+        state |= RENDER_STATE_BACKFACE_CULLING;
+    }
+    if (Singleton<Global>::get().deferred_shading && !Singleton<Global>::get().wireframe_mode)
+    {
+        state |= RENDER_STATE_DEFERRED;
+    }
+
+    s_pass_timings.depth_prepass = 0.0;
+    s_pass_timings.deferred_resolve = 0.0;
+    resetArenas(Singleton<Global>::get().thread_count);
+    PIPELINE_STATISTICS(resetStatistics(Singleton<Global>::get().thread_count));
+    selectEntityLods(scene);
+    cullOccludedEntities(scene);
+    gatherDrawItems(frame_buffer, scene);
+
+    // transformed vertex and visible meshlet buffers for the largest mesh, shared by the passes
+    size_t vertex_capacity = 0;
+    size_t meshlet_capacity = 0;
+    for (size_t iidx = 0; iidx < s_draw_items.size(); iidx++)
+    {
+        const TriangleMesh *mesh = s_draw_items[iidx].mesh;
+        vertex_capacity = max(vertex_capacity, mesh->hasMeshlets() ? mesh->meshletVertexCount() : mesh->uniqueVertexCount());
+        meshlet_capacity = max(meshlet_capacity, mesh->meshletCount());
+    }
+    s_transformed_vertices = (v2f*)s_frame_arena.allocate(sizeof(v2f) * vertex_capacity, alignof(v2f));
+    s_visible_meshlets = (UINT32*)s_frame_arena.allocate(sizeof(UINT32) * meshlet_capacity, alignof(UINT32));
+
+    // Depth Prepass : lay down the final depth first, then shade only the
+    // fragments whose depth equals it, so every visible pixel is shaded once
+    const bool depth_prepass = Singleton<Global>::get().depth_prepass &&
+        (state & (RENDER_STATE_DEPTH_TEST | RENDER_STATE_WIREFRAME | RENDER_STATE_DEFERRED)) == RENDER_STATE_DEPTH_TEST;
+    if (depth_prepass)
+    {
+        const double prepass_start = getTimeMilliseconds();
+        drawShader(frame_buffer, scene, shader, state | RENDER_STATE_DEPTH_ONLY);
+        s_pass_timings.depth_prepass = getTimeMilliseconds() - prepass_start;
+        state |= RENDER_STATE_DEPTH_EQUAL;
+    }
+
+    const double main_start = getTimeMilliseconds();
+    drawShader(frame_buffer, scene, shader, state);
+    s_pass_timings.main = getTimeMilliseconds() - main_start - s_pass_timings.deferred_resolve;
+    PIPELINE_STATISTICS(gatherStatistics());
+}
+
+const PipelinePassTimings & Pipeline::getPassTimings()
+{
+    return s_pass_timings;
+}
+
+const PipelineStatistics & Pipeline::getStatistics()
+{
+    return s_statistics;
+}
+
+bool Pipeline::isEntityOccluded(size_t entity_index)
+{
+    return entity_index < s_entity_occluded.size() && s_entity_occluded[entity_index];
+}
+
+const OcclusionBuffer * Pipeline::getOcclusionBuffer()
+{
+    return s_occlusion_buffer;
+}
+
+FrameArena & Pipeline::getFrameArena()
+{
+    return s_frame_arena;
+}
+
+FrameArenaStatistics Pipeline::getArenaStatistics()
+{
+    FrameArenaStatistics statistics = s_frame_arena.getStatistics();
+    for (long i = 0; i < s_thread_arena_count; i++)
+    {
+        const FrameArenaStatistics & t = s_thread_arenas[i].arena.getStatistics();
+        statistics.used += t.used;
+        statistics.peak += t.peak;
+        statistics.capacity += t.capacity;
+        statistics.block_allocations += t.block_allocations;
+    }
+    return statistics;
+}
+
+/**
+ * Level of Detail : every entity picks the level of its mesh from the screen
+ * size of the full mesh bounds once per frame, occluders stay full meshes
+ */
+void Pipeline::selectEntityLods(const Scene & scene)
+{
+    const mat4 view_projection = scene.getCamera().getProjectMatrix() * scene.getCamera().getViewMatrix();
+    const DynamicArray<Entity*>* entities = scene.getEntities();
+    for (size_t eidx = 0; eidx < entities->size(); eidx++)
+    {
+        Entity *entity = (*entities)[eidx];
+        const TriangleMesh *mesh = entity->getTriangleMesh();
+        // occluders rasterize the full mesh, a coarser level could cover what it does not
+        if (mesh && mesh->lodCount() > 1 && !entity->isOccluder())
+        {
+            entity->selectLod(projectScreenSize(mesh->getAxisAlignBoundingBox(), view_projection * entity->getTransform()));
+        }
+    }
+}
 
+/**
+ * Occlusion Culling : rasterize the occluder entities into a small depth
+ * buffer, then test the bounds of every other entity against it
+ */
+void Pipeline::cullOccludedEntities(const Scene & scene)
+{
     const DynamicArray<Entity*>* entities = scene.getEntities();
+    s_entity_occluded.clear();
+    for (size_t eidx = 0; eidx < entities->size(); eidx++)
+    {
+        s_entity_occluded.push_back(false);
+    }
+    if (!Singleton<Global>::get().occlusion_culling)
+    {
+        return;
+    }
+    if (s_occlusion_buffer == nullptr)
+    {
+        s_occlusion_buffer = new OcclusionBuffer();
+    }
+    s_occlusion_buffer->clear();
+
+    PIPELINE_STATISTICS(StageTimer timer(&t_statistics->setup_ms));
+    const mat4 view_projection = scene.getCamera().getProjectMatrix() * scene.getCamera().getViewMatrix();
+    bool has_occluder = false;
     for (size_t eidx = 0; eidx < entities->size(); eidx++)
     {
         const Entity *entity = (*entities)[eidx];
-        const mat4 mvp_matrix = scene.getCamera().getProjectMatrix() * scene.getCamera().getViewMatrix() * entity->getTransform();
-        const mat3 model_inv_transpose = mat3(entity->getTransform().inversed().transposed());
+        if (entity->isOccluder() && entity->getTriangleMesh())
+        {
+            s_occlusion_buffer->rasterizeOccluder(entity->getTriangleMesh(), view_projection * entity->getTransform());
+            has_occluder = true;
+        }
+    }
+    if (!has_occluder)
+    {
+        return;
+    }
 
-        const TriangleMesh *mesh = entity->getTriangleMesh();
-        for (size_t fidx = 0; fidx < mesh->faceCount(); fidx++)
+    for (size_t eidx = 0; eidx < entities->size(); eidx++)
+    {
+        const Entity *entity = (*entities)[eidx];
+        if (!entity->isOccluder() && entity->getStreamingMesh())
         {
-#if 0
-            vdata vd0 = TRIANGLE_VDATA(fidx, 0);
-            vdata vd1 = TRIANGLE_VDATA(fidx, 1);
-            vdata vd2 = TRIANGLE_VDATA(fidx, 2);
-            vd0.position.print();
-            vd1.position.print();
-            vd2.position.print();
-            printf("----------------------------------------------\n");
-#endif
-            // Assembly Stage
-            v2f v0 = shader->vert(TRIANGLE_VDATA(fidx, 0), entity, scene);
-            v2f v1 = shader->vert(TRIANGLE_VDATA(fidx, 1), entity, scene);
-            v2f v2 = shader->vert(TRIANGLE_VDATA(fidx, 2), entity, scene);
-#if 0
-            v0.position.print();
-            v1.position.print();
-            v2.position.print();
-            printf("----------------------------------------------\n");
-#endif
-            v0.t_normal = model_inv_transpose * TRIANGLE_TRIANGLE_NORMAL(fidx);
-            v1.t_normal = model_inv_transpose * TRIANGLE_TRIANGLE_NORMAL(fidx);
-            v2.t_normal = model_inv_transpose * TRIANGLE_TRIANGLE_NORMAL(fidx);
-
-            // Perspective Division
-            PERSPECTIVE_DIVIDE(v0.position);
-            PERSPECTIVE_DIVIDE(v1.position);
-            PERSPECTIVE_DIVIDE(v2.position);
-            
-            // Triangle Screen Clipping
-            if ((v0.position.x < -1.0f && v1.position.x < -1.0f && v2.position.x < -1.0f) ||
-                (v0.position.x >  1.0f && v1.position.x >  1.0f && v2.position.x >  1.0f) ||
-                (v0.position.y < -1.0f && v1.position.y < -1.0f && v2.position.y < -1.0f) ||
-                (v0.position.y >  1.0f && v1.position.y >  1.0f && v2.position.y >  1.0f) ||
-                (v0.position.z <  0.0f && v1.position.z <  0.0f && v2.position.z <  0.0f) || // Near/Far Plane Clipping
-                (v0.position.z >  1.0f && v1.position.z >  1.0f && v2.position.z >  1.0f))
+            s_entity_occluded[eidx] = !s_occlusion_buffer->testBounds(
+                entity->getStreamingMesh()->getAxisAlignBoundingBox(), view_projection * entity->getTransform());
+        }
+        else if (!entity->isOccluder() && entity->getTriangleMesh())
+        {
+            s_entity_occluded[eidx] = !s_occlusion_buffer->testBounds(
+                entity->getTriangleMesh()->getAxisAlignBoundingBox(), view_projection * entity->getTransform());
+        }
+    }
+}
+
+/**
+ * Streaming : streaming meshes read the chunks they need once per frame,
+ * occluded ones read nothing, every pass draws the same meshes
+ */
+void Pipeline::gatherDrawItems(const FrameBuffer & frame_buffer, const Scene & scene)
+{
+    PIPELINE_STATISTICS(StageTimer timer(&t_statistics->setup_ms));
+    const mat4 view_projection = scene.getCamera().getProjectMatrix() * scene.getCamera().getViewMatrix();
+    const DynamicArray<Entity*>* entities = scene.getEntities();
+    s_draw_items.clear();
+    for (size_t eidx = 0; eidx < entities->size(); eidx++)
+    {
+        Entity *entity = (*entities)[eidx];
+        StreamingMesh *streaming_mesh = entity->getStreamingMesh();
+        if (streaming_mesh == nullptr)
+        {
+            if (entity->getLodMesh())
             {
-                continue;
+                const DrawItem item = { entity, entity->getLodMesh(), eidx };
+                s_draw_items.push_back(item);
             }
+            continue;
+        }
+        if (s_entity_occluded[eidx])
+        {
+            PIPELINE_STATISTICS(t_statistics->entities_occlusion_culled++);
+            continue;
+        }
+        streaming_mesh->update(view_projection * entity->getTransform(), (float)frame_buffer.getHeight());
+        for (size_t i = 0; i < streaming_mesh->drawCount(); i++)
+        {
+            const DrawItem item = { entity, streaming_mesh->getDrawMesh(i), eidx };
+            s_draw_items.push_back(item);
+        }
+    }
+}
 
-            if (Singleton<Global>::get().backface_culling && !Singleton<Global>::get().wireframe_mode) { // Back-face Culling
-                vec3 u = vec3(v1.position - v0.position);
-                vec3 v = vec3(v2.position - v0.position);
-                vec3 face_normal = u.cross(v);
+void Pipeline::drawStatistics(const FrameBuffer & frame_buffer, float x, float y, float size, const RGBCOLOR & color)
+{
+    const PipelineStatistics & st = s_statistics;
+    const char *labels[] = {
+        "ENTITIES CULLED", "OCCLUDED", "MESHLETS CULLED", "VERTICES", "TRIANGLES", "FRUSTUM CULLED", "BACKFACE CULLED", "RASTERIZED",
+        "FRAGMENTS", "DEPTH REJECTED", "SHADED", "PIXELS",
+        "CLEAR US", "VERTEX US", "SETUP US", "RASTER US", "FRAGMENT US",
+        "ARENA PEAK KB", "ARENA ALLOCS"
+    };
+    const FrameArenaStatistics arena = getArenaStatistics();
+    const long values[] = {
+        st.entities_frustum_culled, st.entities_occlusion_culled, st.meshlets_culled, st.vertices_shaded, st.triangles_submitted, st.triangles_frustum_culled,
+        st.triangles_backface_culled, st.triangles_rasterized,
+        st.fragments_tested, st.fragments_depth_rejected, st.fragments_shaded, st.pixels_written,
+        (long)(st.clear_ms * 1e3), (long)(st.vertex_ms * 1e3), (long)(st.setup_ms * 1e3),
+        (long)(st.raster_ms * 1e3), (long)(st.fragment_ms * 1e3),
+        (long)(arena.peak >> 10), arena.block_allocations
+    };
+    // labels are at most 16 characters wide, a character advances 1.5 size
+    const float value_x = x + 17.0f * size * 1.5f;
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        const float line_y = y + i * size * 2.5f;
+        drawString(frame_buffer, x, line_y, labels[i], size, color);
+        drawInteger(frame_buffer, value_x, line_y, values[i], size, color);
+    }
+}
 
-                if (face_normal.z < 0.0f)
-                {
-                    continue;
-                }
-            }
+/**
+ * collect the meshlets of mesh that might produce a triangle into s_visible_meshlets
+ * and return their vertex count. Spheres are tested against the view volume planes
+ * taken from the rows of mvp, cones against the eye position in model space.
+ */
+static size_t cullMeshlets(const TriangleMesh * mesh, const mat4 & mvp, const vec3 & eye, bool test_frustum, bool test_cone)
+{
+    vec4 planes[6];
+    const vec4 row_x(mvp.m[0], mvp.m[1], mvp.m[2], mvp.m[3]);
+    const vec4 row_y(mvp.m[4], mvp.m[5], mvp.m[6], mvp.m[7]);
+    const vec4 row_z(mvp.m[8], mvp.m[9], mvp.m[10], mvp.m[11]);
+    const vec4 row_w(mvp.m[12], mvp.m[13], mvp.m[14], mvp.m[15]);
+    planes[0] = row_w + row_x;
+    planes[1] = row_w - row_x;
+    planes[2] = row_w + row_y;
+    planes[3] = row_w - row_y;
+    planes[4] = row_z;
+    planes[5] = row_w - row_z;
+    float plane_scales[6];
+    for (int i = 0; i < 6; i++)
+    {
+        plane_scales[i] = vec3(planes[i].x, planes[i].y, planes[i].z).length();
+    }
 
-#ifdef _BARYCENTRIC_TRIANGLE_RASTERIZATION_0_
-            v0.position.x = SCREEN_MAPPING_X(v0.position.x, frame_buffer);
-            v1.position.x = SCREEN_MAPPING_X(v1.position.x, frame_buffer);
-            v2.position.x = SCREEN_MAPPING_X(v2.position.x, frame_buffer);
-            v0.position.y = SCREEN_MAPPING_Y(v0.position.y, frame_buffer);
-            v1.position.y = SCREEN_MAPPING_Y(v1.position.y, frame_buffer);
-            v2.position.y = SCREEN_MAPPING_Y(v2.position.y, frame_buffer);
-
-            // Preconpute Affine transform for barycentric determinant computation
-            // reference : https://stackoverflow.com/questions/24441631/how-exactly-does-opengl-do-perspectively-correct-linear-interpolation
-            const float denom = 1.0f / ((v0.position.x - v2.position.x) * (v1.position.y - v0.position.y) - (v0.position.x - v1.position.x) * (v2.position.y - v0.position.y));
-            const vec3 barycentric_d0 = denom * vec3(
-                v1.position.y - v2.position.y, v2.position.y - v0.position.y, v0.position.y - v1.position.y
-            );
-            const vec3 barycentric_d1 = denom * vec3(
-                v2.position.x - v1.position.x, v0.position.x - v2.position.x, v1.position.x - v0.position.x
-            );
-            const vec3 barycentric_0 = denom * vec3(
-                v1.position.x * v2.position.y - v2.position.x * v1.position.y,
-                v2.position.x * v0.position.y - v0.position.x * v2.position.y,
-                v0.position.x * v1.position.y - v1.position.x * v0.position.y
-            );
-            
-            // AABB Bounding Box of Triangle
-            long x_min = min(v0.position.x, min(v1.position.x, v2.position.x));
-            long x_max = max(v0.position.x, max(v1.position.x, v2.position.x));
-            long y_min = min(v0.position.y, min(v1.position.y, v2.position.y));
-            long y_max = max(v0.position.y, max(v1.position.y, v2.position.y));
+    s_visible_meshlet_count = 0;
+    size_t vertex_count = 0;
+    const Meshlet *meshlets = mesh->getMeshlets();
+    for (size_t midx = 0; midx < mesh->meshletCount(); midx++)
+    {
+        const Meshlet & meshlet = meshlets[midx];
+        bool outside = false;
+        for (int i = 0; test_frustum && i < 6 && !outside; i++)
+        {
+            const vec4 & plane = planes[i];
+            outside = plane.x * meshlet.center.x + plane.y * meshlet.center.y + plane.z * meshlet.center.z + plane.w <
+                      -meshlet.radius * plane_scales[i];
+        }
+        if (outside)
+        {
+            PIPELINE_STATISTICS(t_statistics->meshlets_culled++);
+            PIPELINE_STATISTICS(t_statistics->triangles_frustum_culled += meshlet.face_count);
+            continue;
+        }
 
-            for (long x = x_min; x < x_max; x++)
+        if (test_cone && meshlet.cone_cutoff < 1.0f)
+        {
+            const vec3 view = (meshlet.cone_apex - eye).normalized();
+            if (view.dot(meshlet.cone_axis) >= meshlet.cone_cutoff)
             {
-                for (long y = y_min; y < y_max; y++)
-                {
-                    vec4 pos(DTOF(x), DTOF(frame_buffer.getHeight() - y), 0.0f, 0.0f);
+                PIPELINE_STATISTICS(t_statistics->meshlets_culled++);
+                PIPELINE_STATISTICS(t_statistics->triangles_backface_culled += meshlet.face_count);
+                continue;
+            }
+        }
+        s_visible_meshlets[s_visible_meshlet_count++] = midx;
+        vertex_count += meshlet.vertex_count;
+    }
+    return vertex_count;
+}
 
-                    const vec3 barycentric = pos.x * barycentric_d0 + pos.y * barycentric_d1 + barycentric_0;
-                    if (barycentric.x < 0.0f || barycentric.y < 0.0f || barycentric.z < 0.0f)
-                    {
-                        continue;
-                    }
+void Pipeline::drawShader(const FrameBuffer & frame_buffer, const Scene & scene, const Shader * shader, UINT32 state)
+{
+#ifdef _SPECIALIZED_PIPELINE_
+    const std::type_info & type = typeid(*shader);
+    if (type == typeid(UnlitShader))
+    {
+        drawDispatch(frame_buffer, scene, static_cast<const UnlitShader*>(shader), state);
+    }
+    else if (type == typeid(TriangleNormalShader))
+    {
+        drawDispatch(frame_buffer, scene, static_cast<const TriangleNormalShader*>(shader), state);
+    }
+    else if (type == typeid(VertexNormalShader))
+    {
+        drawDispatch(frame_buffer, scene, static_cast<const VertexNormalShader*>(shader), state);
+    }
+    else if (type == typeid(DepthShader))
+    {
+        drawDispatch(frame_buffer, scene, static_cast<const DepthShader*>(shader), state);
+    }
+    else if (type == typeid(BlinnPhongShader))
+    {
+        drawDispatch(frame_buffer, scene, static_cast<const BlinnPhongShader*>(shader), state);
+    }
+    else
+    {
+        drawDispatch(frame_buffer, scene, shader, state);
+    }
+#else
+    drawDispatch(frame_buffer, scene, shader, state);
+#endif
+}
 
-                    pos.z = barycentric.dot(vec3(v0.position.z, v1.position.z, v2.position.z));
-                    pos.w = barycentric.dot(vec3(v0.position.w, v1.position.w, v2.position.w));
-                    
-                    // Near/Far Plane Clipping
-                    if (pos.z < 0.0f || pos.z > 1.0f)
-                    {
-                        continue;
-                    }
+#define DRAW_SPECIALIZED_CASE(s) case s: drawSpecialized<S, s>(frame_buffer, scene, shader); break;
 
-                    const vec3 perspective = (1.0f / pos.w) * barycentric.multiply(vec3(v0.position.w, v1.position.w, v2.position.w));
-
-                    v2f v = v2f(
-                        pos,
-                        mat3( v0.frag_pos.x, v1.frag_pos.x, v2.frag_pos.x,
-                              v0.frag_pos.y, v1.frag_pos.y, v2.frag_pos.y,
-                              v0.frag_pos.z, v1.frag_pos.z, v2.frag_pos.z ) * perspective,
-                        mat3( v0.normal.x, v1.normal.x, v2.normal.x,
-                              v0.normal.y, v1.normal.y, v2.normal.y,
-                              v0.normal.z, v1.normal.z, v2.normal.z ) * perspective,
-                        mat3( v0.t_normal.x, v1.t_normal.x, v2.t_normal.x,
-                              v0.t_normal.y, v1.t_normal.y, v2.t_normal.y,
-                              v0.t_normal.z, v1.t_normal.z, v2.t_normal.z ) * perspective,
-                        vec2( vec3(v0.texcoord.u, v1.texcoord.u, v2.texcoord.u).dot(perspective),
-                              vec3(v0.texcoord.v, v1.texcoord.v, v2.texcoord.v).dot(perspective) )
-                    );
+template<typename S>
+void Pipeline::drawDispatch(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader, UINT32 state)
+{
+    switch (state)
+    {
+        DRAW_SPECIALIZED_CASE(0)
+        DRAW_SPECIALIZED_CASE(1)
+        DRAW_SPECIALIZED_CASE(2)
+        DRAW_SPECIALIZED_CASE(3)
+        DRAW_SPECIALIZED_CASE(4)
+        DRAW_SPECIALIZED_CASE(5)
+        DRAW_SPECIALIZED_CASE(6)
+        DRAW_SPECIALIZED_CASE(7)
+        DRAW_SPECIALIZED_CASE(8)
+        DRAW_SPECIALIZED_CASE(9)
+        DRAW_SPECIALIZED_CASE(10)
+        DRAW_SPECIALIZED_CASE(11)
+        DRAW_SPECIALIZED_CASE(12)
+        DRAW_SPECIALIZED_CASE(13)
+        DRAW_SPECIALIZED_CASE(14)
+        DRAW_SPECIALIZED_CASE(15)
+        DRAW_SPECIALIZED_CASE(RENDER_STATE_DEPTH_ONLY | RENDER_STATE_DEPTH_TEST)
+        DRAW_SPECIALIZED_CASE(RENDER_STATE_DEPTH_ONLY | RENDER_STATE_DEPTH_TEST | RENDER_STATE_BACKFACE_CULLING)
+        DRAW_SPECIALIZED_CASE(RENDER_STATE_DEPTH_EQUAL | RENDER_STATE_DEPTH_TEST)
+        DRAW_SPECIALIZED_CASE(RENDER_STATE_DEPTH_EQUAL | RENDER_STATE_DEPTH_TEST | RENDER_STATE_BACKFACE_CULLING)
+        default: assert(false);
+    }
+}
 
-                    pixelShaderBarycentric(frame_buffer, v, shader, entity, scene);
-                }
-            }
-#endif
+#undef DRAW_SPECIALIZED_CASE
 
-#ifdef _BARYCENTRIC_TRIANGLE_RASTERIZATION_1_
-            v0.position.x = SCREEN_MAPPING_X(v0.position.x, frame_buffer);
-            v1.position.x = SCREEN_MAPPING_X(v1.position.x, frame_buffer);
-            v2.position.x = SCREEN_MAPPING_X(v2.position.x, frame_buffer);
-            v0.position.y = SCREEN_MAPPING_Y(v0.position.y, frame_buffer);
-            v1.position.y = SCREEN_MAPPING_Y(v1.position.y, frame_buffer);
-            v2.position.y = SCREEN_MAPPING_Y(v2.position.y, frame_buffer);
-
-            v0.position.z = 1.0f / v0.position.z;
-            v1.position.z = 1.0f / v1.position.z;
-            v2.position.z = 1.0f / v2.position.z;
-
-            if (Singleton<Global>::get().wireframe_mode)
-            {
-                drawLinePipeline(frame_buffer, v0, v1, shader, entity, scene);
-                drawLinePipeline(frame_buffer, v1, v2, shader, entity, scene);
-                drawLinePipeline(frame_buffer, v2, v0, shader, entity, scene);
+template<typename S, UINT32 STATE>
+void Pipeline::drawSpecialized(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader)
+{
+    // scene.sortEntity();
+    {
+        PIPELINE_STATISTICS(StageTimer timer(&t_statistics->clear_ms));
+        if (!(STATE & RENDER_STATE_DEPTH_EQUAL))
+        {
+            frame_buffer.clearDepthBuffer(1.0f);
+        }
+        if (STATE & RENDER_STATE_DEFERRED)
+        {
+            frame_buffer.getGBuffer()->clear();
+        }
+    }
 
-                continue;
-            }
+    // binned triangles only live through the pass
+    const FrameArenaMarker pass_marker = s_frame_arena.mark();
+    const bool tile_binning = Singleton<Global>::get().thread_count > 1 && !(STATE & RENDER_STATE_WIREFRAME);
+    if (tile_binning)
+    {
+        s_tile_bin_count = ((frame_buffer.getWidth() + TILE_SIZE - 1) / TILE_SIZE) *
+                           ((frame_buffer.getHeight() + TILE_SIZE - 1) / TILE_SIZE);
+        s_tile_bins = s_frame_arena.create<TileBin>(s_tile_bin_count);
+    }
+
+    for (size_t iidx = 0; iidx < s_draw_items.size(); iidx++)
+    {
+        const Entity *entity = s_draw_items[iidx].entity;
+        const size_t eidx = s_draw_items[iidx].entity_index;
+        const mat4 mvp_matrix = scene.getCamera().getProjectMatrix() * scene.getCamera().getViewMatrix() * entity->getTransform();
+
+        const TriangleMesh *mesh = s_draw_items[iidx].mesh;
+        PIPELINE_STATISTICS(t_statistics->triangles_submitted += mesh->faceCount());
+
+        // Frustum Culling : whole entities against the view volume before any vertex work,
+        // triangles of entities entirely inside skip the clipping tests
+        const FRUSTUM_RESULT frustum = testFrustum(mesh->getAxisAlignBoundingBox(), mvp_matrix);
+        if (frustum == FRUSTUM_OUTSIDE)
+        {
+            PIPELINE_STATISTICS(t_statistics->entities_frustum_culled++);
+            PIPELINE_STATISTICS(t_statistics->triangles_frustum_culled += mesh->faceCount());
+            continue;
+        }
+        if (s_entity_occluded[eidx])
+        {
+            PIPELINE_STATISTICS(t_statistics->entities_occlusion_culled++);
+            continue;
+        }
+        const bool clip_free = frustum == FRUSTUM_INSIDE;
+
+        const mat4 model_inv = entity->getTransform().inversed();
+        const mat3 model_inv_transpose = mat3(model_inv.transposed());
 
-            // AABB Bounding Box of Triangle
-            const long x_min = max(min(v0.position.x, min(v1.position.x, v2.position.x)), 0);
-            const long x_max = min(max(v0.position.x, max(v1.position.x, v2.position.x)), frame_buffer.getWidth() - 1);
-            const long y_min = max(min(v0.position.y, min(v1.position.y, v2.position.y)), 0);
-            const long y_max = min(max(v0.position.y, max(v1.position.y, v2.position.y)), frame_buffer.getHeight() - 1);
+        // Meshlet Culling : whole clusters off the view volume or facing away skip vertex shading,
+        // the facing test does not hold for mirroring transforms
+        const bool meshlet_culling = mesh->hasMeshlets();
+        size_t shaded_vertex_count = mesh->uniqueVertexCount();
+        if (meshlet_culling)
+        {
+            const vec4 eye = model_inv * vec4(scene.getCamera().getPosition(), 1.0f);
+            const bool test_cone = (STATE & RENDER_STATE_BACKFACE_CULLING) && !(STATE & RENDER_STATE_WIREFRAME) &&
+                                   entity->getTransform().det() > 0.0f;
+            shaded_vertex_count = cullMeshlets(mesh, mvp_matrix, vec3(eye.x, eye.y, eye.z), !clip_free, test_cone);
+        }
 
-            const float area = edgeFunction(v0.position, v1.position, v2.position);
+        // Vertex Stage : run the vertex shader once per unique (position, normal, texcoord) tuple,
+        // or once per vertex of every visible meshlet
+        vdata uniform;
+        uniform.model_mat = entity->getTransform();
+        uniform.model_inv_transpose = model_inv_transpose;
+        uniform.mvp_mat = mvp_matrix;
 
-            for (long x = x_min; x < x_max; x++)
+        VertexJob vertex_job = { mesh, entity, &scene, shader, &uniform, meshlet_culling ? s_visible_meshlets : nullptr };
+        const size_t chunk_count = meshlet_culling ? s_visible_meshlet_count :
+                                   (mesh->uniqueVertexCount() + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE;
+        {
+            PIPELINE_STATISTICS(StageTimer timer(&t_statistics->vertex_ms));
+            getThreadPool(Singleton<Global>::get().thread_count)->parallelFor(chunk_count, processVertices<S>, &vertex_job);
+        }
+        PIPELINE_STATISTICS(t_statistics->vertices_shaded += shaded_vertex_count);
+        __unused_variable(shaded_vertex_count);
+        PIPELINE_STATISTICS(StageTimer setup_timer(&t_statistics->setup_ms));
+        const UINT32 *indices = mesh->getIndices();
+        const UINT32 *meshlet_faces = mesh->getMeshletFaces();
+        const byte_t *meshlet_triangles = mesh->getMeshletTriangles();
+        const size_t range_count = meshlet_culling ? s_visible_meshlet_count : 1;
+        for (size_t ridx = 0; ridx < range_count; ridx++)
+        {
+            const Meshlet *meshlet = meshlet_culling ? &mesh->getMeshlets()[s_visible_meshlets[ridx]] : nullptr;
+            const size_t slot_begin = meshlet ? meshlet->face_offset : 0;
+            const size_t slot_end = meshlet ? meshlet->face_offset + meshlet->face_count : mesh->faceCount();
+            for (size_t slot = slot_begin; slot < slot_end; slot++)
             {
-                for (long y = y_min; y < y_max; y++)
+                // Assembly Stage
+                v2f v0, v1, v2;
+                size_t fidx = slot;
+                if (meshlet_culling)
+                {
+                    const v2f *meshlet_vertices = s_transformed_vertices + meshlet->vertex_offset;
+                    fidx = meshlet_faces[slot];
+                    v0 = meshlet_vertices[meshlet_triangles[slot * 3 + 0]];
+                    v1 = meshlet_vertices[meshlet_triangles[slot * 3 + 1]];
+                    v2 = meshlet_vertices[meshlet_triangles[slot * 3 + 2]];
+                }
+                else
+                {
+                    v0 = s_transformed_vertices[indices[fidx * 3 + 0]];
+                    v1 = s_transformed_vertices[indices[fidx * 3 + 1]];
+                    v2 = s_transformed_vertices[indices[fidx * 3 + 2]];
+                }
+#if 0
+                v0.position.print();
+                v1.position.print();
+                v2.position.print();
+                printf("----------------------------------------------\n");
+#endif
+                v0.t_normal = model_inv_transpose * TRIANGLE_TRIANGLE_NORMAL(fidx);
+                v1.t_normal = model_inv_transpose * TRIANGLE_TRIANGLE_NORMAL(fidx);
+                v2.t_normal = model_inv_transpose * TRIANGLE_TRIANGLE_NORMAL(fidx);
+
+                // Perspective Division
+                PERSPECTIVE_DIVIDE(v0.position);
+                PERSPECTIVE_DIVIDE(v1.position);
+                PERSPECTIVE_DIVIDE(v2.position);
+            
+                // Triangle Screen Clipping
+                if (!clip_free &&
+                   ((v0.position.x < -1.0f && v1.position.x < -1.0f && v2.position.x < -1.0f) ||
+                    (v0.position.x >  1.0f && v1.position.x >  1.0f && v2.position.x >  1.0f) ||
+                    (v0.position.y < -1.0f && v1.position.y < -1.0f && v2.position.y < -1.0f) ||
+                    (v0.position.y >  1.0f && v1.position.y >  1.0f && v2.position.y >  1.0f) ||
+                    (v0.position.z <  0.0f && v1.position.z <  0.0f && v2.position.z <  0.0f) || // Near/Far Plane Clipping
+                    (v0.position.z >  1.0f && v1.position.z >  1.0f && v2.position.z >  1.0f)))
                 {
-                    vec4 pos(DTOF(x), DTOF(y), 1.0f, 0.0f);
+                    PIPELINE_STATISTICS(t_statistics->triangles_frustum_culled++);
+                    continue;
+                }
 
-                    float w0 = edgeFunction(v1.position, v2.position, pos);
-                    float w1 = edgeFunction(v2.position, v0.position, pos);
-                    float w2 = edgeFunction(v0.position, v1.position, pos);
+                if ((STATE & RENDER_STATE_BACKFACE_CULLING) && !(STATE & RENDER_STATE_WIREFRAME)) { // Back-face Culling
+                    vec3 u = vec3(v1.position - v0.position);
+                    vec3 v = vec3(v2.position - v0.position);
+                    vec3 face_normal = u.cross(v);
 
-                    bool has_neg = w0 < 0 || w1 < 0 || w2 < 0;
-                    bool has_pos = w0 > 0 || w1 > 0 || w2 > 0;
-                    if (has_neg && has_pos)
+                    if (face_normal.z < 0.0f)
                     {
+                        PIPELINE_STATISTICS(t_statistics->triangles_backface_culled++);
                         continue;
                     }
+                }
+                PIPELINE_STATISTICS(t_statistics->triangles_rasterized++);
 
-                    w0 /= area;
-                    w1 /= area;
-                    w2 /= area;
-
+#ifdef _BARYCENTRIC_TRIANGLE_RASTERIZATION_0_
+                v0.position.x = SCREEN_MAPPING_X(v0.position.x, frame_buffer);
+                v1.position.x = SCREEN_MAPPING_X(v1.position.x, frame_buffer);
+                v2.position.x = SCREEN_MAPPING_X(v2.position.x, frame_buffer);
+                v0.position.y = SCREEN_MAPPING_Y(v0.position.y, frame_buffer);
+                v1.position.y = SCREEN_MAPPING_Y(v1.position.y, frame_buffer);
+                v2.position.y = SCREEN_MAPPING_Y(v2.position.y, frame_buffer);
+
+                // Preconpute Affine transform for barycentric determinant computation
+                // reference : https://stackoverflow.com/questions/24441631/how-exactly-does-opengl-do-perspectively-correct-linear-interpolation
+                const float denom = 1.0f / ((v0.position.x - v2.position.x) * (v1.position.y - v0.position.y) - (v0.position.x - v1.position.x) * (v2.position.y - v0.position.y));
+                const vec3 barycentric_d0 = denom * vec3(
+                    v1.position.y - v2.position.y, v2.position.y - v0.position.y, v0.position.y - v1.position.y
+                );
+                const vec3 barycentric_d1 = denom * vec3(
+                    v2.position.x - v1.position.x, v0.position.x - v2.position.x, v1.position.x - v0.position.x
+                );
+                const vec3 barycentric_0 = denom * vec3(
+                    v1.position.x * v2.position.y - v2.position.x * v1.position.y,
+                    v2.position.x * v0.position.y - v0.position.x * v2.position.y,
+                    v0.position.x * v1.position.y - v1.position.x * v0.position.y
+                );
+            
+                // AABB Bounding Box of Triangle
+                long x_min = min(v0.position.x, min(v1.position.x, v2.position.x));
+                long x_max = max(v0.position.x, max(v1.position.x, v2.position.x));
+                long y_min = min(v0.position.y, min(v1.position.y, v2.position.y));
+                long y_max = max(v0.position.y, max(v1.position.y, v2.position.y));
 
-                    const float denom = (w0 * v0.position.z + w1 * v1.position.z + w2 * v2.position.z);
-                    pos.z = 1.0f / denom;
-                    if (isnan(pos.z))
+                for (long x = x_min; x < x_max; x++)
+                {
+                    for (long y = y_min; y < y_max; y++)
                     {
-                        continue;
-                    }
+                        vec4 pos(DTOF(x), DTOF(frame_buffer.getHeight() - y), 0.0f, 0.0f);
 
-                    // pos.w = w0 * v0.position.w + w1 * v1.position.w + w2 * v2.position.w;
-                    const vec3 barycentric = (1.0f / (w0 * v0.position.w + w1 * v1.position.w + w2 * v2.position.w)) * vec3(w0 * v0.position.w, w1 * v1.position.w, w2 * v2.position.w);
+                        const vec3 barycentric = pos.x * barycentric_d0 + pos.y * barycentric_d1 + barycentric_0;
+                        if (barycentric.x < 0.0f || barycentric.y < 0.0f || barycentric.z < 0.0f)
+                        {
+                            continue;
+                        }
 
-                    // Near/Far Plane Clipping
-                    if (pos.z < 0.0f || pos.z > 0.999f)
-                    {
-                        continue;
+                        pos.z = barycentric.dot(vec3(v0.position.z, v1.position.z, v2.position.z));
+                        pos.w = barycentric.dot(vec3(v0.position.w, v1.position.w, v2.position.w));
+                    
+                        // Near/Far Plane Clipping
+                        if (pos.z < 0.0f || pos.z > 1.0f)
+                        {
+                            continue;
+                        }
+
+                        const vec3 perspective = (1.0f / pos.w) * barycentric.multiply(vec3(v0.position.w, v1.position.w, v2.position.w));
+
+                        v2f v = v2f(
+                            pos,
+                            mat3( v0.frag_pos.x, v1.frag_pos.x, v2.frag_pos.x,
+                                  v0.frag_pos.y, v1.frag_pos.y, v2.frag_pos.y,
+                                  v0.frag_pos.z, v1.frag_pos.z, v2.frag_pos.z ) * perspective,
+                            mat3( v0.normal.x, v1.normal.x, v2.normal.x,
+                                  v0.normal.y, v1.normal.y, v2.normal.y,
+                                  v0.normal.z, v1.normal.z, v2.normal.z ) * perspective,
+                            mat3( v0.t_normal.x, v1.t_normal.x, v2.t_normal.x,
+                                  v0.t_normal.y, v1.t_normal.y, v2.t_normal.y,
+                                  v0.t_normal.z, v1.t_normal.z, v2.t_normal.z ) * perspective,
+                            vec2( vec3(v0.texcoord.u, v1.texcoord.u, v2.texcoord.u).dot(perspective),
+                                  vec3(v0.texcoord.v, v1.texcoord.v, v2.texcoord.v).dot(perspective) )
+                        );
+
+                        pixelShaderBarycentric(frame_buffer, v, shader, entity, scene);
                     }
+                }
+#endif
 
-                    const v2f v(
-                        pos,
-                        mat3( v0.frag_pos.x, v1.frag_pos.x, v2.frag_pos.x,
-                              v0.frag_pos.y, v1.frag_pos.y, v2.frag_pos.y,
-                              v0.frag_pos.z, v1.frag_pos.z, v2.frag_pos.z ) * barycentric,
-                        mat3( v0.normal.x, v1.normal.x, v2.normal.x,
-                              v0.normal.y, v1.normal.y, v2.normal.y,
-                              v0.normal.z, v1.normal.z, v2.normal.z ) * barycentric,
-                        mat3( v0.t_normal.x, v1.t_normal.x, v2.t_normal.x,
-                              v0.t_normal.y, v1.t_normal.y, v2.t_normal.y,
-                              v0.t_normal.z, v1.t_normal.z, v2.t_normal.z ) * barycentric,
-                        vec2( vec3(v0.texcoord.u, v1.texcoord.u, v2.texcoord.u).dot(barycentric),
-                              vec3(v0.texcoord.v, v1.texcoord.v, v2.texcoord.v).dot(barycentric) )
-                    );
+#ifdef _BARYCENTRIC_TRIANGLE_RASTERIZATION_1_
+                v0.position.x = SCREEN_MAPPING_X(v0.position.x, frame_buffer);
+                v1.position.x = SCREEN_MAPPING_X(v1.position.x, frame_buffer);
+                v2.position.x = SCREEN_MAPPING_X(v2.position.x, frame_buffer);
+                v0.position.y = SCREEN_MAPPING_Y(v0.position.y, frame_buffer);
+                v1.position.y = SCREEN_MAPPING_Y(v1.position.y, frame_buffer);
+                v2.position.y = SCREEN_MAPPING_Y(v2.position.y, frame_buffer);
+
+                v0.position.z = 1.0f / v0.position.z;
+                v1.position.z = 1.0f / v1.position.z;
+                v2.position.z = 1.0f / v2.position.z;
+
+                if (STATE & RENDER_STATE_WIREFRAME)
+                {
+                    drawLinePipeline(frame_buffer, v0, v1, shader, entity, scene);
+                    drawLinePipeline(frame_buffer, v1, v2, shader, entity, scene);
+                    drawLinePipeline(frame_buffer, v2, v0, shader, entity, scene);
 
-                    pixelShaderBarycentric(frame_buffer, v, shader, entity, scene);
+                    continue;
                 }
-            }
+
+                // AABB Bounding Box of Triangle
+                const long x_min = max(min(v0.position.x, min(v1.position.x, v2.position.x)), 0);
+                const long x_max = min(max(v0.position.x, max(v1.position.x, v2.position.x)), frame_buffer.getWidth() - 1);
+                const long y_min = max(min(v0.position.y, min(v1.position.y, v2.position.y)), 0);
+                const long y_max = min(max(v0.position.y, max(v1.position.y, v2.position.y)), frame_buffer.getHeight() - 1);
+
+                if (tile_binning)
+                {
+                    RasterTriangle triangle = { v0, v1, v2, entity, x_min, x_max, y_min, y_max };
+                    binTriangle(frame_buffer, triangle);
+                    continue;
+                }
+
+                rasterizeTriangle<S, STATE>(frame_buffer, v0, v1, v2, x_min, x_max, y_min, y_max, shader, entity, scene);
 #endif
 
 #ifdef _FLAT_FILL_TRIANGLE_RASTERIZATION_
-            sortVerticesByY(v0, v1, v2); // v0.position.y <= v1.position.y <= v2.position.y
+                sortVerticesByY(v0, v1, v2); // v0.position.y <= v1.position.y <= v2.position.y
 
-            // Rasterization Stage
-            if (v0.position.y == v1.position.y)
-            {
-                rasterizeFlatTriangle(frame_buffer, v0, v1, v2, shader, entity, scene);
-            }
-            else if (v1.position.y == v2.position.y)
-            {
-                rasterizeFlatTriangle(frame_buffer, v1, v2, v0, shader, entity, scene);
-            }
-            else
-            {
-                float alpha = (v1.position.y - v0.position.y) / (v2.position.y - v0.position.y);
-                v2f v3 = V2F_LERP_LINEAR(v0, v2, alpha);
-                rasterizeFlatTriangle(frame_buffer, v1, v3, v0, shader, entity, scene);
-                rasterizeFlatTriangle(frame_buffer, v1, v3, v2, shader, entity, scene);
-            }
+                // Rasterization Stage
+                if (v0.position.y == v1.position.y)
+                {
+                    rasterizeFlatTriangle(frame_buffer, v0, v1, v2, shader, entity, scene);
+                }
+                else if (v1.position.y == v2.position.y)
+                {
+                    rasterizeFlatTriangle(frame_buffer, v1, v2, v0, shader, entity, scene);
+                }
+                else
+                {
+                    float alpha = (v1.position.y - v0.position.y) / (v2.position.y - v0.position.y);
+                    v2f v3 = V2F_LERP_LINEAR(v0, v2, alpha);
+                    rasterizeFlatTriangle(frame_buffer, v1, v3, v0, shader, entity, scene);
+                    rasterizeFlatTriangle(frame_buffer, v1, v3, v2, shader, entity, scene);
+                }
 #endif
+            }
+        }
+    }
+
+    if (tile_binning)
+    {
+        rasterizeTiles<S, STATE>(frame_buffer, scene, shader);
+        s_tile_bins = nullptr;
+        s_tile_bin_count = 0;
+    }
+    s_frame_arena.rewind(pass_marker);
+
+    if (STATE & RENDER_STATE_DEPTH_EQUAL)
+    {
+        float *depth_buffer = frame_buffer.depthBuffer();
+        for (long i = 0; i < frame_buffer.getSize(); i++)
+        {
+            depth_buffer[i] = fabsf(depth_buffer[i]);
         }
     }
 
+    // Deferred Shading : shade every covered pixel exactly once
+    if (STATE & RENDER_STATE_DEFERRED)
+    {
+        const double resolve_start = getTimeMilliseconds();
+        resolveGBuffer(frame_buffer, scene, shader);
+        s_pass_timings.deferred_resolve = getTimeMilliseconds() - resolve_start;
+    }
+
 #if 0
     if (scene.getEnvmap())
     {
@@ -270,7 +998,7 @@ void Pipeline::draw(const FrameBuffer & frame_buffer, const Scene & scene, const
         {
             for (long y = 0; y < frame_buffer.getHeight(); y++)
             {
-                long depth_buffer_pos = frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x;
+                long depth_buffer_pos = frame_buffer.getPixelPos(x, y);
                 if (depth_test && frame_buffer.depthBuffer()[depth_buffer_pos] < 1.0f)
                 {
                     continue;
@@ -283,17 +1011,527 @@ void Pipeline::draw(const FrameBuffer & frame_buffer, const Scene & scene, const
                     sh.phi + (float)(x - x_center) / (frame_buffer.getWidth() - 1) * scene.getCamera().getFOV()
                 );
 
-                byte_t *color_buffer = frame_buffer.colorBuffer();
-                long color_buffer_pos = (frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x) * 3;
-                color_buffer[color_buffer_pos++] = FLOAT2BYTECOLOR(color.r);
-                color_buffer[color_buffer_pos++] = FLOAT2BYTECOLOR(color.g);
-                color_buffer[color_buffer_pos] = FLOAT2BYTECOLOR(color.b);
+                frame_buffer.setPixel(
+                    frame_buffer.getPixelPos(x, y),
+                    FLOAT2BYTECOLOR(color.r),
+                    FLOAT2BYTECOLOR(color.g),
+                    FLOAT2BYTECOLOR(color.b) );
             }
         }
     }
 #endif
 }
 
+template<typename S>
+void Pipeline::processVertices(size_t chunk_index, size_t thread_index, void * data)
+{
+    bindPoolArena(thread_index);
+
+    const VertexJob *job = (const VertexJob*)data;
+    const TriangleMesh *mesh = job->mesh;
+    const MeshVertex *welded_vertices = mesh->getWeldedVertices();
+
+    // a chunk of unique vertices, or the vertices of one meshlet
+    size_t vidx_begin = chunk_index * VERTEX_CHUNK_SIZE;
+    size_t vidx_end = min((chunk_index + 1) * VERTEX_CHUNK_SIZE, mesh->uniqueVertexCount());
+    const UINT32 *meshlet_vertices = nullptr;
+    if (job->meshlets)
+    {
+        const Meshlet & meshlet = mesh->getMeshlets()[job->meshlets[chunk_index]];
+        vidx_begin = meshlet.vertex_offset;
+        vidx_end = meshlet.vertex_offset + meshlet.vertex_count;
+        meshlet_vertices = mesh->getMeshletVertices();
+    }
+
+    vdata in = *job->uniform;
+    for (size_t vidx = vidx_begin; vidx < vidx_end; vidx++)
+    {
+        const MeshVertex & vertex = welded_vertices[meshlet_vertices ? meshlet_vertices[vidx] : vidx];
+        in.position = vertex.position;
+        in.normal   = vertex.normal;
+        in.texcoord = vertex.texcoord;
+        in.color    = vec4::ZERO;
+
+        new (&s_transformed_vertices[vidx]) v2f(shaderVert(static_cast<const S*>(job->shader), in, job->entity, *job->scene));
+    }
+}
+
+template<typename S, UINT32 STATE>
+void Pipeline::rasterizeTriangle(
+    const FrameBuffer & frame_buffer, const v2f & v0, const v2f & v1, const v2f & v2,
+    long x_min, long x_max, long y_min, long y_max, const S * shader,
+    const Entity * entity, const Scene & scene
+) {
+    PIPELINE_STATISTICS(StageTimer timer(&t_statistics->raster_ms));
+
+    const bool depth_test = (STATE & RENDER_STATE_DEPTH_TEST) != 0;
+    const long depth_tile_count_x = frame_buffer.getDepthTileCountX();
+    const float *depth_tile_min = frame_buffer.depthTileMin();
+    const float *depth_tile_max = frame_buffer.depthTileMax();
+
+    // vertex z holds 1/z, fragment depth is 1/(w0*z0 + w1*z1 + w2*z2) so with all
+    // z positive every fragment depth lies in [1/max(z), 1/min(z)]
+    const bool depth_bounds = depth_test && v0.position.z > 0.0f && v1.position.z > 0.0f && v2.position.z > 0.0f;
+    const float triangle_z_min = depth_bounds ? 1.0f / max(v0.position.z, max(v1.position.z, v2.position.z)) : 0.0f;
+    const float triangle_z_max = depth_bounds ? 1.0f / min(v0.position.z, min(v1.position.z, v2.position.z)) : 0.0f;
+
+    // Hierarchical Depth Culling : reject the whole triangle if it lies behind every
+    // tile its bounding box touches
+    if (depth_bounds)
+    {
+        bool occluded = true;
+        for (long tile_y = y_min / DEPTH_TILE_SIZE; occluded && tile_y <= (y_max - 1) / DEPTH_TILE_SIZE; tile_y++)
+        {
+            for (long tile_x = x_min / DEPTH_TILE_SIZE; tile_x <= (x_max - 1) / DEPTH_TILE_SIZE; tile_x++)
+            {
+                if (triangle_z_min * (1.0f - HIERARCHICAL_DEPTH_EPSILON) < depth_tile_max[tile_y * depth_tile_count_x + tile_x])
+                {
+                    occluded = false;
+                    break;
+                }
+            }
+        }
+        if (occluded)
+        {
+            return;
+        }
+    }
+
+    FragmentBatch batch;
+    batch.in.count = 0;
+
+#ifdef _INCREMENTAL_EDGE_RASTERIZATION_
+    float area = edgeFunction(v0.position, v1.position, v2.position);
+    if (area == 0.0f)
+    {
+        return;
+    }
+
+    // orient the edges so that covered pixels have non-negative edge functions
+    const float orientation = area > 0.0f ? 1.0f : -1.0f;
+    const float inv_area = 1.0f / (area * orientation);
+
+    // edge function steps for one pixel along x
+    const float w0_dx = (v2.position.y - v1.position.y) * orientation;
+    const float w1_dx = (v0.position.y - v2.position.y) * orientation;
+    const float w2_dx = (v1.position.y - v0.position.y) * orientation;
+
+    for (long block_y = y_min - y_min % RASTER_BLOCK_SIZE; block_y < y_max; block_y += RASTER_BLOCK_SIZE)
+    {
+        const long y_start = max(block_y, y_min);
+        const long y_end = min(block_y + RASTER_BLOCK_SIZE, y_max);
+
+        for (long block_x = x_min - x_min % RASTER_BLOCK_SIZE; block_x < x_max; block_x += RASTER_BLOCK_SIZE)
+        {
+            const long x_start = max(block_x, x_min);
+            const long x_end = min(block_x + RASTER_BLOCK_SIZE, x_max);
+
+            // classify the block by the edge functions at its corner pixel centers
+            const vec3 corners[4] = {
+                vec3(DTOF(x_start),   DTOF(y_start),   0.0f),
+                vec3(DTOF(x_end - 1), DTOF(y_start),   0.0f),
+                vec3(DTOF(x_start),   DTOF(y_end - 1), 0.0f),
+                vec3(DTOF(x_end - 1), DTOF(y_end - 1), 0.0f)
+            };
+            long inside_count[3] = { 0, 0, 0 };
+            float corner_z_recip_min = 0.0f;
+            float corner_z_recip_max = 0.0f;
+            for (long i = 0; i < 4; i++)
+            {
+                const float w0 = edgeFunction(v1.position, v2.position, corners[i]) * orientation;
+                const float w1 = edgeFunction(v2.position, v0.position, corners[i]) * orientation;
+                const float w2 = edgeFunction(v0.position, v1.position, corners[i]) * orientation;
+                inside_count[0] += w0 >= 0.0f;
+                inside_count[1] += w1 >= 0.0f;
+                inside_count[2] += w2 >= 0.0f;
+
+                // 1/z is linear in screen space, its extremes over the block are at the corners
+                const float z_recip = (w0 * v0.position.z + w1 * v1.position.z + w2 * v2.position.z) * inv_area;
+                corner_z_recip_min = i == 0 ? z_recip : min(corner_z_recip_min, z_recip);
+                corner_z_recip_max = i == 0 ? z_recip : max(corner_z_recip_max, z_recip);
+            }
+            if (inside_count[0] == 0 || inside_count[1] == 0 || inside_count[2] == 0)
+            {
+                continue;
+            }
+            const bool block_inside = inside_count[0] == 4 && inside_count[1] == 4 && inside_count[2] == 4;
+
+            // Hierarchical Depth Test : reject blocks behind the tile, skip the per-pixel
+            // depth test for blocks in front of the whole tile
+            bool depth_accept = false;
+            if (depth_bounds)
+            {
+                const long depth_tile = (block_y / DEPTH_TILE_SIZE) * depth_tile_count_x + block_x / DEPTH_TILE_SIZE;
+                const float block_z_min = corner_z_recip_max > 0.0f ? max(triangle_z_min, 1.0f / corner_z_recip_max) : triangle_z_min;
+                const float block_z_max = corner_z_recip_min > 0.0f ? min(triangle_z_max, 1.0f / corner_z_recip_min) : triangle_z_max;
+                if (block_z_min * (1.0f - HIERARCHICAL_DEPTH_EPSILON) >= depth_tile_max[depth_tile])
+                {
+                    continue;
+                }
+                depth_accept = !(STATE & RENDER_STATE_DEPTH_EQUAL) &&
+                    block_z_max * (1.0f + HIERARCHICAL_DEPTH_EPSILON) < depth_tile_min[depth_tile];
+            }
+
+            bool block_written = false;
+            for (long y = y_start; y < y_end; y++)
+            {
+                const vec3 row_start(DTOF(x_start), DTOF(y), 0.0f);
+                float w0 = edgeFunction(v1.position, v2.position, row_start) * orientation;
+                float w1 = edgeFunction(v2.position, v0.position, row_start) * orientation;
+                float w2 = edgeFunction(v0.position, v1.position, row_start) * orientation;
+
+                for (long x = x_start; x < x_end; x++, w0 += w0_dx, w1 += w1_dx, w2 += w2_dx)
+                {
+                    if (!block_inside && (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f))
+                    {
+                        continue;
+                    }
+
+                    block_written |= interpolateFragment<S, STATE>(
+                        frame_buffer, v0, v1, v2, x, y,
+                        w0 * inv_area, w1 * inv_area, w2 * inv_area,
+                        depth_accept, batch, shader, entity, scene
+                    );
+                }
+            }
+
+            if (block_written && !(STATE & RENDER_STATE_DEPTH_EQUAL))
+            {
+                frame_buffer.updateDepthTile(block_x / DEPTH_TILE_SIZE, block_y / DEPTH_TILE_SIZE);
+            }
+        }
+    }
+#else
+    const float area = edgeFunction(v0.position, v1.position, v2.position);
+
+    bool written = false;
+    for (long x = x_min; x < x_max; x++)
+    {
+        for (long y = y_min; y < y_max; y++)
+        {
+            vec4 pos(DTOF(x), DTOF(y), 1.0f, 0.0f);
+
+            float w0 = edgeFunction(v1.position, v2.position, pos);
+            float w1 = edgeFunction(v2.position, v0.position, pos);
+            float w2 = edgeFunction(v0.position, v1.position, pos);
+
+            bool has_neg = w0 < 0 || w1 < 0 || w2 < 0;
+            bool has_pos = w0 > 0 || w1 > 0 || w2 > 0;
+            if (has_neg && has_pos)
+            {
+                continue;
+            }
+
+            written |= interpolateFragment<S, STATE>(
+                frame_buffer, v0, v1, v2, x, y,
+                w0 / area, w1 / area, w2 / area,
+                false, batch, shader, entity, scene
+            );
+        }
+    }
+
+    if (written && !(STATE & RENDER_STATE_DEPTH_EQUAL))
+    {
+        for (long tile_y = y_min / DEPTH_TILE_SIZE; tile_y <= (y_max - 1) / DEPTH_TILE_SIZE; tile_y++)
+        {
+            for (long tile_x = x_min / DEPTH_TILE_SIZE; tile_x <= (x_max - 1) / DEPTH_TILE_SIZE; tile_x++)
+            {
+                frame_buffer.updateDepthTile(tile_x, tile_y);
+            }
+        }
+    }
+#endif
+
+    shadeFragmentBatch(frame_buffer, batch, shader, entity, scene);
+}
+
+static inline float interpolateAttribute(float a0, float a1, float a2, const vec3 & barycentric)
+{
+    return a0 * barycentric.x + a1 * barycentric.y + a2 * barycentric.z;
+}
+
+/**
+ * interpolate depth first and run the depth test before any other attribute
+ * is interpolated or the fragment shader is invoked (early depth test),
+ * depth_accept skips the test for fragments known to pass it
+ * return true if the fragment was written
+ */
+template<typename S, UINT32 STATE>
+bool Pipeline::interpolateFragment(
+    const FrameBuffer & frame_buffer, const v2f & v0, const v2f & v1, const v2f & v2,
+    long x, long y, float w0, float w1, float w2, bool depth_accept, FragmentBatch & batch,
+    const S * shader, const Entity * entity, const Scene & scene
+) {
+    vec4 pos(DTOF(x), DTOF(y), 1.0f, 0.0f);
+
+    const float denom = (w0 * v0.position.z + w1 * v1.position.z + w2 * v2.position.z);
+    pos.z = 1.0f / denom;
+    if (isnan(pos.z))
+    {
+        return false;
+    }
+
+    // Near/Far Plane Clipping
+    if (pos.z < 0.0f || pos.z > 0.999f)
+    {
+        return false;
+    }
+
+    // Early Depth Test
+    PIPELINE_STATISTICS(t_statistics->fragments_tested++);
+    const long buffer_pos = frame_buffer.getPixelPos(x, y);
+    float *depth_buffer = frame_buffer.depthBuffer();
+    if (STATE & RENDER_STATE_DEPTH_EQUAL)
+    {
+        // shading pass after the depth prepass, shade only the first fragment
+        // matching the final depth (like the forward depth test on ties), the
+        // sign bit marks shaded pixels and is cleared at the end of the pass
+        if (depth_buffer[buffer_pos] != pos.z || signbit(depth_buffer[buffer_pos]))
+        {
+            PIPELINE_STATISTICS(t_statistics->fragments_depth_rejected++);
+            return false;
+        }
+        depth_buffer[buffer_pos] = -pos.z;
+    }
+    else
+    {
+        if (!depth_accept && (STATE & RENDER_STATE_DEPTH_TEST) && depth_buffer[buffer_pos] <= pos.z)
+        {
+            PIPELINE_STATISTICS(t_statistics->fragments_depth_rejected++);
+            return false;
+        }
+        depth_buffer[buffer_pos] = pos.z;
+
+        if (STATE & RENDER_STATE_DEPTH_ONLY)
+        {
+            return true;
+        }
+    }
+
+    // pos.w = w0 * v0.position.w + w1 * v1.position.w + w2 * v2.position.w;
+    const vec3 barycentric = (1.0f / (w0 * v0.position.w + w1 * v1.position.w + w2 * v2.position.w)) * vec3(w0 * v0.position.w, w1 * v1.position.w, w2 * v2.position.w);
+
+    if (STATE & RENDER_STATE_DEFERRED)
+    {
+        GBuffer *gbuffer = frame_buffer.getGBuffer();
+        float *frag_pos = gbuffer->fragPosBuffer() + buffer_pos * 3;
+        float *normal = gbuffer->normalBuffer() + buffer_pos * 3;
+        float *t_normal = gbuffer->triangleNormalBuffer() + buffer_pos * 3;
+        float *texcoord = gbuffer->texcoordBuffer() + buffer_pos * 2;
+        frag_pos[0] = interpolateAttribute(v0.frag_pos.x, v1.frag_pos.x, v2.frag_pos.x, barycentric);
+        frag_pos[1] = interpolateAttribute(v0.frag_pos.y, v1.frag_pos.y, v2.frag_pos.y, barycentric);
+        frag_pos[2] = interpolateAttribute(v0.frag_pos.z, v1.frag_pos.z, v2.frag_pos.z, barycentric);
+        normal[0] = interpolateAttribute(v0.normal.x, v1.normal.x, v2.normal.x, barycentric);
+        normal[1] = interpolateAttribute(v0.normal.y, v1.normal.y, v2.normal.y, barycentric);
+        normal[2] = interpolateAttribute(v0.normal.z, v1.normal.z, v2.normal.z, barycentric);
+        t_normal[0] = interpolateAttribute(v0.t_normal.x, v1.t_normal.x, v2.t_normal.x, barycentric);
+        t_normal[1] = interpolateAttribute(v0.t_normal.y, v1.t_normal.y, v2.t_normal.y, barycentric);
+        t_normal[2] = interpolateAttribute(v0.t_normal.z, v1.t_normal.z, v2.t_normal.z, barycentric);
+        texcoord[0] = interpolateAttribute(v0.texcoord.u, v1.texcoord.u, v2.texcoord.u, barycentric);
+        texcoord[1] = interpolateAttribute(v0.texcoord.v, v1.texcoord.v, v2.texcoord.v, barycentric);
+        gbuffer->entityBuffer()[buffer_pos] = entity;
+        return true;
+    }
+
+#ifdef _BATCH_FRAGMENT_SHADING_
+    v2f_batch & in = batch.in;
+    const long i = in.count;
+    in.position.set(i, vec3(pos));
+    in.frag_pos.x[i] = interpolateAttribute(v0.frag_pos.x, v1.frag_pos.x, v2.frag_pos.x, barycentric);
+    in.frag_pos.y[i] = interpolateAttribute(v0.frag_pos.y, v1.frag_pos.y, v2.frag_pos.y, barycentric);
+    in.frag_pos.z[i] = interpolateAttribute(v0.frag_pos.z, v1.frag_pos.z, v2.frag_pos.z, barycentric);
+    in.normal.x[i] = interpolateAttribute(v0.normal.x, v1.normal.x, v2.normal.x, barycentric);
+    in.normal.y[i] = interpolateAttribute(v0.normal.y, v1.normal.y, v2.normal.y, barycentric);
+    in.normal.z[i] = interpolateAttribute(v0.normal.z, v1.normal.z, v2.normal.z, barycentric);
+    in.t_normal.x[i] = interpolateAttribute(v0.t_normal.x, v1.t_normal.x, v2.t_normal.x, barycentric);
+    in.t_normal.y[i] = interpolateAttribute(v0.t_normal.y, v1.t_normal.y, v2.t_normal.y, barycentric);
+    in.t_normal.z[i] = interpolateAttribute(v0.t_normal.z, v1.t_normal.z, v2.t_normal.z, barycentric);
+    in.texcoord.x[i] = interpolateAttribute(v0.texcoord.u, v1.texcoord.u, v2.texcoord.u, barycentric);
+    in.texcoord.y[i] = interpolateAttribute(v0.texcoord.v, v1.texcoord.v, v2.texcoord.v, barycentric);
+    batch.buffer_pos[i] = buffer_pos;
+
+    in.count++;
+    if (in.count == FRAG_BATCH_SIZE)
+    {
+        shadeFragmentBatch(frame_buffer, batch, shader, entity, scene);
+    }
+#else
+    __unused_variable(batch);
+
+    const v2f v(
+        pos,
+        mat3( v0.frag_pos.x, v1.frag_pos.x, v2.frag_pos.x,
+              v0.frag_pos.y, v1.frag_pos.y, v2.frag_pos.y,
+              v0.frag_pos.z, v1.frag_pos.z, v2.frag_pos.z ) * barycentric,
+        mat3( v0.normal.x, v1.normal.x, v2.normal.x,
+              v0.normal.y, v1.normal.y, v2.normal.y,
+              v0.normal.z, v1.normal.z, v2.normal.z ) * barycentric,
+        mat3( v0.t_normal.x, v1.t_normal.x, v2.t_normal.x,
+              v0.t_normal.y, v1.t_normal.y, v2.t_normal.y,
+              v0.t_normal.z, v1.t_normal.z, v2.t_normal.z ) * barycentric,
+        vec2( vec3(v0.texcoord.u, v1.texcoord.u, v2.texcoord.u).dot(barycentric),
+              vec3(v0.texcoord.v, v1.texcoord.v, v2.texcoord.v).dot(barycentric) )
+    );
+
+    // Fragment Shader
+    PIPELINE_STATISTICS(StageTimer timer(&t_statistics->fragment_ms));
+    PIPELINE_STATISTICS(t_statistics->fragments_shaded++);
+    PIPELINE_STATISTICS(t_statistics->pixels_written++);
+    rgba color = shaderFrag(shader, v, entity, scene);
+
+    frame_buffer.setPixel(
+        buffer_pos,
+        FLOAT2BYTECOLOR(color.r),
+        FLOAT2BYTECOLOR(color.g),
+        FLOAT2BYTECOLOR(color.b) );
+#endif
+
+    return true;
+}
+
+/**
+ * run the fragment shader over all pending fragments of the batch and write
+ * their colors, the batch is empty afterwards
+ */
+template<typename S>
+void Pipeline::shadeFragmentBatch(
+    const FrameBuffer & frame_buffer, FragmentBatch & batch, const S * shader,
+    const Entity * entity, const Scene & scene
+) {
+    if (batch.in.count == 0)
+    {
+        return;
+    }
+    PIPELINE_STATISTICS(StageTimer timer(&t_statistics->fragment_ms));
+    PIPELINE_STATISTICS(t_statistics->fragments_shaded += batch.in.count);
+    PIPELINE_STATISTICS(t_statistics->pixels_written += batch.in.count);
+    batch.in.mask = (1U << batch.in.count) - 1;
+
+    rgb_batch color;
+    shaderFragBatch(shader, batch.in, color, entity, scene);
+
+    for (long i = 0; i < batch.in.count; i++)
+    {
+        frame_buffer.setPixel(
+            batch.buffer_pos[i],
+            FLOAT2BYTECOLOR(color.x[i]),
+            FLOAT2BYTECOLOR(color.y[i]),
+            FLOAT2BYTECOLOR(color.z[i]) );
+    }
+
+    batch.in.count = 0;
+}
+
+template<typename S, UINT32 STATE>
+void Pipeline::rasterizeTiles(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader)
+{
+    TileJob job;
+    job.frame_buffer = &frame_buffer;
+    job.scene = &scene;
+    job.shader = shader;
+    job.tile_count_x = (frame_buffer.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+
+    ThreadPool *thread_pool = getThreadPool(Singleton<Global>::get().thread_count);
+    thread_pool->parallelFor(s_tile_bin_count, rasterizeTile<S, STATE>, &job);
+}
+
+template<typename S, UINT32 STATE>
+void Pipeline::rasterizeTile(size_t tile_index, size_t thread_index, void * data)
+{
+    bindPoolArena(thread_index);
+    PIPELINE_STATISTICS(bindThreadStatistics(thread_index));
+
+    const TileJob *job = (const TileJob*)data;
+    const TileBin & bin = s_tile_bins[tile_index];
+
+    const long tile_x_min = (tile_index % job->tile_count_x) * TILE_SIZE;
+    const long tile_y_min = (tile_index / job->tile_count_x) * TILE_SIZE;
+    const long tile_x_max = tile_x_min + TILE_SIZE;
+    const long tile_y_max = tile_y_min + TILE_SIZE;
+
+    for (const TileBinBlock *block = bin.first; block; block = block->next)
+    {
+        for (size_t i = 0; i < block->count; i++)
+        {
+            const RasterTriangle & triangle = *block->triangles[i];
+            rasterizeTriangle<S, STATE>(
+                *job->frame_buffer, triangle.v0, triangle.v1, triangle.v2,
+                max(triangle.x_min, tile_x_min), min(triangle.x_max, tile_x_max),
+                max(triangle.y_min, tile_y_min), min(triangle.y_max, tile_y_max),
+                static_cast<const S*>(job->shader), triangle.entity, *job->scene
+            );
+        }
+    }
+}
+
+template<typename S>
+void Pipeline::resolveGBuffer(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader)
+{
+    ResolveJob job = { &frame_buffer, &scene, shader };
+
+    ThreadPool *thread_pool = getThreadPool(Singleton<Global>::get().thread_count);
+    thread_pool->parallelFor(frame_buffer.getHeight(), resolveGBufferRow<S>, &job);
+}
+
+/**
+ * shade one memory row of the G-buffer, runs of pixels from the same
+ * entity are gathered into fragment batches
+ */
+template<typename S>
+void Pipeline::resolveGBufferRow(size_t row_index, size_t thread_index, void * data)
+{
+    bindPoolArena(thread_index);
+    PIPELINE_STATISTICS(bindThreadStatistics(thread_index));
+    PIPELINE_STATISTICS(StageTimer timer(&t_statistics->fragment_ms));
+
+    const ResolveJob *job = (const ResolveJob*)data;
+    const FrameBuffer & frame_buffer = *job->frame_buffer;
+    const S *shader = static_cast<const S*>(job->shader);
+    const GBuffer *gbuffer = frame_buffer.getGBuffer();
+
+    const long width = frame_buffer.getWidth();
+    const long y = frame_buffer.getHeight() - 1 - (long)row_index;
+    const long row_start = (long)row_index * width;
+
+    FragmentBatch batch;
+    batch.in.count = 0;
+    const Entity *batch_entity = nullptr;
+    for (long x = 0; x < width; x++)
+    {
+        const long buffer_pos = row_start + x;
+        const Entity *entity = gbuffer->entityBuffer()[buffer_pos];
+        if (entity == nullptr)
+        {
+            continue;
+        }
+        if (entity != batch_entity)
+        {
+            shadeFragmentBatch(frame_buffer, batch, shader, batch_entity, *job->scene);
+            batch_entity = entity;
+        }
+
+        v2f_batch & in = batch.in;
+        const long i = in.count;
+        const float *frag_pos = gbuffer->fragPosBuffer() + buffer_pos * 3;
+        const float *normal = gbuffer->normalBuffer() + buffer_pos * 3;
+        const float *t_normal = gbuffer->triangleNormalBuffer() + buffer_pos * 3;
+        const float *texcoord = gbuffer->texcoordBuffer() + buffer_pos * 2;
+        in.position.set(i, vec3(DTOF(x), DTOF(y), frame_buffer.depthBuffer()[buffer_pos]));
+        in.frag_pos.set(i, vec3(frag_pos[0], frag_pos[1], frag_pos[2]));
+        in.normal.set(i, vec3(normal[0], normal[1], normal[2]));
+        in.t_normal.set(i, vec3(t_normal[0], t_normal[1], t_normal[2]));
+        in.texcoord.set(i, vec2(texcoord[0], texcoord[1]));
+        batch.buffer_pos[i] = buffer_pos;
+
+        in.count++;
+        if (in.count == FRAG_BATCH_SIZE)
+        {
+            shadeFragmentBatch(frame_buffer, batch, shader, batch_entity, *job->scene);
+        }
+    }
+    shadeFragmentBatch(frame_buffer, batch, shader, batch_entity, *job->scene);
+}
+
 void Pipeline::drawLinePipeline(
     const FrameBuffer & frame_buffer, const v2f & v0, const v2f & v1, const Shader * shader,
     const Entity * entity, const Scene & scene
@@ -341,14 +1579,11 @@ void Pipeline::pixelShaderWireframe(
         return;
     }
 
-    long depth_buffer_pos = frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x;
+    long depth_buffer_pos = frame_buffer.getPixelPos(x, y);
     frame_buffer.depthBuffer()[depth_buffer_pos] = 0.0f;
 
-    byte_t *color_buffer = frame_buffer.colorBuffer();
-    long color_buffer_pos = (frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x) * 3;
-    color_buffer[color_buffer_pos++] = FLOAT2BYTECOLOR(1.0f);
-    color_buffer[color_buffer_pos++] = FLOAT2BYTECOLOR(1.0f);
-    color_buffer[color_buffer_pos] = FLOAT2BYTECOLOR(1.0f);
+    PIPELINE_STATISTICS(t_statistics->pixels_written++);
+    frame_buffer.setPixel(depth_buffer_pos, FLOAT2BYTECOLOR(1.0f), FLOAT2BYTECOLOR(1.0f), FLOAT2BYTECOLOR(1.0f));
 }
 
 
@@ -434,7 +1669,7 @@ void Pipeline::pixelShaderBarycentric(
         return;
     }
 
-    long depth_buffer_pos = frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x;
+    long depth_buffer_pos = frame_buffer.getPixelPos(x, y);
     if (Singleton<Global>::get().depth_test && (frame_buffer.depthBuffer()[depth_buffer_pos] <= v.position.z))
     {
         return;
@@ -446,11 +1681,11 @@ void Pipeline::pixelShaderBarycentric(
     // Fragment Shader 
     rgba color = shader->frag(v, entity, scene);
 
-    byte_t *color_buffer = frame_buffer.colorBuffer();
-    long color_buffer_pos = (frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x) * 3;
-    color_buffer[color_buffer_pos++] = FLOAT2BYTECOLOR(color.r);
-    color_buffer[color_buffer_pos++] = FLOAT2BYTECOLOR(color.g);
-    color_buffer[color_buffer_pos] = FLOAT2BYTECOLOR(color.b);
+    frame_buffer.setPixel(
+        depth_buffer_pos,
+        FLOAT2BYTECOLOR(color.r),
+        FLOAT2BYTECOLOR(color.g),
+        FLOAT2BYTECOLOR(color.b) );
 }
 
 void Pipeline::pixelShader(
@@ -471,7 +1706,7 @@ void Pipeline::pixelShader(
         return;
     }
 
-    long depth_buffer_pos = frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x;
+    long depth_buffer_pos = frame_buffer.getPixelPos(x, y);
     if (Singleton<Global>::get().depth_test && frame_buffer.depthBuffer()[depth_buffer_pos] <= v.position.z)
     {
         return;
@@ -483,11 +1718,7 @@ void Pipeline::pixelShader(
     // Fragment Shader 
     rgba color = shader->frag(v, entity, scene);
 
-    byte_t *color_buffer = frame_buffer.colorBuffer();
-    long color_buffer_pos = (frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x) * 3;
-    color_buffer[color_buffer_pos++] = FTOD(color.r * 255);
-    color_buffer[color_buffer_pos++] = FTOD(color.g * 255);
-    color_buffer[color_buffer_pos] = FTOD(color.b * 255);
+    frame_buffer.setPixel(depth_buffer_pos, FTOD(color.r * 255), FTOD(color.g * 255), FTOD(color.b * 255));
 }
 
 
@@ -527,6 +1758,9 @@ void Lurdr::drawTriangles(
         // set all sizes to 0
         memset(out_sizes[j], 0, MAX_OUT_COUNT * sizeof(size_t));
     }
+    // shader out buffers are taken from the thread arena, released on return
+    FrameArena & arena = getThreadArena();
+    const FrameArenaMarker marker = arena.mark();
 
     for (i = 0; i < triangle_count; i++)
     {
@@ -561,4 +1795,5 @@ void Lurdr::drawTriangles(
         drawLine(frame_buffer, v2, v3, COLOR_WHITE);
         drawLine(frame_buffer, v3, v1, COLOR_WHITE);
     }
+    arena.rewind(marker);
 }
\ No newline at end of file
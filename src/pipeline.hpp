@@ -11,31 +11,35 @@
 #include "rasterizer.hpp"
 #include "entity.hpp"
 #include "scene.hpp"
+#include "parallel.hpp"
+#include "arena.hpp"
 
 namespace Lurdr
 {
 
+class OcclusionBuffer;
+
 #define PERSPECTIVE_DIVIDE(v) v.w = 1.0f / v.w; \
                               v.x *= v.w;       \
                               v.y *= v.w;       \
                               v.z *= v.w;
 
 #define FLOAT2BYTECOLOR(x) FTOD(clamp(x,0.0f,1.0f)*255)
+
+// screen tile size of the sort-middle (tile-binned) multithread mode
+#define TILE_SIZE 64
+// unique vertices handed to one vertex stage task
+#define VERTEX_CHUNK_SIZE 1024
+// triangles per block of a tile bin
+#define TILE_BIN_BLOCK_SIZE 64
                               
 
-#define TRIANGLE_VERTEX(fidx,vidx) (mesh->getVertices()[mesh->getFaces()[fidx][vidx]])
-#define TRIANGLE_NORMAL(fidx,vidx) (mesh->hasVertexNormals()?mesh->getVertexNormals()[mesh->getFaceNormals()[fidx][vidx]]:vec3::ZERO)
-#define TRIANGLE_TEXCOORD(fidx,vidx) (mesh->hasTextureCoords()?mesh->getTextureCoords()[mesh->getFaceTexcoords()[fidx][vidx]]:vec2::ZERO)
+#define TRIANGLE_CORNER(fidx,vidx) (mesh->getWeldedVertices()[mesh->getIndices()[(fidx)*3+(vidx)]])
+#define TRIANGLE_VERTEX(fidx,vidx) (TRIANGLE_CORNER(fidx,vidx).position)
+#define TRIANGLE_NORMAL(fidx,vidx) (TRIANGLE_CORNER(fidx,vidx).normal)
+#define TRIANGLE_TEXCOORD(fidx,vidx) (TRIANGLE_CORNER(fidx,vidx).texcoord)
 #define TRIANGLE_TRIANGLE_NORMAL(fidx) (mesh->hasTriangleNormals()?mesh->getTriangleNormals()[fidx]:vec3::ZERO)
 
-#define TRIANGLE_VDATA(fidx,vidx) { .model_mat = entity->getTransform(),       \
-                                    .model_inv_transpose = model_inv_transpose,\
-                                    .mvp_mat = mvp_matrix,                     \
-                                    .position = TRIANGLE_VERTEX(fidx, vidx),   \
-                                    .normal = TRIANGLE_NORMAL(fidx, vidx),     \
-                                    .texcoord = TRIANGLE_TEXCOORD(fidx, vidx), \
-                                    .color = vec4::ZERO }
-
 #define SCREEN_MAPPING_X(x,frame_buffer) FTOD((x * 0.5f + 0.5f) * frame_buffer.getWidth())
 #define SCREEN_MAPPING_Y(y,frame_buffer) FTOD((y * 0.5f + 0.5f) * frame_buffer.getHeight())
 #define V2F_LERP_LINEAR(v0,v1,alpha) v2f( vec4::lerp(v0.position, v1.position, alpha), \
@@ -44,12 +48,126 @@ namespace Lurdr
                                           vec3::lerp(v0.t_normal, v1.t_normal, alpha), \
                                           vec2::lerp(v0.texcoord, v1.texcoord, alpha))
 
+// render state bits a pipeline instantiation is specialized for
+#define RENDER_STATE_DEPTH_TEST         0x1U
+#define RENDER_STATE_WIREFRAME          0x2U
+#define RENDER_STATE_BACKFACE_CULLING   0x4U
+#define RENDER_STATE_DEFERRED           0x8U
+// passes of the depth prepass mode, only combined with depth test on,
+// wireframe and deferred off
+#define RENDER_STATE_DEPTH_ONLY         0x10U
+#define RENDER_STATE_DEPTH_EQUAL        0x20U
+
+/**
+ * wall clock time in milliseconds of the passes of the last Pipeline::draw,
+ * passes that did not run are 0
+ */
+struct PipelinePassTimings
+{
+    double depth_prepass;       // depth-only pass
+    double main;                // vertex, raster and (forward) shading pass
+    double deferred_resolve;    // G-buffer shading pass
+};
+
+// count primitives and fragments and time the stages of every draw, normally
+// set from the build (make STATS=1), without it all collection compiles away
+// #define _PIPELINE_STATISTICS_
+
+/**
+ * pipeline statistics of the last Pipeline::draw summed over all its passes,
+ * similar to GPU pipeline statistics queries, all 0 unless the tree is built
+ * with _PIPELINE_STATISTICS_. Stage times are exclusive (raster time does not
+ * include the fragment shading it triggers) and summed over worker threads.
+ */
+struct PipelineStatistics
+{
+    long    entities_frustum_culled;    // bounding box entirely outside the view volume
+    long    entities_occlusion_culled;  // bounding box hidden behind the occluders
+    long    meshlets_culled;            // outside the view volume or facing away, triangles count as culled
+    long    vertices_shaded;            // vertex shader invocations
+    long    triangles_submitted;
+    long    triangles_frustum_culled;   // entirely outside one side of the view volume
+    long    triangles_backface_culled;
+    long    triangles_rasterized;       // reached the rasterizer (or line drawing in wireframe)
+    long    fragments_tested;           // covered pixels inside near/far reaching the depth test
+    long    fragments_depth_rejected;
+    long    fragments_shaded;           // fragment shader invocations
+    long    pixels_written;             // color buffer writes
+    double  clear_ms;                   // depth and G-buffer clears
+    double  vertex_ms;
+    double  setup_ms;                   // assembly, clipping, culling and binning
+    double  raster_ms;                  // coverage, depth test and attribute interpolation
+    double  fragment_ms;                // fragment shading and color writes
+};
+
+/**
+ * fragments that passed the depth test, waiting to be shaded as one batch
+ */
+struct FragmentBatch
+{
+    v2f_batch   in;
+    long        buffer_pos[FRAG_BATCH_SIZE];
+};
+
 class Pipeline
 {
 public:
     static void draw(const FrameBuffer & frame_buffer, const Scene & scene, const Shader * shader);
+    static const PipelinePassTimings & getPassTimings();
+    static const PipelineStatistics & getStatistics();
+    // print getStatistics() into the frame buffer as a text overlay
+    static void drawStatistics(const FrameBuffer & frame_buffer, float x, float y, float size, const RGBCOLOR & color);
+    // occlusion culling result of the last draw, entity_index indexes Scene::getEntities()
+    static bool isEntityOccluded(size_t entity_index);
+    static const OcclusionBuffer * getOcclusionBuffer();
+    /**
+     * Transient data of a frame lives in arenas reset at the start of every
+     * draw, nothing allocated there may be kept past the next draw. The frame
+     * arena is for stages on the calling thread, getThreadArena() for worker
+     * tasks and shaders. The thread of the last draw keeps the arena of
+     * thread 0, any other thread gets an arena of its own, left out of
+     * getArenaStatistics().
+     */
+    static FrameArena & getFrameArena();
+    // frame and thread arenas summed, peak is the sum of the arena peaks
+    static FrameArenaStatistics getArenaStatistics();
 
 private:
+    static void selectEntityLods(const Scene & scene);
+    static void cullOccludedEntities(const Scene & scene);
+    static void gatherDrawItems(const FrameBuffer & frame_buffer, const Scene & scene);
+    static void drawShader(const FrameBuffer & frame_buffer, const Scene & scene, const Shader * shader, UINT32 state);
+    template<typename S>
+    static void drawDispatch(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader, UINT32 state);
+    template<typename S, UINT32 STATE>
+    static void drawSpecialized(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader);
+    template<typename S>
+    static void processVertices(size_t chunk_index, size_t thread_index, void * data);
+    template<typename S, UINT32 STATE>
+    static void rasterizeTriangle(
+        const FrameBuffer & frame_buffer, const v2f & v0, const v2f & v1, const v2f & v2,
+        long x_min, long x_max, long y_min, long y_max, const S * shader,
+        const Entity * entity, const Scene & scene
+    );
+    template<typename S, UINT32 STATE>
+    static bool interpolateFragment(
+        const FrameBuffer & frame_buffer, const v2f & v0, const v2f & v1, const v2f & v2,
+        long x, long y, float w0, float w1, float w2, bool depth_accept, FragmentBatch & batch,
+        const S * shader, const Entity * entity, const Scene & scene
+    );
+    template<typename S>
+    static void shadeFragmentBatch(
+        const FrameBuffer & frame_buffer, FragmentBatch & batch, const S * shader,
+        const Entity * entity, const Scene & scene
+    );
+    template<typename S, UINT32 STATE>
+    static void rasterizeTiles(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader);
+    template<typename S, UINT32 STATE>
+    static void rasterizeTile(size_t tile_index, size_t thread_index, void * data);
+    template<typename S>
+    static void resolveGBuffer(const FrameBuffer & frame_buffer, const Scene & scene, const S * shader);
+    template<typename S>
+    static void resolveGBufferRow(size_t row_index, size_t thread_index, void * data);
     static void pixelShaderBarycentric(
         const FrameBuffer & frame_buffer, const v2f & v, const Shader * shader,
         const Entity * entity, const Scene & scene
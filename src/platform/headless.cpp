@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <atomic>
+#include "platform.hpp"
+#include "../misc.hpp"
+
+// platform without a display for render farms and CI, windows are plain
+// surfaces and no input events are ever generated
+//
+// environment variables
+//   LURDR_HEADLESS_FRAMES : frames swapped before a window asks to close (default 1)
+//   LURDR_HEADLESS_OUTPUT : printf pattern of a PPM file written on every swap,
+//                           e.g. "frames/frame_%04ld.ppm", nothing is written if unset
+//
+// swapBuffer may run on a present thread, frames swapped after the window
+// asked to close are dropped
+
+struct Lurdr::APPWINDOW
+{
+    byte_t      *surface;
+    long        width;
+    long        height;
+    std::atomic<long> frame_count;
+    long        max_frame_count;
+    const char  *output_pattern;
+    bool        keys[KEY_NUM];
+    bool        buttons[BUTTON_NUM];
+    bool        should_close;
+    void        (*keyboardCallback)(AppWindow *window, KEY_CODE key, bool pressed);
+    void        (*mouseButtonCallback)(AppWindow *window, MOUSE_BUTTON button, bool pressed);
+    void        (*mouseScrollCallback)(AppWindow *window, float offset);
+    void        (*mouseDragCallback)(AppWindow *window, float x, float y);
+};
+
+// need no implementation
+void Lurdr::initializeApplication() {}
+void Lurdr::runApplication() {}
+void Lurdr::terminateApplication() {}
+
+Lurdr::AppWindow* Lurdr::createWindow(const char *title, long width, long height, byte_t *surface_buffer)
+{
+    AppWindow *window = new AppWindow();
+    window->surface = surface_buffer;
+    window->width = width;
+    window->height = height;
+    window->frame_count = 0;
+    window->max_frame_count = getenv("LURDR_HEADLESS_FRAMES") ? atol(getenv("LURDR_HEADLESS_FRAMES")) : 1;
+    window->output_pattern = getenv("LURDR_HEADLESS_OUTPUT");
+    window->should_close = false;
+
+    printf("Headless window \"%s\" %ldx%ld, closes after %ld frames\n",
+        title, width, height, window->max_frame_count);
+    return window;
+}
+
+void Lurdr::destroyWindow(AppWindow *window)
+{
+    window->should_close = true;
+}
+
+void Lurdr::swapBuffer(AppWindow *window)
+{
+    if (window->output_pattern && window->frame_count < window->max_frame_count)
+    {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), window->output_pattern, window->frame_count.load());
+        FILE *fp = fopen(filename, "wb");
+        if (fp == nullptr)
+        {
+            printf("Headless : frame file: %s open failed\n", filename);
+        }
+        else
+        {
+            fprintf(fp, "P6\n%ld %ld\n255\n", window->width, window->height);
+            fwrite(window->surface, 3, window->width * window->height, fp);
+            fclose(fp);
+        }
+    }
+    window->frame_count++;
+}
+
+bool Lurdr::windowShouldClose(AppWindow *window)
+{
+    return window->should_close || window->frame_count >= window->max_frame_count;
+}
+
+void Lurdr::pollEvent() {}
+
+/**
+ * input & callback registrations
+ */
+void Lurdr::setKeyboardCallback(AppWindow *window, void(*callback)(AppWindow*, KEY_CODE, bool))
+{
+    window->keyboardCallback = callback;
+}
+
+void Lurdr::setMouseButtonCallback(AppWindow *window, void(*callback)(AppWindow*, MOUSE_BUTTON, bool))
+{
+    window->mouseButtonCallback = callback;
+}
+
+void Lurdr::setMouseScrollCallback(AppWindow *window, void(*callback)(AppWindow*, float))
+{
+    window->mouseScrollCallback = callback;
+}
+
+void Lurdr::setMouseDragCallback(AppWindow *window, void(*callback)(AppWindow*, float, float))
+{
+    window->mouseDragCallback = callback;
+}
+
+bool Lurdr::isKeyDown(AppWindow *window, KEY_CODE key)
+{
+    return window->keys[key];
+}
+
+bool Lurdr::isMouseButtonDown(AppWindow *window, MOUSE_BUTTON button)
+{
+    return window->buttons[button];
+}
+
+Lurdr::Time Lurdr::getSystemTime()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    tm lt;
+    localtime_r(&tv.tv_sec, &lt);
+
+    Lurdr::Time time;
+    time.year = lt.tm_year + 1900;
+    time.month = lt.tm_mon + 1;
+    time.day_of_week = lt.tm_wday;
+    time.day = lt.tm_mday;
+    time.hour = lt.tm_hour;
+    time.minute = lt.tm_min;
+    time.second = lt.tm_sec;
+    time.millisecond = tv.tv_usec / 1000;
+
+    return time;
+}
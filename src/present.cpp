@@ -0,0 +1,155 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "present.hpp"
+
+using namespace Lurdr;
+
+struct Lurdr::FenceContext
+{
+    mutable std::mutex              mutex;
+    mutable std::condition_variable signaled;
+    UINT64                          value;
+};
+
+struct Lurdr::FrameRingContext
+{
+    std::thread         thread;
+    Fence               submit_fence;   // frames handed to the present thread
+    Fence               present_fence;  // frames whose buffer is free again
+    PRESENT_TASK(present);
+    void                *data;
+    std::atomic<bool>   terminate;
+};
+
+Fence::Fence()
+{
+    m_context = new FenceContext();
+    m_context->value = 0;
+}
+
+Fence::~Fence()
+{
+    delete m_context;
+}
+
+UINT64 Fence::getValue() const
+{
+    std::unique_lock<std::mutex> lock(m_context->mutex);
+    return m_context->value;
+}
+
+void Fence::signal(UINT64 value)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_context->mutex);
+        assert(value >= m_context->value);
+        m_context->value = value;
+    }
+    m_context->signaled.notify_all();
+}
+
+void Fence::wait(UINT64 value) const
+{
+    std::unique_lock<std::mutex> lock(m_context->mutex);
+    m_context->signaled.wait(lock, [&] {
+        return m_context->value >= value;
+    });
+}
+
+static void presentLoop(FrameRingContext * context, FrameBuffer ** buffers, size_t buffer_count)
+{
+    for (UINT64 frame = 0; ; frame++)
+    {
+        context->submit_fence.wait(frame + 1);
+        if (context->terminate)
+        {
+            return;
+        }
+        context->present(*buffers[frame % buffer_count], frame, context->data);
+        context->present_fence.signal(frame + 1);
+    }
+}
+
+FrameRing::FrameRing(
+    size_t buffer_count, long width, long height, PRESENT_TASK(present), void * data,
+    COLOR_FORMAT color_format
+):
+    m_buffer_count(buffer_count > 0 ? buffer_count : 1),
+    m_frame(0),
+    m_acquired(false)
+{
+    m_buffers = new FrameBuffer*[m_buffer_count];
+    for (size_t i = 0; i < m_buffer_count; i++)
+    {
+        m_buffers[i] = new FrameBuffer(width, height, color_format);
+    }
+
+    m_context = new FrameRingContext();
+    m_context->present = present;
+    m_context->data = data;
+    m_context->terminate = false;
+    if (m_buffer_count > 1)
+    {
+        m_context->thread = std::thread(presentLoop, m_context, m_buffers, m_buffer_count);
+    }
+}
+
+FrameRing::~FrameRing()
+{
+    assert(!m_acquired);
+    if (m_buffer_count > 1)
+    {
+        flush();
+        m_context->terminate = true;
+        m_context->submit_fence.signal(m_frame + 1);
+        m_context->thread.join();
+    }
+    delete m_context;
+
+    for (size_t i = 0; i < m_buffer_count; i++)
+    {
+        delete m_buffers[i];
+    }
+    delete[] m_buffers;
+}
+
+const Fence & FrameRing::getPresentFence() const
+{
+    return m_context->present_fence;
+}
+
+FrameBuffer & FrameRing::acquire()
+{
+    assert(!m_acquired);
+    // frame - buffer_count used the same buffer before
+    if (m_frame >= m_buffer_count)
+    {
+        m_context->present_fence.wait(m_frame - m_buffer_count + 1);
+    }
+    m_acquired = true;
+    return *m_buffers[m_frame % m_buffer_count];
+}
+
+UINT64 FrameRing::submit()
+{
+    assert(m_acquired);
+    m_acquired = false;
+    m_frame++;
+    if (m_buffer_count == 1)
+    {
+        m_context->present(*m_buffers[0], m_frame - 1, m_context->data);
+        m_context->present_fence.signal(m_frame);
+    }
+    else
+    {
+        m_context->submit_fence.signal(m_frame);
+    }
+    return m_frame;
+}
+
+void FrameRing::flush()
+{
+    m_context->present_fence.wait(m_frame);
+}
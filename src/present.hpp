@@ -0,0 +1,93 @@
+#ifndef __PRESENT_HPP__
+#define __PRESENT_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "global.hpp"
+#include "buffer.hpp"
+
+namespace Lurdr
+{
+
+#define PRESENT_TASK(name) void(*name)(const FrameBuffer&,UINT64,void*)
+
+struct FenceContext;
+struct FrameRingContext;
+
+/**
+ * A timeline fence, the value only grows, signal(v) releases every wait(w)
+ * with w <= v.
+ */
+class Fence
+{
+private:
+    FenceContext    *m_context;
+
+public:
+    Fence();
+    ~Fence();
+
+    Fence(const Fence &) = delete;
+    Fence& operator= (const Fence &) = delete;
+
+    UINT64 getValue() const;
+    void signal(UINT64 value);
+    void wait(UINT64 value) const;
+};
+
+/**
+ * A ring of frame buffers handed to a present thread, so the next frame
+ * renders while the previous ones are blitted, converted or written out.
+ *
+ *   FrameBuffer & fb = ring.acquire();   // blocks until the buffer is free
+ *   ... render into fb ...
+ *   ring.submit();                       // present(fb, frame, data) runs later
+ *
+ * Frame n uses buffer n % buffer_count, the present fence reaches n + 1 once
+ * its present task returned and the buffer may be reused. A ring of one
+ * buffer presents synchronously in submit on the calling thread.
+ */
+class FrameRing
+{
+private:
+    size_t              m_buffer_count;
+    FrameBuffer         **m_buffers;
+    UINT64              m_frame;
+    bool                m_acquired;
+    FrameRingContext    *m_context;
+
+public:
+    FrameRing() = delete;
+    FrameRing(
+        size_t buffer_count, long width, long height, PRESENT_TASK(present), void * data,
+        COLOR_FORMAT color_format = COLOR_FORMAT_RGB8);
+    ~FrameRing();
+
+    FrameRing(const FrameRing &) = delete;
+    FrameRing& operator= (const FrameRing &) = delete;
+
+    size_t getBufferCount() const { return m_buffer_count; }
+    UINT64 getFrame() const { return m_frame; }
+    const Fence & getPresentFence() const;
+
+    /**
+     * wait until the buffer of the next frame has been presented and return it
+     */
+    FrameBuffer & acquire();
+
+    /**
+     * queue the acquired buffer for presenting, returns the present fence
+     * value that signals when the buffer is released
+     */
+    UINT64 submit();
+
+    /**
+     * block until every submitted frame has been presented
+     */
+    void flush();
+};
+
+}
+
+#endif
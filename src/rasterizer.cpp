@@ -15,18 +15,14 @@ void Lurdr::drawPoint(const FrameBuffer & frame_buffer, Vector2 position, RGBCol
 
 void Lurdr::drawPixel(const FrameBuffer & frame_buffer, const long & x, const long & y, const RGBColor & color, const float & depth)
 {
-    long depth_buffer_pos = frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x;
+    long depth_buffer_pos = frame_buffer.getPixelPos(x, y);
     float d = clamp(depth, -1.0f, 1.0f);
     if (frame_buffer.depthBuffer()[depth_buffer_pos] <= d)
     {
         return;
     }
     frame_buffer.depthBuffer()[depth_buffer_pos] = d;
-    byte_t *color_buffer = frame_buffer.colorBuffer();
-    long color_buffer_pos = (frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x) * 3;
-    color_buffer[color_buffer_pos++] = color.R;
-    color_buffer[color_buffer_pos++] = color.G;
-    color_buffer[color_buffer_pos] = color.B;
+    frame_buffer.setPixel(depth_buffer_pos, color.R, color.G, color.B);
 }
 
 // reference : https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm
@@ -147,13 +143,10 @@ void Lurdr::drawScanLine(
     const long & y,
     const RGBColor & color )
 {
-    byte_t rgb_buffer[3] = { color.R, color.G, color.B };
-    size_t rgb_buffer_size = 3 * sizeof(byte_t);
-    byte_t *buffer_ptr = frame_buffer.colorBuffer() + (frame_buffer.getWidth() * y + x1) * 3;
+    long buffer_pos = frame_buffer.getWidth() * y + x1;
     for (long x = x1; x <= x2; x++)
     {
-        memcpy(buffer_ptr, rgb_buffer, rgb_buffer_size);
-        buffer_ptr += rgb_buffer_size;
+        frame_buffer.setPixel(buffer_pos++, color.R, color.G, color.B);
     }
 }
 
@@ -171,16 +164,13 @@ void Lurdr::drawScanLine(
     float dr = (color2.x - color1.x) / (x2 - x1);
     float dg = (color2.y - color1.y) / (x2 - x1);
     float db = (color2.z - color1.z) / (x2 - x1);
-    byte_t *color_buffer = frame_buffer.colorBuffer();
-    long buffer_pos = (frame_buffer.getSize() - frame_buffer.getWidth() * (y + 1) + x1) * 3;
+    long buffer_pos = frame_buffer.getPixelPos(x1, y);
     for (long x = x1; x <= x2; x++)
     {
         r += dr;
         g += dg;
         b += db;
-        color_buffer[buffer_pos++] = r + 0.5f;
-        color_buffer[buffer_pos++] = g + 0.5f;
-        color_buffer[buffer_pos++] = b + 0.5f;
+        frame_buffer.setPixel(buffer_pos++, r + 0.5f, g + 0.5f, b + 0.5f);
     }
 }
 
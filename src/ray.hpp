@@ -10,41 +10,93 @@
 namespace Lurdr
 {
 
+class MeshBVH;
+class SceneBVH;
+
 class Ray
 {
 private:
     Vector3 m_origin;
     Vector3 m_direction;
 public:
-    Ray();
+    Ray(): m_origin(Vector3::ZERO),
+           m_direction(Vector3::UNIT_Z) {}
     Ray(const Vector3 & origin, const Vector3 & dir): m_origin(origin),
                                                       m_direction(dir) {}
     Ray(const Ray & ray): m_origin(ray.m_origin),
                           m_direction(ray.m_direction) {}
     ~Ray() {}
 
-    Vector3 & origin();
-    Vector3 & direction();
+    Vector3 & origin() { return m_origin; }
+    Vector3 & direction() { return m_direction; }
+    const Vector3 & origin() const { return m_origin; }
+    const Vector3 & direction() const { return m_direction; }
 
-    bool intersectWithTriangle(
+    inline bool intersectWithTriangle(
         const Vector3 & v1,
         const Vector3 & v2,
-        const Vector3 & v3, 
+        const Vector3 & v3,
+        float * t,
         float * u,
         float * v ) const;
     bool intersectWithModel(
-        const Model & model,
+        const MeshBVH & bvh,
         size_t * face_idx,
+        float * t,
         float * u,
         float * v ) const;
     bool intersectWithScene(
-        const Scene & scene,
-        size_t * model_idx,
+        const SceneBVH & bvh,
+        size_t * entity_idx,
         size_t * face_idx,
+        float * t,
         float * u,
         float * v ) const;
 };
 
+/**
+ * Moller-Trumbore, hit at origin + direction * t = (1 - u - v) * v1 + u * v2 + v * v3,
+ * both sides of the triangle are hit
+ * reference : https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/moller-trumbore-ray-triangle-intersection
+ */
+inline bool Ray::intersectWithTriangle(
+    const Vector3 & v1,
+    const Vector3 & v2,
+    const Vector3 & v3,
+    float * t,
+    float * u,
+    float * v ) const
+{
+    const Vector3 e1 = v2 - v1;
+    const Vector3 e2 = v3 - v1;
+    const Vector3 p = m_direction.cross(e2);
+    const float det = e1.dot(p);
+
+    // the ray is parallel to the triangle
+    if (fabs(det) < EPSILON * EPSILON)
+    {
+        return false;
+    }
+    const float inv_det = 1.0f / det;
+
+    const Vector3 s = m_origin - v1;
+    *u = s.dot(p) * inv_det;
+    if (*u < 0.0f || *u > 1.0f)
+    {
+        return false;
+    }
+
+    const Vector3 q = s.cross(e1);
+    *v = m_direction.dot(q) * inv_det;
+    if (*v < 0.0f || *u + *v > 1.0f)
+    {
+        return false;
+    }
+
+    *t = e2.dot(q) * inv_det;
+    return *t > EPSILON;
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "scene.hpp"
+#include "arena.hpp"
 
 using namespace Lurdr;
 
@@ -111,7 +112,9 @@ void Model::draw(const FrameBuffer & frame_buffer, const Program & program)
     __unused_variable(program);
     // vertex shader
     Vertex *mesh_vertices = m_mesh->getVertices();
-    Vector4 *position_buffer = new Vector4[m_mesh->getVertexCount()];
+    FrameArena & arena = getThreadArena();
+    const FrameArenaMarker marker = arena.mark();
+    Vector4 *position_buffer = arena.create<Vector4>(m_mesh->getVertexCount());
     
     __unused_variable(mesh_vertices);
     __unused_variable(position_buffer);
@@ -122,6 +125,7 @@ void Model::draw(const FrameBuffer & frame_buffer, const Program & program)
         // program.run(VERTEX_SHADER, 2)
         // mesh_vertices[i].position
     }
+    arena.rewind(marker);
 }
 
 OldScene::OldScene(): m_background(COLOR_BLACK) {}
@@ -233,4 +237,16 @@ LightComp Scene::getLight(vec3 normal, vec3 frag_pos, vec3 view_dir) const
     }
 
     return result;
+}
+
+void Scene::getLightBatch(
+    const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+    long count, vec3_batch & diffuse, vec3_batch & specular
+) const {
+    memset(&diffuse, 0, sizeof(vec3_batch));
+    memset(&specular, 0, sizeof(vec3_batch));
+    for (size_t i = 0; i < m_lights.size(); i++)
+    {
+        m_lights[i]->getLightBatch(normal, frag_pos, view_dir, count, diffuse, specular);
+    }
 }
\ No newline at end of file
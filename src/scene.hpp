@@ -101,6 +101,10 @@ public:
     const Envmap* getEnvmap() const { return m_envmap; }
 
     LightComp getLight(vec3 normal, vec3 frag_pos, vec3 view_dir) const;
+    void getLightBatch(
+        const vec3_batch & normal, const vec3_batch & frag_pos, const vec3_batch & view_dir,
+        long count, vec3_batch & diffuse, vec3_batch & specular
+    ) const;
 };
 
 
@@ -1,8 +1,31 @@
 #include "shader.hpp"
+#include "simd.hpp"
+
+#include <typeinfo>
 
 using namespace Lurdr;
 
-v2f UnlitShader::vert(const vdata in, const Entity * entity, const Scene & scene) const
+// a native batch stands for the frag of its own class only, a subclass
+// overriding frag alone gets the default one call per lane
+#define NATIVE_FRAG_BATCH(shader_class) \
+    if (typeid(*this) != typeid(shader_class)) \
+    { \
+        Shader::fragBatch(in, out, entity, scene); \
+        return; \
+    }
+
+void Shader::fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const
+{
+    for (long i = 0; i < in.count; i++)
+    {
+        if (in.mask & (1U << i))
+        {
+            out.set(i, vec3(frag(in.get(i), entity, scene)));
+        }
+    }
+}
+
+v2f UnlitShader::vert(const vdata & in, const Entity * entity, const Scene & scene) const
 {
     __unused_variable(entity);
     __unused_variable(scene);
@@ -16,7 +39,7 @@ v2f UnlitShader::vert(const vdata in, const Entity * entity, const Scene & scene
     return out;
 }
 
-v2f LitShader::vert(const vdata in, const Entity * entity, const Scene & scene) const
+v2f LitShader::vert(const vdata & in, const Entity * entity, const Scene & scene) const
 {
     __unused_variable(entity);
     __unused_variable(scene);
@@ -98,4 +121,163 @@ vec4 BlinnPhongShader::frag(const v2f in, const Entity * entity, const Scene & s
                  specular_strength * light_comp.specular.multiply(vec3(SAMPLER_2D(TEXTURE_SPECULAR, in.texcoord)));
 
     return vec4(color, 1.0f);
-}
\ No newline at end of file
+}
+
+void UnlitShader::fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const
+{
+    NATIVE_FRAG_BATCH(UnlitShader);
+
+    __unused_variable(scene);
+
+    const Texture & albedo = TEXTURE_ALBEDO;
+    for (long i = 0; i < in.count; i++)
+    {
+        if (in.mask & (1U << i))
+        {
+            out.set(i, vec3(SAMPLER_2D(albedo, in.texcoord.get(i))));
+        }
+    }
+}
+
+void TriangleNormalShader::fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const
+{
+    NATIVE_FRAG_BATCH(TriangleNormalShader);
+
+    __unused_variable(entity);
+    __unused_variable(scene);
+
+    const simd_float half = simdSet(0.5f);
+    for (long i = 0; i < in.count; i += SIMD_WIDTH)
+    {
+        simdStore(out.x + i, simdAdd(simdMul(simdLoad(in.t_normal.x + i), half), half));
+        simdStore(out.y + i, simdAdd(simdMul(simdLoad(in.t_normal.y + i), half), half));
+        simdStore(out.z + i, simdAdd(simdMul(simdLoad(in.t_normal.z + i), half), half));
+    }
+}
+
+void VertexNormalShader::fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const
+{
+    NATIVE_FRAG_BATCH(VertexNormalShader);
+
+    __unused_variable(entity);
+    __unused_variable(scene);
+
+    const simd_float half = simdSet(0.5f);
+    for (long i = 0; i < in.count; i += SIMD_WIDTH)
+    {
+        simd_float r = simdAdd(simdMul(simdLoad(in.normal.x + i), half), half);
+        simd_float g = simdAdd(simdMul(simdLoad(in.normal.y + i), half), half);
+        simd_float b = simdAdd(simdMul(simdLoad(in.normal.z + i), half), half);
+        simdNormalize(r, g, b);
+        simdStore(out.x + i, r);
+        simdStore(out.y + i, g);
+        simdStore(out.z + i, b);
+    }
+}
+
+void DepthShader::fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const
+{
+    NATIVE_FRAG_BATCH(DepthShader);
+
+    __unused_variable(entity);
+    __unused_variable(scene);
+
+    // vectorized getColorMap(depth, 0.0f, 1.0f, COLORMAP_ACCENT)
+    const Vector3 *colormap = accent_colormap;
+    const long map_steps = COLORMAP_ACCENT_SIZE - 1;
+
+    alignas(32) float index[FRAG_BATCH_SIZE];
+    vec3_batch from;
+    vec3_batch to;
+    for (long i = 0; i < in.count; i += SIMD_WIDTH)
+    {
+        simdStore(index + i, simdTruncate(simdMul(simdLoad(in.position.z + i), simdSet((float)map_steps))));
+    }
+    for (long i = 0; i < in.count; i++)
+    {
+        if (in.mask & (1U << i))
+        {
+            from.set(i, colormap[(long)index[i]]);
+            to.set(i, colormap[(long)index[i] + 1]);
+        }
+    }
+
+    const simd_float one = simdSet(1.0f);
+    const simd_float step = simdSet(1.0f / map_steps);
+    const simd_float byte_max = simdSet(255.0f);
+    for (long i = 0; i < in.count; i += SIMD_WIDTH)
+    {
+        simd_float alpha = simdMul(simdSub(simdLoad(in.position.z + i), simdMul(simdLoad(index + i), step)), simdSet((float)map_steps));
+        alpha = simdMin(simdMax(alpha, simdSet(0.0f)), one);
+        const simd_float beta = simdSub(one, alpha);
+
+        // lerp, then quantize to byte like RGBColor
+        simd_float r = simdAdd(simdMul(simdLoad(from.x + i), beta), simdMul(simdLoad(to.x + i), alpha));
+        simd_float g = simdAdd(simdMul(simdLoad(from.y + i), beta), simdMul(simdLoad(to.y + i), alpha));
+        simd_float b = simdAdd(simdMul(simdLoad(from.z + i), beta), simdMul(simdLoad(to.z + i), alpha));
+        r = simdTruncate(simdMin(simdMax(r, simdSet(0.0f)), byte_max));
+        g = simdTruncate(simdMin(simdMax(g, simdSet(0.0f)), byte_max));
+        b = simdTruncate(simdMin(simdMax(b, simdSet(0.0f)), byte_max));
+
+        simdStore(out.x + i, simdDiv(r, byte_max));
+        simdStore(out.y + i, simdDiv(g, byte_max));
+        simdStore(out.z + i, simdDiv(b, byte_max));
+    }
+}
+
+void BlinnPhongShader::fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const
+{
+    NATIVE_FRAG_BATCH(BlinnPhongShader);
+
+    const float ambient_strength = 0.1f;
+    const float diffuse_strength = 1.0f;
+    const float specular_strength = 0.8f;
+
+    const vec3 camera_position = scene.getCamera().getPosition();
+    vec3_batch view_dir;
+    for (long i = 0; i < in.count; i += SIMD_WIDTH)
+    {
+        simd_float x = simdSub(simdSet(camera_position.x), simdLoad(in.frag_pos.x + i));
+        simd_float y = simdSub(simdSet(camera_position.y), simdLoad(in.frag_pos.y + i));
+        simd_float z = simdSub(simdSet(camera_position.z), simdLoad(in.frag_pos.z + i));
+        simdNormalize(x, y, z);
+        simdStore(view_dir.x + i, x);
+        simdStore(view_dir.y + i, y);
+        simdStore(view_dir.z + i, z);
+    }
+
+    vec3_batch light_diffuse;
+    vec3_batch light_specular;
+    scene.getLightBatch(in.normal, in.frag_pos, view_dir, in.count, light_diffuse, light_specular);
+
+    const Texture & albedo_texture = TEXTURE_ALBEDO;
+    const Texture & diffuse_texture = TEXTURE_DIFFUSE;
+    const Texture & specular_texture = TEXTURE_SPECULAR;
+    vec3_batch albedo;
+    vec3_batch diffuse;
+    vec3_batch specular;
+    for (long i = 0; i < in.count; i++)
+    {
+        if (in.mask & (1U << i))
+        {
+            const vec2 texcoord = in.texcoord.get(i);
+            albedo.set(i, vec3(SAMPLER_2D(albedo_texture, texcoord)));
+            diffuse.set(i, vec3(SAMPLER_2D(diffuse_texture, texcoord)));
+            specular.set(i, vec3(SAMPLER_2D(specular_texture, texcoord)));
+        }
+    }
+
+#define BLINN_PHONG_BATCH_CHANNEL(c) simdStore(out.c + i, simdAdd(simdAdd(                                          \
+        simdMul(simdSet(ambient_strength), simdLoad(albedo.c + i)),                                                 \
+        simdMul(simdSet(diffuse_strength), simdMul(simdLoad(light_diffuse.c + i), simdLoad(diffuse.c + i)))),       \
+        simdMul(simdSet(specular_strength), simdMul(simdLoad(light_specular.c + i), simdLoad(specular.c + i)))))
+
+    for (long i = 0; i < in.count; i += SIMD_WIDTH)
+    {
+        BLINN_PHONG_BATCH_CHANNEL(x);
+        BLINN_PHONG_BATCH_CHANNEL(y);
+        BLINN_PHONG_BATCH_CHANNEL(z);
+    }
+
+#undef BLINN_PHONG_BATCH_CHANNEL
+}
@@ -55,13 +55,44 @@ struct v2f
     }
 };
 
+#define FRAG_BATCH_SIZE VECTOR_BATCH_SIZE
+
+/**
+ * structure-of-arrays batch of up to FRAG_BATCH_SIZE fragments of one entity,
+ * lane i is covered if bit i of mask is set, covered lanes are packed at the
+ * front so lanes [count, FRAG_BATCH_SIZE) hold stale data and must not be
+ * used to address memory (textures, lookup tables)
+ */
+struct v2f_batch
+{
+    vec3_batch position;
+    vec3_batch frag_pos;
+    vec3_batch normal;
+    vec3_batch t_normal;
+    vec2_batch texcoord;
+    long       count;
+    UINT32     mask;
+
+    v2f get(long i) const
+    {
+        return v2f(vec4(position.get(i), 0.0f), frag_pos.get(i), normal.get(i), t_normal.get(i), texcoord.get(i));
+    }
+};
+
 class Scene;
 
 class Shader
 {
 public:
-    virtual v2f vert(const vdata in, const Entity * entity, const Scene & scene) const = 0;
+    virtual v2f vert(const vdata & in, const Entity * entity, const Scene & scene) const = 0;
     virtual vec4 frag(const v2f in, const Entity * entity, const Scene & scene) const = 0;
+    /**
+     * shade a batch of fragments, only covered lanes of out are read back,
+     * the default calls frag once per covered lane. The built-in shaders
+     * batch natively only for their exact class, so a subclass overriding
+     * frag alone is still shaded through its frag
+     */
+    virtual void fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const;
 };
 
 #define MODEL_MATRIX        (in.model_mat)
@@ -73,38 +104,43 @@ public:
 class UnlitShader : public Shader
 {
 public:
-    virtual v2f vert(const vdata in, const Entity * entity, const Scene & scene) const;
+    virtual v2f vert(const vdata & in, const Entity * entity, const Scene & scene) const;
     virtual vec4 frag(const v2f in, const Entity * entity, const Scene & scene) const;
+    virtual void fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const;
 };
 
 class TriangleNormalShader : public UnlitShader
 {
 public:
     virtual vec4 frag(const v2f in, const Entity * entity, const Scene & scene) const;
+    virtual void fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const;
 };
 
 class VertexNormalShader : public UnlitShader
 {
 public:
     virtual vec4 frag(const v2f in, const Entity * entity, const Scene & scene) const;
+    virtual void fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const;
 };
 
 class DepthShader : public UnlitShader
 {
 public:
     virtual vec4 frag(const v2f in, const Entity * entity, const Scene & scene) const;
+    virtual void fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const;
 };
 
 class LitShader : public Shader
 {
 public:
-    virtual v2f vert(const vdata in, const Entity * entity, const Scene & scene) const;
+    virtual v2f vert(const vdata & in, const Entity * entity, const Scene & scene) const;
 };
 
-class BlinnPhongShader : LitShader
+class BlinnPhongShader : public LitShader
 {
 public:
     virtual vec4 frag(const v2f in, const Entity * entity, const Scene & scene) const;
+    virtual void fragBatch(const v2f_batch & in, rgb_batch & out, const Entity * entity, const Scene & scene) const;
 };
 
 }
@@ -1,4 +1,5 @@
 #include "shaderf.hpp"
+#include "arena.hpp"
 
 using namespace Lurdr;
 
@@ -8,13 +9,9 @@ void * Lurdr::allocateOutBuffer(const size_t & size, size_t * allocated_sizes, c
     {
         return *buffer;
     }
-    else if (allocated_sizes[pos] > 0)
-    {
-        // already allocated, but different size
-        delete[] static_cast<char*>(*buffer);
-    }
+    // out buffers live in the arena of the running thread until the caller releases it
     allocated_sizes[pos] = size;
-    *buffer = (void *)new char[size];
+    *buffer = getThreadArena().allocate(size);
     return *buffer;
 }
 
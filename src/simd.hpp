@@ -0,0 +1,142 @@
+#ifndef __SIMD_HPP__
+#define __SIMD_HPP__
+
+// intrinsic headers go before global.hpp, which defines min/max/clamp macros
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <math.h>
+#include "global.hpp"
+
+namespace Lurdr
+{
+
+/**
+ * Thin wrapper over the widest float vector the target is compiled for,
+ * AVX2 (8 lanes), SSE2 (4 lanes) or plain float (1 lane) as a fallback.
+ * Loads and stores expect SIMD_WIDTH aligned pointers into batch arrays.
+ */
+#if defined(__AVX2__)
+
+#define SIMD_WIDTH 8
+typedef __m256 simd_float;
+
+inline simd_float simdSet(float a) { return _mm256_set1_ps(a); }
+inline simd_float simdLoad(const float * p) { return _mm256_load_ps(p); }
+inline void simdStore(float * p, simd_float a) { _mm256_store_ps(p, a); }
+inline simd_float simdAdd(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+inline simd_float simdSub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+inline simd_float simdMul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+inline simd_float simdDiv(simd_float a, simd_float b) { return _mm256_div_ps(a, b); }
+inline simd_float simdSqrt(simd_float a) { return _mm256_sqrt_ps(a); }
+inline simd_float simdMin(simd_float a, simd_float b) { return _mm256_min_ps(a, b); }
+inline simd_float simdMax(simd_float a, simd_float b) { return _mm256_max_ps(a, b); }
+inline simd_float simdTruncate(simd_float a) { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+// a < b ? if_true : if_false
+inline simd_float simdSelectLess(simd_float a, simd_float b, simd_float if_true, simd_float if_false)
+{
+    return _mm256_blendv_ps(if_false, if_true, _mm256_cmp_ps(a, b, _CMP_LT_OQ));
+}
+// a < b in any lane
+inline bool simdAnyLess(simd_float a, simd_float b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)) != 0; }
+
+#elif defined(__SSE2__)
+
+#define SIMD_WIDTH 4
+typedef __m128 simd_float;
+
+inline simd_float simdSet(float a) { return _mm_set1_ps(a); }
+inline simd_float simdLoad(const float * p) { return _mm_load_ps(p); }
+inline void simdStore(float * p, simd_float a) { _mm_store_ps(p, a); }
+inline simd_float simdAdd(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+inline simd_float simdSub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+inline simd_float simdMul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+inline simd_float simdDiv(simd_float a, simd_float b) { return _mm_div_ps(a, b); }
+inline simd_float simdSqrt(simd_float a) { return _mm_sqrt_ps(a); }
+inline simd_float simdMin(simd_float a, simd_float b) { return _mm_min_ps(a, b); }
+inline simd_float simdMax(simd_float a, simd_float b) { return _mm_max_ps(a, b); }
+// lanes are far below 2^31 wherever this is used
+inline simd_float simdTruncate(simd_float a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+// a < b ? if_true : if_false
+inline simd_float simdSelectLess(simd_float a, simd_float b, simd_float if_true, simd_float if_false)
+{
+    const simd_float mask = _mm_cmplt_ps(a, b);
+    return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+}
+// a < b in any lane
+inline bool simdAnyLess(simd_float a, simd_float b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)) != 0; }
+
+#else
+
+#define SIMD_WIDTH 1
+typedef float simd_float;
+
+inline simd_float simdSet(float a) { return a; }
+inline simd_float simdLoad(const float * p) { return *p; }
+inline void simdStore(float * p, simd_float a) { *p = a; }
+inline simd_float simdAdd(simd_float a, simd_float b) { return a + b; }
+inline simd_float simdSub(simd_float a, simd_float b) { return a - b; }
+inline simd_float simdMul(simd_float a, simd_float b) { return a * b; }
+inline simd_float simdDiv(simd_float a, simd_float b) { return a / b; }
+inline simd_float simdSqrt(simd_float a) { return sqrtf(a); }
+inline simd_float simdMin(simd_float a, simd_float b) { return a < b ? a : b; }
+inline simd_float simdMax(simd_float a, simd_float b) { return a > b ? a : b; }
+inline simd_float simdTruncate(simd_float a) { return truncf(a); }
+// a < b ? if_true : if_false
+inline simd_float simdSelectLess(simd_float a, simd_float b, simd_float if_true, simd_float if_false)
+{
+    return a < b ? if_true : if_false;
+}
+// a < b in any lane
+inline bool simdAnyLess(simd_float a, simd_float b) { return a < b; }
+
+#endif
+
+/**
+ * fill count 32-bit words at dst with value, used to clear the color and depth
+ * buffers, dst is best FRAME_BUFFER_ALIGNMENT aligned but does not have to be
+ */
+inline void simdFill32(void * dst, UINT32 value, long count)
+{
+    UINT32 *ptr = (UINT32*)dst;
+    long i = 0;
+#if defined(__AVX2__)
+    const __m256i v = _mm256_set1_epi32((int)value);
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i*)(ptr + i), v);
+    }
+#elif defined(__SSE2__)
+    const __m128i v = _mm_set1_epi32((int)value);
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128((__m128i*)(ptr + i), v);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        ptr[i] = value;
+    }
+}
+
+inline simd_float simdDot(simd_float ax, simd_float ay, simd_float az, simd_float bx, simd_float by, simd_float bz)
+{
+    return simdAdd(simdAdd(simdMul(ax, bx), simdMul(ay, by)), simdMul(az, bz));
+}
+
+// same arithmetic as Vector3::normalize
+inline void simdNormalize(simd_float & x, simd_float & y, simd_float & z)
+{
+    simd_float len = simdSqrt(simdDot(x, y, z, x, y, z));
+    len = simdSelectLess(len, simdSet(EPSILON), simdSet(1.0f), len);
+    const simd_float factor = simdDiv(simdSet(1.0f), len);
+    x = simdMul(x, factor);
+    y = simdMul(y, factor);
+    z = simdMul(z, factor);
+}
+
+}
+
+#endif
@@ -0,0 +1,750 @@
+#include "streaming.hpp"
+
+using namespace Lurdr;
+
+#define STREAM_LAYOUT ((UINT32)(sizeof(MeshVertex) | sizeof(vec3) << 8 | sizeof(StreamChunk) << 16 | sizeof(StreamLevel) << 24))
+
+static bool readAt(FILE * fp, UINT64 offset, void * data, size_t size)
+{
+#ifdef _WIN32
+    if (_fseeki64(fp, (__int64)offset, SEEK_SET) != 0) return false;
+#else
+    if (fseeko(fp, (off_t)offset, SEEK_SET) != 0) return false;
+#endif
+    return fread(data, 1, size, fp) == size;
+}
+
+static size_t levelBytes(size_t vertex_count, size_t face_count, UINT32 flags)
+{
+    return vertex_count * sizeof(MeshVertex) + face_count * 3 * sizeof(UINT32) +
+           ((flags & STREAM_TRIANGLE_NORMALS) ? face_count * sizeof(vec3) : 0);
+}
+
+static BoundingBox chunkBounds(const StreamChunk & chunk)
+{
+    return BoundingBox(
+        chunk.bounds[0], chunk.bounds[1], chunk.bounds[2],
+        chunk.bounds[3], chunk.bounds[4], chunk.bounds[5]);
+}
+
+/**
+ * Build
+ */
+
+struct FaceKey
+{
+    float   key;
+    UINT32  face;
+};
+
+static int compareFaceKey(const void * a, const void * b)
+{
+    const float key_a = ((const FaceKey*)a)->key;
+    const float key_b = ((const FaceKey*)b)->key;
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+struct StreamBuilder
+{
+    UINT32                      flags;
+    FILE                        *fp;
+    UINT64                      position;   // where the next level starts
+    DynamicArray<StreamChunk>   chunks;
+    DynamicArray<StreamLevel>   levels;
+    UINT64                      max_vertex_count;
+    UINT64                      max_face_count;
+    bool                        written;
+};
+
+static bool writeLevel(StreamBuilder & builder, const TriangleMesh * level, float error)
+{
+    StreamLevel entry;
+    entry.offset = builder.position;
+    entry.vertex_count = (UINT32)level->uniqueVertexCount();
+    entry.face_count = (UINT32)level->faceCount();
+    entry.error = error;
+    entry.reserved = 0;
+    builder.levels.push_back(entry);
+    builder.max_vertex_count = max(builder.max_vertex_count, (UINT64)entry.vertex_count);
+    builder.max_face_count = max(builder.max_face_count, (UINT64)entry.face_count);
+
+    const size_t vertex_bytes = entry.vertex_count * sizeof(MeshVertex);
+    const size_t index_bytes = entry.face_count * 3 * sizeof(UINT32);
+    bool written = fwrite(level->getWeldedVertices(), 1, vertex_bytes, builder.fp) == vertex_bytes &&
+                   fwrite(level->getIndices(), 1, index_bytes, builder.fp) == index_bytes;
+    if (builder.flags & STREAM_TRIANGLE_NORMALS)
+    {
+        const size_t normal_bytes = entry.face_count * sizeof(vec3);
+        written = written && fwrite(level->getTriangleNormals(), 1, normal_bytes, builder.fp) == normal_bytes;
+    }
+    builder.position += levelBytes(entry.vertex_count, entry.face_count, builder.flags);
+    return written;
+}
+
+TriangleMesh * StreamingMesh::extractChunk(const TriangleMesh & mesh, const UINT32 * faces, size_t face_count, long * remap)
+{
+    const UINT32 *indices = mesh.getIndices();
+    const MeshVertex *welded_vertices = mesh.getWeldedVertices();
+
+    TriangleMesh *chunk = new TriangleMesh();
+    chunk->m_face_count = face_count;
+    chunk->m_faces = new vec3i[face_count];
+    for (size_t fidx = 0; fidx < face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            const UINT32 vidx = indices[faces[fidx] * 3 + i];
+            if (remap[vidx] < 0)
+            {
+                remap[vidx] = chunk->m_vertex_count++;
+            }
+            chunk->m_faces[fidx][i] = remap[vidx];
+        }
+    }
+
+    // welded vertices are unique tuples already, every attribute uses the position indices
+    const size_t vertex_count = chunk->m_vertex_count;
+    chunk->m_vertices = new vec3[vertex_count];
+    if (mesh.m_has_vertex_normals)
+    {
+        chunk->m_normal_count = vertex_count;
+        chunk->m_vertex_normals = new vec3[vertex_count];
+        chunk->m_face_normals = new vec3i[face_count];
+        chunk->m_has_vertex_normals = true;
+    }
+    if (mesh.m_has_texture_coords)
+    {
+        chunk->m_texcoord_count = vertex_count;
+        chunk->m_texture_coords = new vec2[vertex_count];
+        chunk->m_face_texcoords = new vec3i[face_count];
+        chunk->m_has_texture_coords = true;
+    }
+    if (mesh.m_has_triangle_normals)
+    {
+        chunk->m_triangle_normals = new vec3[face_count];
+        chunk->m_has_triangle_normals = true;
+    }
+    for (size_t fidx = 0; fidx < face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            const UINT32 vidx = indices[faces[fidx] * 3 + i];
+            const long local = remap[vidx];
+            chunk->m_vertices[local] = welded_vertices[vidx].position;
+            if (chunk->m_vertex_normals) chunk->m_vertex_normals[local] = welded_vertices[vidx].normal;
+            if (chunk->m_texture_coords) chunk->m_texture_coords[local] = welded_vertices[vidx].texcoord;
+        }
+        if (chunk->m_face_normals)     chunk->m_face_normals[fidx] = chunk->m_faces[fidx];
+        if (chunk->m_face_texcoords)   chunk->m_face_texcoords[fidx] = chunk->m_faces[fidx];
+        if (chunk->m_triangle_normals) chunk->m_triangle_normals[fidx] = mesh.m_triangle_normals[faces[fidx]];
+    }
+    for (size_t fidx = 0; fidx < face_count; fidx++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            remap[indices[faces[fidx] * 3 + i]] = -1;
+        }
+    }
+
+    chunk->computeMeshCenter();
+    chunk->computeBoundingBox();
+    chunk->weldVertices();
+    if (mesh.isVertexCacheOptimized())
+    {
+        chunk->optimizeVertexCache();
+    }
+    return chunk;
+}
+
+/**
+ * the full resolution chunk and its simplified levels, each from the full
+ * chunk like TriangleMesh::buildLods, errors never decrease along the chain
+ */
+static bool writeChunk(StreamBuilder & builder, TriangleMesh * chunk)
+{
+    StreamChunk entry;
+    const BoundingBox bbox = chunk->getAxisAlignBoundingBox();
+    entry.bounds[0] = bbox.min_x;
+    entry.bounds[1] = bbox.min_y;
+    entry.bounds[2] = bbox.min_z;
+    entry.bounds[3] = bbox.max_x;
+    entry.bounds[4] = bbox.max_y;
+    entry.bounds[5] = bbox.max_z;
+    entry.first_level = (UINT32)builder.levels.size();
+    entry.level_count = 1;
+
+    bool written = writeLevel(builder, chunk, 0.0f);
+    float chain_error = 0.0f;
+    size_t face_count = chunk->faceCount();
+    while (written && entry.level_count <= LOD_MAX_LEVELS)
+    {
+        float error = 0.0f;
+        TriangleMesh *lod = chunk->simplify((size_t)(face_count * LOD_REDUCTION), &error);
+        if (lod->faceCount() == 0 || lod->faceCount() > face_count * LOD_MIN_REDUCTION)
+        {
+            delete lod;
+            break;
+        }
+        chain_error = max(chain_error, error);
+        written = writeLevel(builder, lod, chain_error);
+        entry.level_count++;
+        face_count = lod->faceCount();
+        delete lod;
+    }
+    builder.chunks.push_back(entry);
+    return written;
+}
+
+/**
+ * Chunks by recursive median splits of the face centroids along the longest
+ * axis of their bounds, neighbouring chunks are written next to each other
+ */
+bool StreamingMesh::build(const TriangleMesh & mesh, const char * filename, size_t chunk_face_count)
+{
+    assert(mesh.getWeldedVertices() || mesh.faceCount() == 0);
+    chunk_face_count = max(chunk_face_count, (size_t)1);
+
+    const size_t path_length = strlen(filename);
+    char *temp_path = new char[path_length + 5];
+    memcpy(temp_path, filename, path_length);
+    memcpy(temp_path + path_length, ".tmp", 5);
+    FILE *fp = fopen(temp_path, "wb");
+    if (fp == nullptr)
+    {
+        delete[] temp_path;
+        return false;
+    }
+
+    StreamHeader header;
+    memset(&header, 0, sizeof(header));
+
+    StreamBuilder builder;
+    builder.flags = (mesh.hasTriangleNormals() ? STREAM_TRIANGLE_NORMALS : 0) |
+                    (mesh.hasVertexNormals() ? STREAM_VERTEX_NORMALS : 0) |
+                    (mesh.hasTextureCoords() ? STREAM_TEXTURE_COORDS : 0);
+    builder.fp = fp;
+    builder.position = sizeof(StreamHeader);
+    builder.max_vertex_count = 0;
+    builder.max_face_count = 0;
+    builder.written = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    const size_t face_count = mesh.faceCount();
+    const UINT32 *indices = mesh.getIndices();
+    const MeshVertex *welded_vertices = mesh.getWeldedVertices();
+    UINT32 *faces = new UINT32[max(face_count, (size_t)1)];
+    vec3 *centroids = new vec3[max(face_count, (size_t)1)];
+    FaceKey *keys = new FaceKey[max(face_count, (size_t)1)];
+    // welded vertex of the mesh to vertex of the chunk being extracted
+    long *remap = new long[max(mesh.uniqueVertexCount(), (size_t)1)];
+    memset(remap, -1, mesh.uniqueVertexCount() * sizeof(long));
+    for (size_t fidx = 0; fidx < face_count; fidx++)
+    {
+        faces[fidx] = (UINT32)fidx;
+        centroids[fidx] = (welded_vertices[indices[fidx * 3 + 0]].position +
+                           welded_vertices[indices[fidx * 3 + 1]].position +
+                           welded_vertices[indices[fidx * 3 + 2]].position) * (1.0f / 3.0f);
+    }
+
+    // face ranges left to split, the first half is popped first
+    DynamicArray<size_t> ranges;
+    if (face_count > 0)
+    {
+        ranges.push_back(0);
+        ranges.push_back(face_count);
+    }
+    while (builder.written && ranges.size() > 0)
+    {
+        const size_t end = ranges[ranges.size() - 1];
+        ranges.pop_back();
+        const size_t begin = ranges[ranges.size() - 1];
+        ranges.pop_back();
+
+        if (end - begin <= chunk_face_count)
+        {
+            TriangleMesh *chunk = extractChunk(mesh, faces + begin, end - begin, remap);
+            builder.written = writeChunk(builder, chunk);
+            delete chunk;
+            continue;
+        }
+
+        vec3 min_bound = centroids[faces[begin]];
+        vec3 max_bound = min_bound;
+        for (size_t i = begin; i < end; i++)
+        {
+            const vec3 & c = centroids[faces[i]];
+            min_bound = vec3(min(min_bound.x, c.x), min(min_bound.y, c.y), min(min_bound.z, c.z));
+            max_bound = vec3(max(max_bound.x, c.x), max(max_bound.y, c.y), max(max_bound.z, c.z));
+        }
+        const vec3 extent = max_bound - min_bound;
+        const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        for (size_t i = begin; i < end; i++)
+        {
+            const vec3 & c = centroids[faces[i]];
+            keys[i].key = axis == 0 ? c.x : (axis == 1 ? c.y : c.z);
+            keys[i].face = faces[i];
+        }
+        ::qsort(keys + begin, end - begin, sizeof(FaceKey), compareFaceKey);
+        for (size_t i = begin; i < end; i++)
+        {
+            faces[i] = keys[i].face;
+        }
+
+        const size_t middle = begin + (end - begin) / 2;
+        ranges.push_back(middle);
+        ranges.push_back(end);
+        ranges.push_back(begin);
+        ranges.push_back(middle);
+    }
+
+    delete[] faces;
+    delete[] centroids;
+    delete[] keys;
+    delete[] remap;
+
+    const BoundingBox bbox = mesh.getAxisAlignBoundingBox();
+    header.magic = STREAM_MAGIC;
+    header.version = STREAM_VERSION;
+    header.layout = STREAM_LAYOUT;
+    header.flags = builder.flags;
+    header.chunk_count = builder.chunks.size();
+    header.level_count = builder.levels.size();
+    header.max_vertex_count = builder.max_vertex_count;
+    header.max_face_count = builder.max_face_count;
+    header.face_count = face_count;
+    header.chunk_offset = builder.position;
+    header.level_offset = builder.position + builder.chunks.size() * sizeof(StreamChunk);
+    header.bounds[0] = bbox.min_x;
+    header.bounds[1] = bbox.min_y;
+    header.bounds[2] = bbox.min_z;
+    header.bounds[3] = bbox.max_x;
+    header.bounds[4] = bbox.max_y;
+    header.bounds[5] = bbox.max_z;
+
+    bool written = builder.written &&
+        fwrite(builder.chunks.data(), sizeof(StreamChunk), builder.chunks.size(), fp) == builder.chunks.size() &&
+        fwrite(builder.levels.data(), sizeof(StreamLevel), builder.levels.size(), fp) == builder.levels.size() &&
+        fseek(fp, 0, SEEK_SET) == 0 &&
+        fwrite(&header, sizeof(header), 1, fp) == 1;
+    written = fclose(fp) == 0 && written;
+
+    // written aside and renamed like the mesh cache
+    if (written)
+    {
+        remove(filename);
+        written = rename(temp_path, filename) == 0;
+    }
+    if (!written)
+    {
+        remove(temp_path);
+    }
+    delete[] temp_path;
+    return written;
+}
+
+/**
+ * Streaming
+ */
+
+struct StreamRequest
+{
+    UINT32  chunk;
+    UINT32  level;          // into the level table
+    float   screen_size;    // misses of larger chunks are read first
+};
+
+static int compareRequest(const void * a, const void * b)
+{
+    const float size_a = ((const StreamRequest*)a)->screen_size;
+    const float size_b = ((const StreamRequest*)b)->screen_size;
+    return size_a > size_b ? -1 : (size_a < size_b ? 1 : 0);
+}
+
+struct Lurdr::StreamingMeshContext
+{
+    FILE            *file;
+    StreamHeader    header;
+    StreamChunk     *chunks;
+    StreamLevel     *levels;
+    long            *level_slots;       // slot holding every level, -1 if not resident
+    TriangleMesh    *slots;             // arrays sized for the largest level
+    long            *slot_levels;       // level in every slot, -1 if free
+    long            *slot_prev;         // recently used list, most recent at lru_head
+    long            *slot_next;
+    UINT64          *slot_updates;      // update that drew from the slot, kept for it
+    float           *slot_screen_sizes; // of the chunk drawn from the slot in that update
+    size_t          slot_count;
+    long            lru_head;
+    long            lru_tail;
+    UINT64          update;
+    DynamicArray<StreamRequest>         visible;
+    DynamicArray<StreamRequest>         misses;
+    DynamicArray<const TriangleMesh*>   draw_meshes;
+    StreamingStatistics                 statistics;
+};
+
+// move the slot to the front of the recently used list
+static void touchSlot(StreamingMeshContext * context, long slot)
+{
+    if (context->lru_head == slot)
+    {
+        return;
+    }
+    const long prev = context->slot_prev[slot];
+    const long next = context->slot_next[slot];
+    context->slot_next[prev] = next;
+    if (next >= 0)
+    {
+        context->slot_prev[next] = prev;
+    }
+    else
+    {
+        context->lru_tail = prev;
+    }
+    context->slot_prev[slot] = -1;
+    context->slot_next[slot] = context->lru_head;
+    context->slot_prev[context->lru_head] = slot;
+    context->lru_head = slot;
+}
+
+// the slot is drawn from in the current update, loads only evict it for a larger chunk
+static void useSlot(StreamingMeshContext * context, long slot, float screen_size)
+{
+    touchSlot(context, slot);
+    context->slot_updates[slot] = context->update;
+    context->slot_screen_sizes[slot] = screen_size;
+}
+
+// resident level of the chunk closest to level, coarser first, -1 if none
+static long closestResidentLevel(const StreamingMeshContext * context, const StreamRequest & request)
+{
+    const StreamChunk & chunk = context->chunks[request.chunk];
+    const long first = chunk.first_level;
+    const long last = first + chunk.level_count - 1;
+    for (long distance = 1; distance < (long)chunk.level_count; distance++)
+    {
+        const long coarser = (long)request.level + distance;
+        const long finer = (long)request.level - distance;
+        if (coarser <= last && context->level_slots[coarser] >= 0) return coarser;
+        if (finer >= first && context->level_slots[finer] >= 0) return finer;
+    }
+    return -1;
+}
+
+StreamingMesh::StreamingMesh(const char * filename, size_t cache_size)
+{
+    m_context = new StreamingMeshContext();
+    StreamingMeshContext *context = m_context;
+    context->chunks = nullptr;
+    context->levels = nullptr;
+    context->level_slots = nullptr;
+    context->slots = nullptr;
+    context->slot_levels = nullptr;
+    context->slot_prev = nullptr;
+    context->slot_next = nullptr;
+    context->slot_updates = nullptr;
+    context->slot_screen_sizes = nullptr;
+    context->slot_count = 0;
+    context->lru_head = -1;
+    context->lru_tail = -1;
+    context->update = 0;
+    memset(&context->header, 0, sizeof(StreamHeader));
+    memset(&context->statistics, 0, sizeof(StreamingStatistics));
+
+    context->file = fopen(filename, "rb");
+    if (context->file == nullptr)
+    {
+        printf("StreamingMesh : %s open failed\n", filename);
+        return;
+    }
+
+    StreamHeader & header = context->header;
+    bool valid = readAt(context->file, 0, &header, sizeof(header)) &&
+                 header.magic == STREAM_MAGIC &&
+                 header.version == STREAM_VERSION &&
+                 header.layout == STREAM_LAYOUT &&
+                 header.level_count < ((UINT64)1 << 32) && header.chunk_count <= header.level_count;
+    if (valid)
+    {
+        context->chunks = new StreamChunk[max(header.chunk_count, (UINT64)1)];
+        context->levels = new StreamLevel[max(header.level_count, (UINT64)1)];
+        valid = readAt(context->file, header.chunk_offset, context->chunks, header.chunk_count * sizeof(StreamChunk)) &&
+                readAt(context->file, header.level_offset, context->levels, header.level_count * sizeof(StreamLevel));
+        for (size_t c = 0; valid && c < header.chunk_count; c++)
+        {
+            valid = context->chunks[c].level_count > 0 &&
+                    (UINT64)context->chunks[c].first_level + context->chunks[c].level_count <= header.level_count;
+        }
+        for (size_t l = 0; valid && l < header.level_count; l++)
+        {
+            valid = context->levels[l].vertex_count <= header.max_vertex_count &&
+                    context->levels[l].face_count <= header.max_face_count;
+        }
+    }
+    if (!valid)
+    {
+        printf("StreamingMesh : %s is not a streaming mesh of this build\n", filename);
+        delete[] context->chunks;
+        delete[] context->levels;
+        context->chunks = nullptr;
+        context->levels = nullptr;
+        fclose(context->file);
+        context->file = nullptr;
+        return;
+    }
+
+    context->level_slots = new long[max(header.level_count, (UINT64)1)];
+    for (size_t l = 0; l < header.level_count; l++)
+    {
+        context->level_slots[l] = -1;
+    }
+
+    // every slot takes the largest level, the cache never allocates after this
+    const size_t slot_bytes = max(levelBytes(header.max_vertex_count, header.max_face_count, header.flags), (size_t)1);
+    context->slot_count = max(cache_size / slot_bytes, (size_t)1);
+    context->slots = new TriangleMesh[context->slot_count];
+    context->slot_levels = new long[context->slot_count];
+    context->slot_prev = new long[context->slot_count];
+    context->slot_next = new long[context->slot_count];
+    context->slot_updates = new UINT64[context->slot_count];
+    context->slot_screen_sizes = new float[context->slot_count];
+    for (size_t s = 0; s < context->slot_count; s++)
+    {
+        TriangleMesh & slot = context->slots[s];
+        slot.m_welded_vertices = new MeshVertex[max(header.max_vertex_count, (UINT64)1)];
+        slot.m_indices = new UINT32[max(header.max_face_count * 3, (UINT64)1)];
+        if (header.flags & STREAM_TRIANGLE_NORMALS)
+        {
+            slot.m_triangle_normals = new vec3[max(header.max_face_count, (UINT64)1)];
+            slot.m_has_triangle_normals = true;
+        }
+        slot.m_has_vertex_normals = (header.flags & STREAM_VERTEX_NORMALS) != 0;
+        slot.m_has_texture_coords = (header.flags & STREAM_TEXTURE_COORDS) != 0;
+        context->slot_levels[s] = -1;
+        context->slot_prev[s] = (long)s - 1;
+        context->slot_next[s] = s + 1 < context->slot_count ? (long)s + 1 : -1;
+        context->slot_updates[s] = 0;
+        context->slot_screen_sizes[s] = 0.0f;
+    }
+    context->lru_head = 0;
+    context->lru_tail = (long)context->slot_count - 1;
+    context->statistics.slot_count = context->slot_count;
+    context->statistics.slot_bytes = slot_bytes;
+}
+
+StreamingMesh::~StreamingMesh()
+{
+    if (m_context->file) fclose(m_context->file);
+    delete[] m_context->chunks;
+    delete[] m_context->levels;
+    delete[] m_context->level_slots;
+    delete[] m_context->slots;
+    delete[] m_context->slot_levels;
+    delete[] m_context->slot_prev;
+    delete[] m_context->slot_next;
+    delete[] m_context->slot_updates;
+    delete[] m_context->slot_screen_sizes;
+    delete m_context;
+}
+
+/**
+ * read a level into the least recently used slot. Slots drawn from in this
+ * update are at the front of the list, once the last one is too the cache
+ * holds fewer levels than there are visible chunks and the level of the
+ * smallest chunk on screen is evicted if it is smaller than this one.
+ */
+bool StreamingMesh::loadLevel(size_t chunk, size_t level, float screen_size)
+{
+    StreamingMeshContext *context = m_context;
+    long slot = context->lru_tail;
+    if (context->slot_updates[slot] == context->update)
+    {
+        for (size_t s = 0; s < context->slot_count; s++)
+        {
+            if (context->slot_screen_sizes[s] < context->slot_screen_sizes[slot])
+            {
+                slot = (long)s;
+            }
+        }
+        if (context->slot_screen_sizes[slot] >= screen_size)
+        {
+            return false;
+        }
+    }
+    if (context->slot_levels[slot] >= 0)
+    {
+        context->level_slots[context->slot_levels[slot]] = -1;
+        context->slot_levels[slot] = -1;
+        context->statistics.evictions++;
+        context->statistics.resident_count--;
+    }
+
+    const StreamLevel & entry = context->levels[level];
+    TriangleMesh & mesh = context->slots[slot];
+    const size_t vertex_bytes = entry.vertex_count * sizeof(MeshVertex);
+    const size_t index_bytes = entry.face_count * 3 * sizeof(UINT32);
+    bool read = readAt(context->file, entry.offset, mesh.m_welded_vertices, vertex_bytes) &&
+                fread(mesh.m_indices, 1, index_bytes, context->file) == index_bytes;
+    if (context->header.flags & STREAM_TRIANGLE_NORMALS)
+    {
+        const size_t normal_bytes = entry.face_count * sizeof(vec3);
+        read = read && fread(mesh.m_triangle_normals, 1, normal_bytes, context->file) == normal_bytes;
+    }
+    if (!read)
+    {
+        return false;
+    }
+
+    // coarser levels keep a subset of the full resolution vertices, the chunk bounds hold for all
+    mesh.m_unique_vertex_count = entry.vertex_count;
+    mesh.m_face_count = entry.face_count;
+    mesh.m_bounding_box = chunkBounds(context->chunks[chunk]);
+    mesh.m_mesh_center = (mesh.getMinBound() + mesh.getMaxBound()) * 0.5f;
+    context->slot_levels[slot] = (long)level;
+    context->level_slots[level] = slot;
+    useSlot(context, slot, screen_size);
+    context->statistics.loads++;
+    context->statistics.bytes_read += levelBytes(entry.vertex_count, entry.face_count, context->header.flags);
+    context->statistics.resident_count++;
+    return true;
+}
+
+void StreamingMesh::update(const mat4 & mvp, float viewport_height)
+{
+    StreamingMeshContext *context = m_context;
+    StreamingStatistics & statistics = context->statistics;
+    context->visible.clear();
+    context->misses.clear();
+    context->draw_meshes.clear();
+    statistics.chunks_visible = 0;
+    statistics.chunks_drawn = 0;
+    statistics.chunks_fallback = 0;
+    statistics.chunks_missing = 0;
+    if (context->file == nullptr)
+    {
+        return;
+    }
+    context->update++;
+
+    // wanted level of every visible chunk, the closest resident level of a
+    // miss moves up the recently used list but may still be evicted below
+    for (size_t c = 0; c < context->header.chunk_count; c++)
+    {
+        const StreamChunk & chunk = context->chunks[c];
+        const BoundingBox bbox = chunkBounds(chunk);
+        if (testFrustum(bbox, mvp) == FRUSTUM_OUTSIDE)
+        {
+            continue;
+        }
+
+        // pixels per model unit from the projected bounds
+        const float screen_size = projectScreenSize(bbox, mvp);
+        const float half_extent = 0.5f * max(bbox.max_x - bbox.min_x, max(bbox.max_y - bbox.min_y, bbox.max_z - bbox.min_z));
+        UINT32 level = chunk.first_level;
+        if (screen_size < FLT_MAX && half_extent > 0.0f)
+        {
+            const float pixels_per_unit = screen_size * viewport_height * 0.5f / half_extent;
+            for (UINT32 l = chunk.first_level + chunk.level_count - 1; l > chunk.first_level; l--)
+            {
+                if (context->levels[l].error * pixels_per_unit <= STREAM_PIXEL_ERROR)
+                {
+                    level = l;
+                    break;
+                }
+            }
+        }
+
+        const StreamRequest request = { (UINT32)c, level, screen_size };
+        context->visible.push_back(request);
+        statistics.requests++;
+        if (context->level_slots[level] >= 0)
+        {
+            statistics.hits++;
+            useSlot(context, context->level_slots[level], screen_size);
+            continue;
+        }
+        statistics.misses++;
+        context->misses.push_back(request);
+        const long fallback = closestResidentLevel(context, request);
+        if (fallback >= 0)
+        {
+            touchSlot(context, context->level_slots[fallback]);
+        }
+    }
+
+    ::qsort(context->misses.data(), context->misses.size(), sizeof(StreamRequest), compareRequest);
+    size_t loads = 0;
+    for (size_t m = 0; m < context->misses.size(); m++)
+    {
+        const StreamRequest & request = context->misses[m];
+        if (loads < STREAM_LOADS_PER_UPDATE && loadLevel(request.chunk, request.level, request.screen_size))
+        {
+            loads++;
+        }
+        else
+        {
+            statistics.deferred++;
+        }
+    }
+
+    for (size_t v = 0; v < context->visible.size(); v++)
+    {
+        const StreamRequest & request = context->visible[v];
+        long level = request.level;
+        if (context->level_slots[level] < 0)
+        {
+            level = closestResidentLevel(context, request);
+            if (level < 0)
+            {
+                statistics.chunks_missing++;
+                continue;
+            }
+            statistics.chunks_fallback++;
+        }
+        context->draw_meshes.push_back(&context->slots[context->level_slots[level]]);
+    }
+    statistics.chunks_visible = context->visible.size();
+    statistics.chunks_drawn = context->draw_meshes.size();
+}
+
+bool StreamingMesh::isOpen() const
+{
+    return m_context->file != nullptr;
+}
+
+BoundingBox StreamingMesh::getAxisAlignBoundingBox() const
+{
+    const float *bounds = m_context->header.bounds;
+    return BoundingBox(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+}
+
+size_t StreamingMesh::chunkCount() const
+{
+    return m_context->header.chunk_count;
+}
+
+size_t StreamingMesh::drawCount() const
+{
+    return m_context->draw_meshes.size();
+}
+
+const TriangleMesh * StreamingMesh::getDrawMesh(size_t index) const
+{
+    return m_context->draw_meshes[index];
+}
+
+const StreamingStatistics & StreamingMesh::getStatistics() const
+{
+    return m_context->statistics;
+}
+
+void StreamingMesh::resetStatistics()
+{
+    StreamingStatistics & statistics = m_context->statistics;
+    statistics.requests = 0;
+    statistics.hits = 0;
+    statistics.misses = 0;
+    statistics.loads = 0;
+    statistics.evictions = 0;
+    statistics.deferred = 0;
+    statistics.bytes_read = 0;
+}
@@ -0,0 +1,146 @@
+#ifndef __STREAMING_HPP__
+#define __STREAMING_HPP__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "global.hpp"
+#include "maths.hpp"
+#include "mesh.hpp"
+
+namespace Lurdr
+{
+
+#define STREAM_MAGIC 0x4d52534cu    // "LSRM"
+#define STREAM_VERSION 1
+#define STREAM_TRIANGLE_NORMALS 0x1
+#define STREAM_VERTEX_NORMALS   0x2
+#define STREAM_TEXTURE_COORDS   0x4
+
+// faces of a chunk at full resolution at most, chunks hold half that at least
+#define STREAM_CHUNK_FACES 4096
+// default bytes of chunk levels a streaming mesh keeps in memory
+#define STREAM_CACHE_SIZE (64 << 20)
+// chunks are drawn at the coarsest level moving the surface by at most this many pixels
+#define STREAM_PIXEL_ERROR 1.0f
+// chunk levels read from disk per update, the other misses wait for later frames
+#define STREAM_LOADS_PER_UPDATE 16
+
+/**
+ * Start of a streaming mesh file. The chunk table and the level table sit
+ * at the end of the file, every level is the welded vertices, the indices
+ * and, with STREAM_TRIANGLE_NORMALS, the triangle normals of one level of
+ * detail of one chunk, stored at its offset in the in-memory layout.
+ */
+struct StreamHeader
+{
+    UINT32  magic;
+    UINT32  version;
+    UINT32  layout;
+    UINT32  flags;
+    UINT64  chunk_count;
+    UINT64  level_count;            // over all chunks
+    UINT64  max_vertex_count;       // of the largest level, sizes the cache slots
+    UINT64  max_face_count;
+    UINT64  face_count;             // of the full resolution mesh
+    UINT64  chunk_offset;
+    UINT64  level_offset;
+    float   bounds[6];
+};
+
+struct StreamChunk
+{
+    float   bounds[6];
+    UINT32  first_level;            // into the level table, full resolution first
+    UINT32  level_count;
+};
+
+struct StreamLevel
+{
+    UINT64  offset;
+    UINT32  vertex_count;
+    UINT32  face_count;
+    float   error;                  // farthest a vertex moved from the full resolution chunk, model units
+    UINT32  reserved;
+};
+
+/**
+ * counters of a streaming mesh, the cache ones add up since it was opened or
+ * resetStatistics(), the chunk ones are of the last update
+ */
+struct StreamingStatistics
+{
+    long    requests;           // chunk levels wanted by updates
+    long    hits;               // wanted level was resident
+    long    misses;
+    long    loads;              // levels read from disk
+    long    evictions;          // least recently used levels dropped for a load
+    long    deferred;           // misses left to later updates, by the load limit or a cache full of levels in use
+    UINT64  bytes_read;
+    long    chunks_visible;
+    long    chunks_drawn;
+    long    chunks_fallback;    // drawn at another resident level than the wanted one
+    long    chunks_missing;     // visible without any resident level, not drawn
+    size_t  resident_count;
+    size_t  slot_count;         // levels the cache holds at most
+    size_t  slot_bytes;
+};
+
+struct StreamingMeshContext;
+
+/**
+ * Out of core mesh. StreamingMesh::build splits a mesh into spatial chunks of
+ * at most STREAM_CHUNK_FACES faces with a chain of simplified levels each and
+ * writes them to a file, chunk borders are kept by simplification so chunks
+ * at different levels meet without cracks. An opened streaming mesh only
+ * reads the tables, levels are read into a fixed number of cache slots sized
+ * for the largest level, the least recently used slot is reused once the
+ * cache is full. Every update picks the visible chunks and their levels by
+ * screen space error, reads missing levels and lists what to draw.
+ */
+class StreamingMesh
+{
+private:
+    StreamingMeshContext *m_context;
+
+    bool loadLevel(size_t chunk, size_t level, float screen_size);
+    // faces of mesh as a mesh of their own, remap has -1 for every welded vertex and is left so
+    static TriangleMesh * extractChunk(const TriangleMesh & mesh, const UINT32 * faces, size_t face_count, long * remap);
+
+public:
+    // memory for chunk levels stays within cache_size, at least one level is kept
+    StreamingMesh(const char * filename, size_t cache_size = STREAM_CACHE_SIZE);
+    ~StreamingMesh();
+
+    StreamingMesh(const StreamingMesh &) = delete;
+    StreamingMesh& operator= (const StreamingMesh &) = delete;
+
+    /**
+     * write mesh as a streaming mesh file, the source has to fit in memory once,
+     * returns false if the file cannot be written
+     */
+    static bool build(const TriangleMesh & mesh, const char * filename, size_t chunk_face_count = STREAM_CHUNK_FACES);
+
+    // false if the file is missing or not a streaming mesh of this build
+    bool isOpen() const;
+    BoundingBox getAxisAlignBoundingBox() const;
+    size_t chunkCount() const;
+
+    /**
+     * select the chunks inside the view volume of the model-view-projection
+     * matrix mvp at the level for viewport_height pixels, read up to
+     * STREAM_LOADS_PER_UPDATE missing levels and list the resident meshes to
+     * draw, a chunk whose level is not resident is drawn at the closest
+     * resident one. The listed meshes stay valid until the next update.
+     */
+    void update(const mat4 & mvp, float viewport_height);
+    size_t drawCount() const;
+    const TriangleMesh * getDrawMesh(size_t index) const;
+
+    const StreamingStatistics & getStatistics() const;
+    void resetStatistics();
+};
+
+}
+
+#endif
@@ -22,5 +22,11 @@ int test_basic();
 int test_shader();
 int test_pipeline();
 int test_colormap();
+int test_envmap();
+int test_batch(long frame_count, const char * output, const char * config_file, long width, long height);
+int test_bench(long frame_count, const char * output, long thread_count);
+int test_darray(long element_count, long repeat);
+int test_mesh();
+int test_bvh();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include <atomic>
+#include "test.hpp"
+
+using namespace Lurdr;
+
+// frames in flight, frame N + 1 renders while frame N is written out
+#define BATCH_FRAME_BUFFERS 3
+
+struct BatchOutput
+{
+    const char  *output;
+    FILE        *stream;
+    long        width;
+    long        height;
+    double      present_time;
+    std::atomic<bool> failed;
+};
+
+// runs on the present thread of the frame ring
+static void writeFrame(const FrameBuffer & frame_buffer, UINT64 frame, void * data)
+{
+    BatchOutput *out = (BatchOutput*)data;
+    double present_start = getTimeMilliseconds();
+    if (out->stream)
+    {
+        fwrite(frame_buffer.colorBuffer(), 3, out->width * out->height, out->stream);
+    }
+    else
+    {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), out->output, (long)frame);
+        FILE *fp = fopen(filename, "wb");
+        if (fp == nullptr)
+        {
+            printf("Batch : frame file: %s open failed\n", filename);
+            out->failed = true;
+            return;
+        }
+        fprintf(fp, "P6\n%ld %ld\n255\n", out->width, out->height);
+        fwrite(frame_buffer.colorBuffer(), 3, out->width * out->height, fp);
+        fclose(fp);
+    }
+    out->present_time += getTimeMilliseconds() - present_start;
+}
+
+/**
+ * Batch mode, renders a scripted camera orbit around the entity of config
+ * over frame_count frames without any window.
+ * output is either a printf pattern like "frames/frame_%04ld.ppm", every frame
+ * is written as a binary PPM, or a path ending in ".raw", all frames are
+ * appended to it as a headerless 24-bit RGB stream (top row first), which can
+ * be a named pipe into a video encoder.
+ * Frames are written by the present thread of a frame ring, so the output
+ * cost hides behind rendering the following frames.
+ */
+int test_batch(long frame_count, const char * output, const char * config_file, long width, long height)
+{
+    entityConf config(config_file);
+    Entity ent = Entity(config);
+    ent.getTriangleMesh()->computeTriangleNormals();
+    ent.getTriangleMesh()->computeVertexNormals();
+
+    DirectionalLight dir_light(
+        vec3(0.0f, 0.0f, 0.0f),
+        vec3(1.0f, -1.0f, 1.0f),
+        vec3(1.0f, 1.0f, 1.0f),
+        vec3(1.0f, 1.0f, 1.0f)
+    );
+
+    Scene scene;
+    scene.addEntity(&ent);
+    scene.addLight((Light*)&dir_light);
+
+    BlinnPhongShader shader;
+
+    LURDR_WIREFRAME_MODE(false);
+    LURDR_BACKFACE_CULLING(true);
+    LURDR_DEPTH_TEST(true);
+
+    BatchOutput out;
+    out.output = output;
+    out.stream = nullptr;
+    out.width = width;
+    out.height = height;
+    out.present_time = 0.0;
+    out.failed = false;
+    const size_t output_len = strlen(output);
+    if (output_len >= 4 && strcmp(output + output_len - 4, ".raw") == 0)
+    {
+        out.stream = fopen(output, "wb");
+        if (out.stream == nullptr)
+        {
+            printf("Batch : output file: %s open failed\n", output);
+            return 1;
+        }
+        // a whole frame per write call
+        setvbuf(out.stream, nullptr, _IOFBF, width * height * 3);
+    }
+    FrameRing frame_ring(BATCH_FRAME_BUFFERS, width, height, writeFrame, &out);
+
+    // keep the whole mesh in view whatever its scale
+    const vec3 mesh_center = ent.getTriangleMesh()->getMeshCenter();
+    const BoundingBox bbox = ent.getTriangleMesh()->getAxisAlignBoundingBox();
+    const float view_distance = 1.5f * max(bbox.max_x - bbox.min_x, max(bbox.max_y - bbox.min_y, bbox.max_z - bbox.min_z));
+
+    double render_time = 0.0;
+    double start_time = getTimeMilliseconds();
+    for (long frame = 0; frame < frame_count && !out.failed; frame++)
+    {
+        // one full orbit over the batch while bobbing up and down once
+        const float t = (float)frame / frame_count;
+        const float angle = 2.0f * PI * t;
+        vec3 eye = vec3(
+            sinf(angle) * view_distance,
+            sinf(angle) * view_distance * 0.25f,
+            -cosf(angle) * view_distance
+        );
+        scene.getCamera().setTransform(mesh_center + eye, mesh_center);
+
+        FrameBuffer & frame_buffer = frame_ring.acquire();
+        double frame_start = getTimeMilliseconds();
+        frame_buffer.clearColorBuffer(rgb(0.0f, 0.0f, 0.0f));
+        Pipeline::draw(frame_buffer, scene, &shader);
+        render_time += getTimeMilliseconds() - frame_start;
+        frame_ring.submit();
+    }
+    frame_ring.flush();
+    double total_time = getTimeMilliseconds() - start_time;
+
+    if (out.stream)
+    {
+        fclose(out.stream);
+    }
+
+    printf("Batch : %ld frames %ldx%ld, render %.2f ms/frame, output %.2f ms/frame, total %.2f ms/frame\n",
+        frame_count, width, height,
+        render_time / max(frame_count, 1L), out.present_time / max(frame_count, 1L),
+        total_time / max(frame_count, 1L));
+    return out.failed ? 1 : 0;
+}
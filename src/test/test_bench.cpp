@@ -0,0 +1,195 @@
+#include "test.hpp"
+
+using namespace Lurdr;
+
+/**
+ * Benchmark suite, renders the same fixed camera orbit for every asset,
+ * shader and resolution below and appends one CSV row per combination to
+ * output, so runs on different builds or machines can be diffed directly.
+ *
+ * columns
+ *   asset, shader, width, height, threads, frames : the configuration
+ *   ms_mean, ms_p50, ms_p90, ms_p99, ms_max       : wall time of Pipeline::draw + clear
+ *   triangles_per_s        : triangles of the full mesh
+ *   covered_pixels_per_s   : pixels covered at the end of the frame
+ *   unique_vertices_per_s  : unique vertices of the full mesh
+ *   fragments_shaded_per_s : PipelineStatistics::fragments_shaded, overdraw and depth prepass included
+ *   vertices_shaded_per_s  : PipelineStatistics::vertices_shaded, after culling and level of detail
+ * the last two are 0 unless the tree is built with pipeline statistics, as
+ * make bench does, whose counters and stage timers add to the frame times
+ */
+
+static const char * bench_assets[] = {
+    "assets/bunny.txt",
+    "assets/spot.txt",
+    "assets/teapot_low.txt",
+    "assets/teapot_high.txt",
+    "assets/sphere.txt",
+    "assets/f16.txt"
+};
+
+static const long bench_resolutions[][2] = {
+    { 256, 256 },
+    { 512, 512 },
+    { 1280, 720 }
+};
+
+// frames rendered before timing starts, warms caches and the thread pool
+#define BENCH_WARMUP_FRAMES 2
+
+static bool lessThan(const double & a, const double & b)
+{
+    return a < b;
+}
+
+// nearest-rank percentile of sorted values
+static double percentile(const DynamicArray<double> & sorted, double p)
+{
+    long rank = (long)ceil(p / 100.0 * sorted.size());
+    return sorted[clamp(rank - 1, 0L, (long)sorted.size() - 1)];
+}
+
+static long countCoveredPixels(const FrameBuffer & frame_buffer)
+{
+    long covered = 0;
+    const float *depth_buffer = frame_buffer.depthBuffer();
+    for (long i = 0; i < frame_buffer.getSize(); i++)
+    {
+        covered += depth_buffer[i] < 1.0f;
+    }
+    return covered;
+}
+
+int test_bench(long frame_count, const char * output, long thread_count)
+{
+    if (frame_count < 1)
+    {
+        printf("Bench : frame count must be at least 1, got %ld\n", frame_count);
+        return 1;
+    }
+    LURDR_THREAD_COUNT(thread_count);
+
+    FILE *fp = fopen(output, "w");
+    if (fp == nullptr)
+    {
+        printf("Bench : output file: %s open failed\n", output);
+        return 1;
+    }
+    fprintf(fp, "asset,shader,width,height,threads,frames,"
+                "ms_mean,ms_p50,ms_p90,ms_p99,ms_max,"
+                "triangles_per_s,covered_pixels_per_s,unique_vertices_per_s,"
+                "fragments_shaded_per_s,vertices_shaded_per_s\n");
+
+    DirectionalLight dir_light(
+        vec3(0.0f, 0.0f, 0.0f),
+        vec3(1.0f, -1.0f, 1.0f),
+        vec3(1.0f, 1.0f, 1.0f),
+        vec3(1.0f, 1.0f, 1.0f)
+    );
+
+    UnlitShader unlit_shader;
+    VertexNormalShader vertex_normal_shader;
+    TriangleNormalShader triangle_normal_shader;
+    DepthShader depth_shader;
+    BlinnPhongShader blinn_phong_shader;
+
+    const long shader_count = 5;
+    const Shader* shaders[shader_count] = {
+        &unlit_shader,
+        &vertex_normal_shader,
+        &triangle_normal_shader,
+        &depth_shader,
+        &blinn_phong_shader
+    };
+    const char * shader_names[shader_count] = {
+        "unlit", "vertex_normal", "triangle_normal", "depth", "blinn_phong"
+    };
+
+    LURDR_WIREFRAME_MODE(false);
+    LURDR_BACKFACE_CULLING(true);
+    LURDR_DEPTH_TEST(true);
+
+    DynamicArray<double> frame_times;
+    for (size_t a = 0; a < sizeof(bench_assets) / sizeof(bench_assets[0]); a++)
+    {
+        entityConf config(bench_assets[a]);
+        Entity ent = Entity(config);
+        const TriangleMesh *mesh = ent.getTriangleMesh();
+        if (mesh == nullptr || mesh->faceCount() == 0)
+        {
+            printf("Bench : %s skipped, mesh not loaded\n", bench_assets[a]);
+            continue;
+        }
+        ent.getTriangleMesh()->computeTriangleNormals();
+        ent.getTriangleMesh()->computeVertexNormals();
+
+        Scene scene;
+        scene.addEntity(&ent);
+        scene.addLight((Light*)&dir_light);
+
+        const vec3 mesh_center = mesh->getMeshCenter();
+        const BoundingBox bbox = mesh->getAxisAlignBoundingBox();
+        const float view_distance = 1.5f * max(bbox.max_x - bbox.min_x, max(bbox.max_y - bbox.min_y, bbox.max_z - bbox.min_z));
+
+        for (size_t r = 0; r < sizeof(bench_resolutions) / sizeof(bench_resolutions[0]); r++)
+        {
+            const long width = bench_resolutions[r][0];
+            const long height = bench_resolutions[r][1];
+            FrameBuffer frame_buffer(width, height);
+
+            for (long s = 0; s < shader_count; s++)
+            {
+                frame_times.clear();
+                double total_time = 0.0;
+                long total_covered = 0;
+                long total_fragments_shaded = 0;
+                long total_vertices_shaded = 0;
+                for (long frame = -BENCH_WARMUP_FRAMES; frame < frame_count; frame++)
+                {
+                    // one full orbit over the timed frames
+                    const float angle = 2.0f * PI * max(frame, 0L) / frame_count;
+                    scene.getCamera().setTransform(
+                        mesh_center + vec3(sinf(angle), 0.25f * sinf(angle), -cosf(angle)) * view_distance,
+                        mesh_center);
+
+                    const double frame_start = getTimeMilliseconds();
+                    frame_buffer.clearColorBuffer(rgb(0.0f, 0.0f, 0.0f));
+                    Pipeline::draw(frame_buffer, scene, shaders[s]);
+                    const double frame_time = getTimeMilliseconds() - frame_start;
+
+                    if (frame >= 0)
+                    {
+                        frame_times.push_back(frame_time);
+                        total_time += frame_time;
+                        total_covered += countCoveredPixels(frame_buffer);
+                        total_fragments_shaded += Pipeline::getStatistics().fragments_shaded;
+                        total_vertices_shaded += Pipeline::getStatistics().vertices_shaded;
+                    }
+                }
+                frame_times.sort(lessThan);
+
+                const double seconds = total_time / 1e3;
+                fprintf(fp, "%s,%s,%ld,%ld,%ld,%ld,%.3f,%.3f,%.3f,%.3f,%.3f,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+                    bench_assets[a], shader_names[s], width, height,
+                    Singleton<Global>::get().thread_count, frame_count,
+                    total_time / frame_count,
+                    percentile(frame_times, 50.0),
+                    percentile(frame_times, 90.0),
+                    percentile(frame_times, 99.0),
+                    frame_times[frame_times.size() - 1],
+                    mesh->faceCount() * frame_count / seconds,
+                    total_covered / seconds,
+                    mesh->uniqueVertexCount() * frame_count / seconds,
+                    total_fragments_shaded / seconds,
+                    total_vertices_shaded / seconds);
+                fflush(fp);
+
+                printf("Bench : %-24s %-16s %4ldx%-4ld %8.3f ms/frame (p50)\n",
+                    bench_assets[a], shader_names[s], width, height, percentile(frame_times, 50.0));
+            }
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "test.hpp"
+
+using namespace Lurdr;
+
+/**
+ * Casts random rays at spot through MeshBVH and at a scene of three entities
+ * through SceneBVH and checks every hit against a brute force test of all
+ * triangles. Then deforms the mesh and moves an entity, refits both
+ * hierarchies and checks again.
+ */
+
+#define BVH_TEST_RAYS 2000
+
+static unsigned int s_seed = 1;
+
+// xorshift, the same rays on every run
+static float nextRandom()
+{
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    return (s_seed & 0xFFFFFF) / (float)0x1000000;
+}
+
+// from a sphere around bbox towards a point inside it, some rays miss
+static Ray randomRay(const BoundingBox & bbox)
+{
+    const vec3 center(
+        (bbox.min_x + bbox.max_x) * 0.5f,
+        (bbox.min_y + bbox.max_y) * 0.5f,
+        (bbox.min_z + bbox.max_z) * 0.5f);
+    const vec3 extent(bbox.max_x - bbox.min_x, bbox.max_y - bbox.min_y, bbox.max_z - bbox.min_z);
+    const float radius = extent.length() * 1.5f;
+
+    const float z = nextRandom() * 2.0f - 1.0f;
+    const float phi = nextRandom() * 2.0f * PI;
+    const float r = sqrtf(max(1.0f - z * z, 0.0f));
+    const vec3 origin = center + vec3(r * cosf(phi), r * sinf(phi), z) * radius;
+    const vec3 target = center + vec3(
+        (nextRandom() - 0.5f) * extent.x * 1.2f,
+        (nextRandom() - 0.5f) * extent.y * 1.2f,
+        (nextRandom() - 0.5f) * extent.z * 1.2f);
+    return Ray(origin, target - origin);
+}
+
+static bool intersectMesh(const TriangleMesh * mesh, const Ray & ray, RayHit & hit)
+{
+    const vec3 *vertices = mesh->getVertices();
+    const vec3i *faces = mesh->getFaces();
+    bool found = false;
+    hit.t = FLT_MAX;
+    for (size_t f = 0; f < mesh->faceCount(); f++)
+    {
+        float t, u, v;
+        if (ray.intersectWithTriangle(vertices[faces[f][0]], vertices[faces[f][1]], vertices[faces[f][2]], &t, &u, &v) &&
+            t < hit.t)
+        {
+            hit.t = t;
+            hit.face_idx = f;
+            found = true;
+        }
+    }
+    return found;
+}
+
+static bool intersectScene(const Scene & scene, const Ray & ray, RayHit & hit)
+{
+    const DynamicArray<Entity*> & entities = *scene.getEntities();
+    bool found = false;
+    hit.t = FLT_MAX;
+    for (size_t e = 0; e < entities.size(); e++)
+    {
+        const mat4 inv = entities[e]->getTransform().inversed();
+        const Ray model_ray(
+            vec3(inv * vec4(ray.origin().x, ray.origin().y, ray.origin().z, 1.0f)),
+            vec3(inv * vec4(ray.direction().x, ray.direction().y, ray.direction().z, 0.0f)));
+        RayHit entity_hit;
+        if (intersectMesh(entities[e]->getTriangleMesh(), model_ray, entity_hit) && entity_hit.t < hit.t)
+        {
+            hit = entity_hit;
+            hit.entity_idx = e;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// 1 if a hierarchy hit differs from the brute force one or no ray hit at all
+template<typename BVH, typename BruteForce>
+static int compareHits(const char * name, const BVH & bvh, const BoundingBox & bbox, BruteForce brute_force)
+{
+    long hits = 0;
+    long mismatches = 0;
+    for (long i = 0; i < BVH_TEST_RAYS; i++)
+    {
+        const Ray ray = randomRay(bbox);
+        RayHit bvh_hit;
+        RayHit expected;
+        const bool bvh_found = bvh.intersect(ray, FLT_MAX, bvh_hit);
+        const bool found = brute_force(ray, expected);
+        // faces sharing an edge may both report the closest t
+        if (bvh_found != found || (found && fabs(bvh_hit.t - expected.t) > 1e-5f * max(1.0f, expected.t)))
+        {
+            mismatches++;
+        }
+        hits += found;
+    }
+    if (mismatches > 0 || hits == 0)
+    {
+        printf("BVH : %s, %ld of %d rays differ from brute force, %ld hits\n", name, mismatches, BVH_TEST_RAYS, hits);
+        return 1;
+    }
+    return 0;
+}
+
+// union of the world bounds of the entities
+static BoundingBox sceneBounds(const Scene & scene)
+{
+    const DynamicArray<Entity*> & entities = *scene.getEntities();
+    BoundingBox bbox(FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t e = 0; e < entities.size(); e++)
+    {
+        const BoundingBox model = entities[e]->getTriangleMesh()->getAxisAlignBoundingBox();
+        const mat4 transform = entities[e]->getTransform();
+        for (int c = 0; c < 8; c++)
+        {
+            const vec4 p = transform * vec4(
+                (c & 1) ? model.max_x : model.min_x,
+                (c & 2) ? model.max_y : model.min_y,
+                (c & 4) ? model.max_z : model.min_z,
+                1.0f);
+            bbox.min_x = min(bbox.min_x, p.x);
+            bbox.min_y = min(bbox.min_y, p.y);
+            bbox.min_z = min(bbox.min_z, p.z);
+            bbox.max_x = max(bbox.max_x, p.x);
+            bbox.max_y = max(bbox.max_y, p.y);
+            bbox.max_z = max(bbox.max_z, p.z);
+        }
+    }
+    return bbox;
+}
+
+int test_bvh()
+{
+    entityConf spot_config("assets/spot.txt");
+    entityConf cube_config("assets/cube.txt");
+    Entity spot = Entity(spot_config);
+    Entity spot_instance = Entity(spot_config);
+    Entity cube = Entity(cube_config);
+
+    TriangleMesh *mesh = spot.getTriangleMesh();
+    int failures = 0;
+
+    MeshBVH mesh_bvh(mesh);
+    auto brute_force_mesh = [&](const Ray & ray, RayHit & hit) { return intersectMesh(mesh, ray, hit); };
+    failures += compareHits("mesh", mesh_bvh, mesh->getAxisAlignBoundingBox(), brute_force_mesh);
+
+    // a wave through the mesh, the faces stay the same
+    vec3 *vertices = mesh->getVertices();
+    for (size_t i = 0; i < mesh->vertexCount(); i++)
+    {
+        vertices[i].y += 0.2f * sinf(vertices[i].x * 6.0f);
+        vertices[i].z *= 1.5f;
+    }
+    mesh->computeBoundingBox();
+    mesh_bvh.refit(mesh);
+    failures += compareHits("refit mesh", mesh_bvh, mesh->getAxisAlignBoundingBox(), brute_force_mesh);
+
+    Scene scene;
+    scene.addEntity(&spot);
+    scene.addEntity(&spot_instance);
+    scene.addEntity(&cube);
+    spot_instance.setTransform(mat4::fromTRS(
+        vec3(1.5f, 0.0f, 0.5f), quat::fromAxisAngle(vec3::UNIT_Y, 0.7f), vec3(0.5f, 0.5f, 0.5f)));
+    cube.setTransform(mat4::fromTRS(
+        vec3(-1.5f, 0.5f, 0.0f), quat::fromAxisAngle(vec3::UNIT_X, 0.3f), vec3(0.4f, 0.4f, 0.4f)));
+
+    SceneBVH scene_bvh(scene);
+    auto brute_force_scene = [&](const Ray & ray, RayHit & hit) { return intersectScene(scene, ray, hit); };
+    failures += compareHits("scene", scene_bvh, sceneBounds(scene), brute_force_scene);
+
+    spot.setTransform(mat4::fromTRS(
+        vec3(0.0f, -1.0f, 2.0f), quat::fromAxisAngle(vec3::UNIT_Z, 0.5f), vec3(1.2f, 1.2f, 1.2f)));
+    cube.setTransform(mat4::fromTRS(
+        vec3(0.5f, 1.5f, -1.0f), quat::fromAxisAngle(vec3::UNIT_Y, 1.1f), vec3(0.6f, 0.6f, 0.6f)));
+    scene_bvh.refit();
+    failures += compareHits("refit scene", scene_bvh, sceneBounds(scene), brute_force_scene);
+
+    printf("BVH : %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures;
+}
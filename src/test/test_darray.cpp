@@ -0,0 +1,160 @@
+#include <vector>
+#include <algorithm>
+#include "test.hpp"
+
+using namespace Lurdr;
+
+/**
+ * Microbenchmarks of DynamicArray against std::vector on the patterns the
+ * renderer uses : appending without and with reserve, per element lists
+ * of lists, range insertion and sorting. Every case runs repeat times and
+ * the fastest run is printed, sorts are checked against std::sort.
+ */
+
+static unsigned int s_seed = 1;
+
+static unsigned int nextRandom()
+{
+    // xorshift, the same sequence for both containers
+    s_seed ^= s_seed << 13;
+    s_seed ^= s_seed >> 17;
+    s_seed ^= s_seed << 5;
+    return s_seed;
+}
+
+static bool lessThan(const float & a, const float & b)
+{
+    return a < b;
+}
+
+// fastest of repeat runs of fn in milliseconds, sink keeps the work alive
+template<typename Function>
+static double timeBest(long repeat, Function fn, size_t & sink)
+{
+    double best = 1e30;
+    for (long r = 0; r < repeat; r++)
+    {
+        const double start = getTimeMilliseconds();
+        sink += fn();
+        best = min(best, getTimeMilliseconds() - start);
+    }
+    return best;
+}
+
+static void printRow(const char * name, double darray_ms, double vector_ms)
+{
+    printf("DArray : %-28s %9.3f ms %9.3f ms %6.2fx\n", name, darray_ms, vector_ms, darray_ms / max(vector_ms, 1e-6));
+}
+
+int test_darray(long element_count, long repeat)
+{
+    const size_t n = (size_t)max(element_count, 1L);
+    size_t sink = 0;
+    int failures = 0;
+
+    printf("DArray : %ld elements, best of %ld runs\n", (long)n, repeat);
+    printf("DArray : %-28s %12s %12s %7s\n", "case", "DynamicArray", "std::vector", "ratio");
+
+    printRow("push_back int",
+        timeBest(repeat, [n]() { DynamicArray<int> a; for (size_t i = 0; i < n; i++) a.push_back((int)i); return a.size(); }, sink),
+        timeBest(repeat, [n]() { std::vector<int> a; for (size_t i = 0; i < n; i++) a.push_back((int)i); return a.size(); }, sink));
+
+    printRow("reserve + push_back vec3",
+        timeBest(repeat, [n]() { DynamicArray<vec3> a; a.reserve(n); for (size_t i = 0; i < n; i++) a.push_back(vec3((float)i, 0.0f, 1.0f)); return a.size(); }, sink),
+        timeBest(repeat, [n]() { std::vector<vec3> a; a.reserve(n); for (size_t i = 0; i < n; i++) a.push_back(vec3((float)i, 0.0f, 1.0f)); return a.size(); }, sink));
+
+    printRow("emplace_back vec3",
+        timeBest(repeat, [n]() { DynamicArray<vec3> a; for (size_t i = 0; i < n; i++) a.emplace_back((float)i, 0.0f, 1.0f); return a.size(); }, sink),
+        timeBest(repeat, [n]() { std::vector<vec3> a; for (size_t i = 0; i < n; i++) a.emplace_back((float)i, 0.0f, 1.0f); return a.size(); }, sink));
+
+    // vertex to face lists as built by TriangleMesh::computeVertexNormals
+    const size_t list_count = n / 6 + 1;
+    printRow("lists of lists",
+        timeBest(repeat, [n, list_count]() {
+            DynamicArray<DynamicArray<size_t> > a(list_count);
+            for (size_t i = 0; i < n; i++) a[(i * 7919) % list_count].push_back(i);
+            return a.size(); }, sink),
+        timeBest(repeat, [n, list_count]() {
+            std::vector<std::vector<size_t> > a(list_count);
+            for (size_t i = 0; i < n; i++) a[(i * 7919) % list_count].push_back(i);
+            return a.size(); }, sink));
+
+    // per chunk element arrays merged as in parseOBJ
+    const size_t block = 1024;
+    DynamicArray<UINT32> block_darray(block);
+    std::vector<UINT32> block_vector(block);
+    printRow("range insert",
+        timeBest(repeat, [n, &block_darray]() {
+            DynamicArray<UINT32> a;
+            for (size_t i = 0; i < n; i += block) a.insert(a.size(), block_darray.begin(), block_darray.end());
+            return a.size(); }, sink),
+        timeBest(repeat, [n, &block_vector]() {
+            std::vector<UINT32> a;
+            for (size_t i = 0; i < n; i += block) a.insert(a.end(), block_vector.begin(), block_vector.end());
+            return a.size(); }, sink));
+
+    printRow("copy + move",
+        timeBest(repeat, [n]() {
+            DynamicArray<UINT32> a(n);
+            DynamicArray<UINT32> b(a);
+            DynamicArray<UINT32> c(std::move(b));
+            return c.size() + b.size(); }, sink),
+        timeBest(repeat, [n]() {
+            std::vector<UINT32> a(n);
+            std::vector<UINT32> b(a);
+            std::vector<UINT32> c(std::move(b));
+            return c.size() + b.size(); }, sink));
+
+    // sorts of random, sorted and reversed keys, the last two are the worst case of a naive quick sort
+    const char * sort_names[] = { "sort random float", "sort sorted float", "sort reversed float" };
+    for (int order = 0; order < 3; order++)
+    {
+        DynamicArray<float> keys(n);
+        s_seed = 1;
+        for (size_t i = 0; i < n; i++)
+        {
+            keys[i] = order == 0 ? (float)(nextRandom() % 1000000) : (float)(order == 1 ? i : n - i);
+        }
+        std::vector<float> keys_vector(keys.begin(), keys.end());
+
+        DynamicArray<float> sorted;
+        std::vector<float> sorted_vector;
+        printRow(sort_names[order],
+            timeBest(repeat, [&keys, &sorted]() { sorted = keys; sorted.sort(lessThan); return sorted.size(); }, sink),
+            timeBest(repeat, [&keys_vector, &sorted_vector]() { sorted_vector = keys_vector; std::sort(sorted_vector.begin(), sorted_vector.end(), lessThan); return sorted_vector.size(); }, sink));
+
+        if (!std::equal(sorted.begin(), sorted.end(), sorted_vector.begin()))
+        {
+            printf("DArray : %s differs from std::sort\n", sort_names[order]);
+            failures++;
+        }
+    }
+
+    // buffers handed over without copying are freed as new[] arrays
+    DynamicArray<vec3> owner;
+    owner.reserve(n + 8);
+    owner.resize(n, vec3(1.0f, 2.0f, 3.0f));
+    const size_t owner_capacity = owner.capacity();
+    vec3 *buffer = owner.release();
+    DynamicArray<vec3> adopted;
+    adopted.adopt(buffer, n, owner_capacity);
+    if (!owner.empty() || adopted.size() != n || adopted.capacity() != owner_capacity ||
+        adopted.data() != buffer || adopted[n - 1].z != 3.0f)
+    {
+        printf("DArray : release/adopt lost the buffer\n");
+        failures++;
+    }
+
+    // grown slots read as T() even after a shrink left old values behind
+    DynamicArray<int> values(64, 7);
+    values.resize(32);
+    values.resize(64);
+    if (values[63] != 0 || values[32] != 0 || values[31] != 7)
+    {
+        printf("DArray : resize kept stale elements\n");
+        failures++;
+    }
+
+    printf("DArray : %s (%lu)\n", failures == 0 ? "ok" : "FAILED", (unsigned long)(sink & 1));
+    return failures;
+}
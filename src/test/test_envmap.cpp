@@ -22,7 +22,7 @@ static int current_shader = 0;
 
 static float view_distance = 3.0f;
 
-int test_pipeline() {
+int test_envmap() {
 
     entityConf config("assets/sphere.txt");
     Entity ent = Entity(config);
@@ -33,11 +33,10 @@ int test_pipeline() {
     ent.getTriangleMesh()->printMeshInfo();
 
     Envmap envmap("assets/envmaps/env01.bmp");
+    EnvLight env_light("assets/envmaps/env01.bmp");
 
     scene.addEntity(&ent);
-    scene.addLight((Light*)&dir_light);
-    scene.addLight((Light*)&point_light1);
-    scene.addLight((Light*)&point_light2);
+    scene.addLight((Light*)&env_light);
     scene.setEnvmap(&envmap);
 
     vec3 mesh_center = ent.getTriangleMesh()->getMeshCenter();
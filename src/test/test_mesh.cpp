@@ -0,0 +1,133 @@
+#include "test.hpp"
+
+using namespace Lurdr;
+
+#define MESH_TEST_SIZE 256
+
+// render entity alone from a fixed view into frame_buffer
+static void drawEntity(FrameBuffer & frame_buffer, Entity & ent, const Shader * shader)
+{
+    Scene scene;
+    scene.addEntity(&ent);
+    const vec3 mesh_center = ent.getTriangleMesh()->getMeshCenter();
+    scene.getCamera().setTransform(mesh_center + vec3(1.0f, 0.5f, -2.5f), mesh_center);
+
+    frame_buffer.clearColorBuffer(rgb(0.0f, 0.0f, 0.0f));
+    Pipeline::draw(frame_buffer, scene, shader);
+}
+
+// 1 if the frames differ or show nothing
+static int compareFrames(const char * name, const FrameBuffer & a, const FrameBuffer & b)
+{
+    const long bytes = a.getSize() * a.getPixelSize();
+    long covered = 0;
+    for (long i = 0; i < bytes; i++)
+    {
+        covered += a.colorBuffer()[i] != 0;
+    }
+    if (covered == 0 || memcmp(a.colorBuffer(), b.colorBuffer(), bytes) != 0)
+    {
+        printf("Mesh : %s draws differently\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int compareMeshes(const char * name, const TriangleMesh & a, const TriangleMesh & b)
+{
+    if (a.faceCount() != b.faceCount() ||
+        a.uniqueVertexCount() != b.uniqueVertexCount() ||
+        a.meshletCount() != b.meshletCount() ||
+        a.lodCount() != b.lodCount() ||
+        a.hasTriangleNormals() != b.hasTriangleNormals() ||
+        a.hasTextureCoords() != b.hasTextureCoords())
+    {
+        printf("Mesh : %s differs from its source\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Copies of loaded meshes, assigns a mesh over one that was loaded with
+ * other arrays, meshlets and levels of detail, then draws both and checks
+ * that the copy renders the same pixels as the source. Then loads a mesh
+ * with meshlets and levels through the mesh cache and checks that the
+ * mapped mesh matches the parsed one.
+ */
+int test_mesh()
+{
+    entityConf spot_config("assets/spot.txt");
+    entityConf cube_config("assets/cube.txt");
+    Entity spot = Entity(spot_config);
+    Entity cube = Entity(cube_config);
+
+    TriangleMesh *source = spot.getTriangleMesh();
+    source->computeTriangleNormals();
+    source->computeVertexNormals();
+    source->buildMeshlets();
+    source->generateLods(2);
+    cube.getTriangleMesh()->computeTriangleNormals();
+    source->printMeshInfo();
+
+    int failures = 0;
+    TriangleMesh copy(*source);
+    failures += compareMeshes("copy", copy, *source);
+
+    // twice, the second time over arrays, meshlets and levels of the first
+    TriangleMesh *target = cube.getTriangleMesh();
+    *target = *source;
+    *target = copy;
+    *target = *target;
+    failures += compareMeshes("assigned mesh", *target, *source);
+
+    LURDR_WIREFRAME_MODE(false);
+    LURDR_BACKFACE_CULLING(true);
+    LURDR_DEPTH_TEST(true);
+
+    VertexNormalShader shader;
+    FrameBuffer source_frame(MESH_TEST_SIZE, MESH_TEST_SIZE);
+    FrameBuffer target_frame(MESH_TEST_SIZE, MESH_TEST_SIZE);
+    drawEntity(source_frame, spot, &shader);
+    drawEntity(target_frame, cube, &shader);
+    failures += compareFrames("assigned mesh", source_frame, target_frame);
+
+    // the first load parses and writes the cache, the second maps it
+    const char *mesh_file = "assets/meshes/spot.obj";
+    remove("assets/meshes/spot.obj" MESH_CACHE_EXTENSION);
+    LURDR_MESH_CACHE(true);
+    LURDR_BUILD_MESHLETS(true);
+    LURDR_LOD_LEVELS(2);
+    TriangleMesh parsed(mesh_file);
+    TriangleMesh cached(mesh_file);
+    LURDR_MESH_CACHE(false);
+    LURDR_BUILD_MESHLETS(false);
+    LURDR_LOD_LEVELS(0);
+    if (parsed.isMapped() || !cached.isMapped() || !cached.hasMeshlets() || cached.lodCount() != 3)
+    {
+        printf("Mesh : meshlets and levels were not cached\n");
+        failures++;
+    }
+    failures += compareMeshes("cached mesh", cached, parsed);
+    for (size_t level = 1; level < parsed.lodCount(); level++)
+    {
+        failures += compareMeshes("cached level", *cached.getLod(level), *parsed.getLod(level));
+    }
+
+    Entity parsed_entity;
+    Entity cached_entity;
+    parsed_entity.setTriangleMesh(&parsed);
+    cached_entity.setTriangleMesh(&cached);
+    drawEntity(source_frame, parsed_entity, &shader);
+    drawEntity(target_frame, cached_entity, &shader);
+    failures += compareFrames("cached mesh", source_frame, target_frame);
+
+    // a mapped mesh assigned over, then detached by a change
+    *target = cached;
+    cached.computeVertexNormals();
+    cached.optimizeVertexCache();
+    failures += compareMeshes("mesh assigned from the cache", *target, parsed);
+
+    printf("Mesh : %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures;
+}
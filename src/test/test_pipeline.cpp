@@ -1,3 +1,4 @@
+#include <mutex>
 #include "test.hpp"
 
 using namespace Lurdr;
@@ -6,9 +7,17 @@ static void keyboardEventCallback(AppWindow *window, KEY_CODE key, bool pressed)
 static void mouseButtonEventCallback(AppWindow *window, MOUSE_BUTTON button, bool pressed);
 static void mouseScrollEventCallback(AppWindow *window, float offset);
 static void mouseDragEventCallback(AppWindow *window, float x, float y);
+static void presentFrame(const FrameBuffer & frame_buffer, UINT64 frame, void * data);
+static void showPresentedFrame();
 
 static AppWindow *window;
-static FrameBuffer frame_buffer(512, 512);
+static byte_t window_surface[512 * 512 * 3];
+
+// the present thread exports into present_surface, the window thread copies
+// it into its own surface, so a paint never reads a frame being exported
+static std::mutex present_mutex;
+static byte_t present_surface[512 * 512 * 3];
+static bool present_pending = false;
 
 static Scene scene;
 static Entity* entity_ptr;
@@ -81,7 +90,11 @@ int test_pipeline() {
 
     ent.getTriangleMesh()->computeTriangleNormals();
     ent.getTriangleMesh()->computeVertexNormals();
+    ent.getTriangleMesh()->buildMeshlets();
     ent.getTriangleMesh()->printMeshInfo();
+    // simplified levels are picked up by poll() once built
+    LodGenerator lod_generator;
+    lod_generator.submit(ent.getTriangleMesh());
     // ent.setTransform(mat4::fromAxisAngle(vec3::UNIT_X, -PI / 2));
 
     Envmap envmap("assets/envmaps/env01.bmp");
@@ -123,7 +136,10 @@ int test_pipeline() {
     initializeApplication();
 
     const char * title = "Viewer @ Lu Renderer";
-    window = createWindow(title, 512, 512, frame_buffer.colorBuffer());
+    window = createWindow(title, 512, 512, window_surface);
+
+    // frame N is blitted to the window while frame N + 1 renders
+    FrameRing frame_ring(2, 512, 512, presentFrame, nullptr);
 
     setKeyboardCallback(window, keyboardEventCallback);
     setMouseButtonCallback(window, mouseButtonEventCallback);
@@ -136,6 +152,9 @@ int test_pipeline() {
     {
         FPS_UPDATE(_fps);
 
+        lod_generator.poll();
+
+        FrameBuffer & frame_buffer = frame_ring.acquire();
         frame_buffer.clearColorBuffer(rgb(0.0f, 0.0f, 0.0f));
         Pipeline::draw(frame_buffer, scene, shaders[current_shader]);
 
@@ -145,6 +164,12 @@ int test_pipeline() {
         drawInteger(
             frame_buffer, 40.0f, 10.0f, 
             _fps, 6.0f, COLOR_RED);
+        drawString(
+            frame_buffer, 100.0f, 10.0f,
+            "LOD", 6.0f, COLOR_WHITE);
+        drawInteger(
+            frame_buffer, 130.0f, 10.0f,
+            (int)ent.getLodLevel(), 6.0f, COLOR_RED);
 #if 1
         drawString(
             frame_buffer, 10.0f, 30.0f,
@@ -171,9 +196,14 @@ int test_pipeline() {
             frame_buffer, 10.0f, 105.0f,
             "KEY ESCAPE   --------- EXIT", 6.0f, COLOR_WHITE);
 #endif
-        swapBuffer(window);
+#ifdef _PIPELINE_STATISTICS_
+        Pipeline::drawStatistics(frame_buffer, 10.0f, 130.0f, 6.0f, COLOR_WHITE);
+#endif
+        frame_ring.submit();
+        showPresentedFrame();
         pollEvent();
     }
+    frame_ring.flush();
 
     terminateApplication();
     return 0;
@@ -288,4 +318,26 @@ void mouseDragEventCallback(AppWindow *window, float x, float y)
     }
     mouse_x = x;
     mouse_y = y;
-}
\ No newline at end of file
+}
+
+// runs on the present thread of the frame ring
+void presentFrame(const FrameBuffer & frame_buffer, UINT64 frame, void * data)
+{
+    __unused_variable(frame);
+    __unused_variable(data);
+    std::unique_lock<std::mutex> lock(present_mutex);
+    frame_buffer.exportColorBufferRGB(present_surface);
+    present_pending = true;
+}
+
+// runs on the window thread, which paints from window_surface
+void showPresentedFrame()
+{
+    std::unique_lock<std::mutex> lock(present_mutex);
+    if (present_pending)
+    {
+        memcpy(window_surface, present_surface, sizeof(window_surface));
+        present_pending = false;
+        swapBuffer(window);
+    }
+}